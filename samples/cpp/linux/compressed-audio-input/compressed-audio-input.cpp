@@ -3,8 +3,28 @@
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
 #include <iostream> // cin, cout
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <glob.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <speechapi_cxx.h>
+#include "gstreamer_decoder_pool.h"
+#include "native_decoders.h"
+#include "opus_encoder_stage.h"
 
 using namespace Microsoft::CognitiveServices::Speech;
 using namespace Microsoft::CognitiveServices::Speech::Audio;
@@ -37,46 +57,72 @@ static int ReadCompressedBinaryData(void *stream, uint8_t *ptr, uint32_t bufSize
     }
 }
 
-void recognizeSpeech(const std::string& compressedFileName)
+// Gets the container format of a compressed file from its extension.
+static bool GetContainerFormat(const std::string& compressedFileName, AudioStreamContainerFormat& inputFormat)
 {
-    std::shared_ptr<SpeechRecognizer> recognizer;
-    std::shared_ptr<PullAudioInputStream> pullAudioStream;
-
-    void *compressedFilePtr = OpenCompressedFile(compressedFileName);
-
-    if (compressedFilePtr == NULL)
+    auto hasExtension = [&compressedFileName](const std::string& extension)
     {
-        std::cout << "Error: Input file doesn't exist" << std::endl;
-        return;
-    }
-
-    // Creates an instance of a speech config with specified subscription key and service region.
-    // Replace with your own subscription key and service region (e.g., "westus").
-    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+        return compressedFileName.size() >= extension.size() &&
+            compressedFileName.compare(compressedFileName.size() - extension.size(), extension.size(), extension) == 0;
+    };
 
-    AudioStreamContainerFormat inputFormat;
-
-    if (compressedFileName.find(".mp3") == (compressedFileName.size() - 4))
+    if (hasExtension(".mp3"))
     {
         inputFormat = AudioStreamContainerFormat::MP3;
     }
-    else if (compressedFileName.find(".opus") == (compressedFileName.size() - 5))
+    else if (hasExtension(".opus"))
     {
         inputFormat = AudioStreamContainerFormat::OGG_OPUS;
     }
-    else if (compressedFileName.find(".alaw") == (compressedFileName.size() - 5))
+    else if (hasExtension(".alaw"))
     {
         inputFormat = AudioStreamContainerFormat::ALAW;
     }
-    else if (compressedFileName.find(".mulaw") == (compressedFileName.size() - 6))
+    else if (hasExtension(".mulaw"))
     {
         inputFormat = AudioStreamContainerFormat::MULAW;
     }
-    else if (compressedFileName.find(".flac") == (compressedFileName.size() - 5))
+    else if (hasExtension(".flac"))
     {
         inputFormat = AudioStreamContainerFormat::FLAC;
     }
     else
+    {
+        return false;
+    }
+    return true;
+}
+
+static bool ReadWholeFile(const std::string& fileName, std::vector<uint8_t>& contents)
+{
+    std::ifstream file(fileName, std::ios_base::binary);
+    if (!file.good())
+    {
+        return false;
+    }
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+void recognizeSpeech(const std::string& compressedFileName)
+{
+    std::shared_ptr<SpeechRecognizer> recognizer;
+    std::shared_ptr<PullAudioInputStream> pullAudioStream;
+
+    void *compressedFilePtr = OpenCompressedFile(compressedFileName);
+
+    if (compressedFilePtr == NULL)
+    {
+        std::cout << "Error: Input file doesn't exist" << std::endl;
+        return;
+    }
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    AudioStreamContainerFormat inputFormat;
+    if (!GetContainerFormat(compressedFileName, inputFormat))
     {
         std::cout << "Only Opus and MP3 input files are currently supported" << std::endl;
         return;
@@ -119,13 +165,917 @@ void recognizeSpeech(const std::string& compressedFileName)
     }
 }
 
+// Prints the result of recognizing a clip, prefixed with the name of its file.
+static void printResult(const std::string& compressedFileName, std::shared_ptr<SpeechRecognitionResult> result)
+{
+    if (result->Reason == ResultReason::RecognizedSpeech) {
+        std::cout << compressedFileName << ": " << result->Text << std::endl;
+    }
+    else if (result->Reason == ResultReason::NoMatch) {
+        std::cout << compressedFileName << ": NOMATCH: Speech could not be recognized." << std::endl;
+    }
+    else if (result->Reason == ResultReason::Canceled) {
+        auto cancellation = CancellationDetails::FromResult(result);
+        std::cout << compressedFileName << ": CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+        if (cancellation->Reason == CancellationReason::Error) {
+            std::cout << "CANCELED: ErrorCode= " << (int)cancellation->ErrorCode << std::endl;
+            std::cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+            std::cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    }
+}
+
+// Recognizes many compressed clips, decoding them with pooled GStreamer pipelines into PCM streams.
+// The SDK would otherwise build a new decoding pipeline for every compressed stream.
+void recognizeSpeechWithPooledDecoders(const std::vector<std::string>& compressedFileNames)
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    GstDecoderPool pool;
+    for (const auto& compressedFileName : compressedFileNames)
+    {
+        AudioStreamContainerFormat inputFormat;
+        std::vector<uint8_t> compressedData;
+        if (!GetContainerFormat(compressedFileName, inputFormat) || !ReadWholeFile(compressedFileName, compressedData))
+        {
+            std::cout << compressedFileName << ": unsupported or missing input file" << std::endl;
+            continue;
+        }
+
+        // Clips are short, so all their compressed data is queued to the decoder at once.
+        auto decoder = pool.Acquire(inputFormat);
+        decoder->Write(compressedData.data(), compressedData.size());
+        decoder->EndOfStream();
+
+        auto callback = std::make_shared<GstDecoderInputCallback>(std::move(decoder));
+        auto pullAudioStream = AudioInputStream::CreatePullStream(AudioStreamFormat::GetWaveFormatPCM(16000, 16, 1), callback);
+        auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullAudioStream));
+
+        printResult(compressedFileName, recognizer->RecognizeOnceAsync().get());
+    }
+
+    std::cout << "Decoding pipelines built: " << pool.GetCreatedCount() << ", reused: " << pool.GetReusedCount() << std::endl;
+}
+
+// Measures the decode setup time per clip, building a new pipeline for every clip and with pooled pipelines.
+void benchmarkDecodeSetup(const std::string& compressedFileName, int clips)
+{
+    using clock = std::chrono::steady_clock;
+    auto microseconds = [](clock::duration d) { return std::chrono::duration<double, std::micro>(d).count(); };
+
+    AudioStreamContainerFormat inputFormat;
+    std::vector<uint8_t> compressedData;
+    if (!GetContainerFormat(compressedFileName, inputFormat) || !ReadWholeFile(compressedFileName, compressedData))
+    {
+        std::cout << "Error: unsupported or missing input file" << std::endl;
+        return;
+    }
+
+    std::vector<uint8_t> pcm(3200);
+    auto decode = [&](GstDecoder& decoder)
+    {
+        decoder.Write(compressedData.data(), compressedData.size());
+        decoder.EndOfStream();
+        size_t total = 0;
+        while (auto count = decoder.Read(pcm.data(), pcm.size()))
+        {
+            total += count;
+        }
+        return total;
+    };
+
+    GstDecoderPool::Initialize();
+    double setupUs = 0;
+    double teardownUs = 0;
+    size_t pcmBytes = 0;
+    for (int i = 0; i < clips; i++)
+    {
+        auto start = clock::now();
+        std::unique_ptr<GstDecoder> decoder(new GstDecoder(inputFormat));
+        setupUs += microseconds(clock::now() - start);
+        pcmBytes = decode(*decoder);
+        start = clock::now();
+        decoder.reset();
+        teardownUs += microseconds(clock::now() - start);
+    }
+    std::cout << "New pipeline per clip:    setup " << setupUs / clips << " us, teardown " << teardownUs / clips << " us" << std::endl;
+
+    GstDecoderPool pool;
+    setupUs = 0;
+    teardownUs = 0;
+    for (int i = 0; i < clips; i++)
+    {
+        auto start = clock::now();
+        auto decoder = pool.Acquire(inputFormat);
+        setupUs += microseconds(clock::now() - start);
+        decode(*decoder);
+        start = clock::now();
+        decoder.reset();
+        teardownUs += microseconds(clock::now() - start);
+    }
+    std::cout << "Pooled pipelines:         setup " << setupUs / clips << " us, reset " << teardownUs / clips << " us"
+              << " (" << pool.GetCreatedCount() << " built, " << pool.GetReusedCount() << " reused)" << std::endl;
+    std::cout << pcmBytes << " bytes of PCM decoded per clip." << std::endl;
+}
+
+// Checks that pooled decoders still decode after being reset: every file is decoded, then decoded again by the
+// same pipeline, which must produce the same PCM. Files of every format used with the pool should be checked.
+void checkPooledDecoderReuse(const std::vector<std::string>& compressedFileNames)
+{
+    int failures = 0;
+    for (const auto& compressedFileName : compressedFileNames)
+    {
+        AudioStreamContainerFormat inputFormat;
+        std::vector<uint8_t> compressedData;
+        if (!GetContainerFormat(compressedFileName, inputFormat) || !ReadWholeFile(compressedFileName, compressedData))
+        {
+            std::cout << compressedFileName << ": unsupported or missing input file" << std::endl;
+            failures++;
+            continue;
+        }
+
+        std::vector<uint8_t> pcm[2];
+        bool failed = false;
+        GstDecoderPool pool(1);
+        for (auto& output : pcm)
+        {
+            auto decoder = pool.Acquire(inputFormat);
+            decoder->Write(compressedData.data(), compressedData.size());
+            decoder->EndOfStream();
+            std::vector<uint8_t> buffer(3200);
+            while (auto count = decoder->Read(buffer.data(), buffer.size()))
+            {
+                output.insert(output.end(), buffer.begin(), buffer.begin() + count);
+            }
+            failed = failed || decoder->HasFailed();
+        }
+
+        bool passed = !failed && pool.GetReusedCount() == 1 && !pcm[0].empty() && pcm[0] == pcm[1];
+        std::cout << compressedFileName << ": " << pcm[0].size() << " bytes of PCM, " << pcm[1].size()
+                  << " after reset: " << (passed ? "OK" : "FAILED") << std::endl;
+        failures += passed ? 0 : 1;
+    }
+    std::cout << (failures == 0 ? "All decoders reused." : "Some decoders failed after reset.") << std::endl;
+}
+
+// Opens a decoder of a compressed file, producing 16-bit mono PCM at the returned sample rate. Decodes in the
+// process for FLAC, Opus and G.711 and with a pooled GStreamer pipeline for MP3, and for files with a sample rate
+// the native decoders do not resample. Returns nullptr, with the error, if the file is missing, of an unsupported
+// format or cannot be decoded.
+static std::shared_ptr<PullAudioInputStreamCallback> openDecoder(const std::string& compressedFileName, GstDecoderPool& pool, uint32_t& samplesPerSecond, std::string& error)
+{
+    AudioStreamContainerFormat inputFormat;
+    if (!GetContainerFormat(compressedFileName, inputFormat))
+    {
+        error = "unsupported or missing input file";
+        return nullptr;
+    }
+
+    try
+    {
+        auto nativeDecoder = CreateNativeDecoder(inputFormat, compressedFileName);
+        if (nativeDecoder)
+        {
+            samplesPerSecond = nativeDecoder->GetSamplesPerSecond();
+            return std::make_shared<NativeDecoderInputCallback>(std::move(nativeDecoder));
+        }
+    }
+    catch (const UnsupportedSampleRateError&)
+    {
+        // GStreamer resamples anything.
+    }
+    catch (const std::runtime_error& e)
+    {
+        // E.g. a corrupt file, which GStreamer would not decode either.
+        error = std::string("cannot be decoded, ") + e.what();
+        return nullptr;
+    }
+    catch (const std::invalid_argument&)
+    {
+        error = "unsupported or missing input file";
+        return nullptr;
+    }
+
+    std::vector<uint8_t> compressedData;
+    if (!ReadWholeFile(compressedFileName, compressedData))
+    {
+        error = "unsupported or missing input file";
+        return nullptr;
+    }
+    auto decoder = pool.Acquire(inputFormat);
+    decoder->Write(compressedData.data(), compressedData.size());
+    decoder->EndOfStream();
+    samplesPerSecond = 16000;
+    return std::make_shared<GstDecoderInputCallback>(std::move(decoder));
+}
+
+// Opens a compressed file as a PCM stream, see openDecoder().
+static std::shared_ptr<PullAudioInputStream> openDecodedStream(const std::string& compressedFileName, GstDecoderPool& pool, std::string& error)
+{
+    uint32_t samplesPerSecond = 0;
+    auto callback = openDecoder(compressedFileName, pool, samplesPerSecond, error);
+    if (!callback)
+    {
+        return nullptr;
+    }
+    return AudioInputStream::CreatePullStream(AudioStreamFormat::GetWaveFormatPCM(samplesPerSecond, 16, 1), callback);
+}
+
+// Recognizes compressed clips decoded in the process where possible, keeping GStreamer off the path of FLAC and
+// Opus files. G.711 files are expanded natively too; MP3 files fall back to pooled GStreamer pipelines.
+void recognizeSpeechWithNativeDecoders(const std::vector<std::string>& compressedFileNames)
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    GstDecoderPool pool;
+    for (const auto& compressedFileName : compressedFileNames)
+    {
+        std::string error;
+        auto pullAudioStream = openDecodedStream(compressedFileName, pool, error);
+        if (!pullAudioStream)
+        {
+            std::cout << compressedFileName << ": " << error << std::endl;
+            continue;
+        }
+
+        auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullAudioStream));
+        printResult(compressedFileName, recognizer->RecognizeOnceAsync().get());
+    }
+
+    std::cout << "Decoding pipelines built: " << pool.GetCreatedCount() << ", reused: " << pool.GetReusedCount() << std::endl;
+}
+
+// Gets the CPU time used by the process so far, in seconds, including the streaming threads of GStreamer.
+static double getProcessCpuSeconds()
+{
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// Compares the decode throughput and the CPU time per stream of the native decoders with that of pooled GStreamer
+// pipelines, decoding the same file the given number of times. The pipelines are built before timing starts.
+void benchmarkDecodeThroughput(const std::string& compressedFileName, int clips)
+{
+    using clock = std::chrono::steady_clock;
+    auto seconds = [](clock::duration d) { return std::chrono::duration<double>(d).count(); };
+    auto report = [clips](const char* route, double audioSeconds, double wallSeconds, double cpuSeconds)
+    {
+        std::cout << route << audioSeconds / wallSeconds << "x real time, "
+                  << cpuSeconds * 1000 / clips << " ms CPU per stream, "
+                  << cpuSeconds * 1000 / audioSeconds << " ms CPU per audio second" << std::endl;
+    };
+
+    AudioStreamContainerFormat inputFormat;
+    std::vector<uint8_t> compressedData;
+    if (!GetContainerFormat(compressedFileName, inputFormat) || !ReadWholeFile(compressedFileName, compressedData))
+    {
+        std::cout << "Error: unsupported or missing input file" << std::endl;
+        return;
+    }
+
+    std::vector<int16_t> samples(1600);
+    double audioSeconds = 0;
+    auto start = clock::now();
+    auto cpuStart = getProcessCpuSeconds();
+    try
+    {
+        for (int i = 0; i < clips; i++)
+        {
+            auto decoder = CreateNativeDecoder(inputFormat, compressedFileName);
+            if (!decoder)
+            {
+                std::cout << "No native decoder for this format, only FLAC, Opus and G.711 are decoded natively." << std::endl;
+                return;
+            }
+            size_t total = 0;
+            while (auto count = decoder->Read(samples.data(), samples.size()))
+            {
+                total += count;
+            }
+            audioSeconds += static_cast<double>(total) / decoder->GetSamplesPerSecond();
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "Error: " << e.what() << std::endl;
+        return;
+    }
+    report("Native decoder:      ", audioSeconds, seconds(clock::now() - start), getProcessCpuSeconds() - cpuStart);
+
+    GstDecoderPool pool;
+    pool.Acquire(inputFormat).reset();
+    std::vector<uint8_t> pcm(3200);
+    size_t pcmBytes = 0;
+    start = clock::now();
+    cpuStart = getProcessCpuSeconds();
+    for (int i = 0; i < clips; i++)
+    {
+        auto decoder = pool.Acquire(inputFormat);
+        decoder->Write(compressedData.data(), compressedData.size());
+        decoder->EndOfStream();
+        while (auto count = decoder->Read(pcm.data(), pcm.size()))
+        {
+            pcmBytes += count;
+        }
+    }
+    report("GStreamer pipelines: ", pcmBytes / 32000.0, seconds(clock::now() - start), getProcessCpuSeconds() - cpuStart);
+    std::cout << audioSeconds / clips << " seconds of audio decoded per stream." << std::endl;
+}
+
+// Lists the compressed files to recognize: the supported files in a directory, the files matching a glob pattern,
+// or the files listed one per line in a manifest. Directory and glob results are sorted by name.
+static std::vector<std::string> listInputFiles(const std::string& input)
+{
+    std::vector<std::string> fileNames;
+    AudioStreamContainerFormat inputFormat;
+    struct stat status = {};
+    if (input.find_first_of("*?[") != std::string::npos)
+    {
+        glob_t matches = {};
+        if (glob(input.c_str(), 0, nullptr, &matches) == 0)
+        {
+            fileNames.assign(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+        }
+        globfree(&matches);
+    }
+    else if (stat(input.c_str(), &status) == 0 && S_ISDIR(status.st_mode))
+    {
+        if (auto directory = opendir(input.c_str()))
+        {
+            while (auto entry = readdir(directory))
+            {
+                std::string name = input + "/" + entry->d_name;
+                if (GetContainerFormat(name, inputFormat))
+                {
+                    fileNames.push_back(name);
+                }
+            }
+            closedir(directory);
+        }
+        std::sort(fileNames.begin(), fileNames.end());
+    }
+    else
+    {
+        std::ifstream manifest(input);
+        std::string line;
+        while (std::getline(manifest, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (!line.empty())
+            {
+                fileNames.push_back(line);
+            }
+        }
+    }
+    return fileNames;
+}
+
+// Pull stream callback counting the bytes read through another callback, to measure the audio recognized.
+class CountingInputCallback final : public PullAudioInputStreamCallback
+{
+public:
+    explicit CountingInputCallback(std::shared_ptr<PullAudioInputStreamCallback> callback)
+        : m_callback(callback)
+    {
+    }
+
+    int Read(uint8_t* dataBuffer, uint32_t size) override
+    {
+        auto count = m_callback->Read(dataBuffer, size);
+        m_bytesRead += count > 0 ? count : 0;
+        return count;
+    }
+
+    void Close() override
+    {
+        m_callback->Close();
+    }
+
+    uint64_t GetBytesRead() const
+    {
+        return m_bytesRead;
+    }
+
+private:
+    std::shared_ptr<PullAudioInputStreamCallback> m_callback;
+    std::atomic<uint64_t> m_bytesRead{ 0 };
+};
+
+struct BatchResult
+{
+    std::string Text;
+    double AudioSeconds = 0;
+    bool Failed = false;
+    std::string Error;
+};
+
+// Transcribes one file with continuous recognition, so that files longer than one utterance are complete.
+static BatchResult transcribeFile(std::shared_ptr<SpeechConfig> config, const std::string& compressedFileName, GstDecoderPool& pool)
+{
+    BatchResult result;
+    uint32_t samplesPerSecond = 0;
+    auto decoder = openDecoder(compressedFileName, pool, samplesPerSecond, result.Error);
+    if (!decoder)
+    {
+        result.Failed = true;
+        return result;
+    }
+
+    auto callback = std::make_shared<CountingInputCallback>(decoder);
+    auto pullAudioStream = AudioInputStream::CreatePullStream(AudioStreamFormat::GetWaveFormatPCM(samplesPerSecond, 16, 1), callback);
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pullAudioStream));
+
+    std::mutex mutex;
+    std::promise<void> recognitionEnd;
+    recognizer->Recognized.Connect([&](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech && !e.Result->Text.empty())
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            result.Text += (result.Text.empty() ? "" : " ") + e.Result->Text;
+        }
+    });
+    recognizer->Canceled.Connect([&](const SpeechRecognitionCanceledEventArgs& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            result.Failed = true;
+            result.Error = "CANCELED: ErrorCode=" + std::to_string((int)e.ErrorCode) + " ErrorDetails=" + e.ErrorDetails;
+        }
+    });
+    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs&)
+    {
+        recognitionEnd.set_value();
+    });
+
+    recognizer->StartContinuousRecognitionAsync().get();
+    recognitionEnd.get_future().get();
+    recognizer->StopContinuousRecognitionAsync().get();
+
+    result.AudioSeconds = callback->GetBytesRead() / (2.0 * samplesPerSecond);
+    return result;
+}
+
+// Transcribes all files of a directory, glob pattern or manifest with continuous recognition, running the given
+// numbers of recognizers at once in turn. Recognizers take the next file from a shared queue as soon as they are
+// done with one, so long files do not hold others back; results are printed in input order all the same.
+// The transcripts are printed for the first run, then the throughput of each run in audio hours per wall hour.
+void transcribeBatch(const std::string& input, const std::vector<int>& concurrencies)
+{
+    auto fileNames = listInputFiles(input);
+    if (fileNames.empty())
+    {
+        std::cout << "Error: no input files found" << std::endl;
+        return;
+    }
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    GstDecoderPool pool;
+    std::ostringstream report;
+    for (size_t run = 0; run < concurrencies.size(); run++)
+    {
+        std::vector<BatchResult> results(fileNames.size());
+        std::vector<bool> done(fileNames.size(), false);
+        std::atomic<size_t> next{ 0 };
+        std::mutex mutex;
+        size_t printed = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int i = 0; i < concurrencies[run]; i++)
+        {
+            workers.emplace_back([&]()
+            {
+                for (size_t index = next++; index < fileNames.size(); index = next++)
+                {
+                    auto result = transcribeFile(config, fileNames[index], pool);
+
+                    // Prints the results completed so far in input order.
+                    std::lock_guard<std::mutex> lock(mutex);
+                    results[index] = std::move(result);
+                    done[index] = true;
+                    for (; printed < fileNames.size() && done[printed]; printed++)
+                    {
+                        if (run > 0)
+                        {
+                            continue;
+                        }
+                        const auto& printedResult = results[printed];
+                        std::cout << fileNames[printed] << "\t"
+                                  << (printedResult.Failed ? printedResult.Error : printedResult.Text) << std::endl;
+                    }
+                }
+            });
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        auto wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double audioSeconds = 0;
+        size_t failed = 0;
+        for (const auto& result : results)
+        {
+            audioSeconds += result.AudioSeconds;
+            failed += result.Failed ? 1 : 0;
+        }
+        report << concurrencies[run] << "\t" << fileNames.size() << "\t" << failed << "\t"
+               << audioSeconds / 3600 << "\t" << wallSeconds << "\t" << audioSeconds / wallSeconds << std::endl;
+    }
+
+    std::cout << "concurrency\tfiles\tfailed\taudio_hours\twall_seconds\taudio_hours_per_wall_hour" << std::endl;
+    std::cout << report.str();
+}
+
+// Recognizes an 8 kHz G.711 file, as received from a SIP trunk. The codes are expanded and upsampled to 16 kHz PCM
+// in the process and written to a push stream, 20 ms at a time like RTP packets, instead of being decoded by a
+// GStreamer pipeline behind the compressed stream format.
+void recognizeTelephonySpeech(const std::string& fileName, G711Upsampler::Law law)
+{
+    std::ifstream file(fileName, std::ios_base::binary);
+    if (!file.good())
+    {
+        std::cout << "Error: Input file doesn't exist" << std::endl;
+        return;
+    }
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    auto pushStream = AudioInputStream::CreatePushStream(AudioStreamFormat::GetWaveFormatPCM(16000, 16, 1));
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pushStream));
+
+    std::promise<void> recognitionEnd;
+    recognizer->Recognized.Connect([](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            std::cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
+        }
+    });
+    recognizer->Canceled.Connect([](const SpeechRecognitionCanceledEventArgs& e)
+    {
+        std::cout << "CANCELED: Reason=" << (int)e.Reason << std::endl;
+        if (e.Reason == CancellationReason::Error)
+        {
+            std::cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << "\n"
+                      << "CANCELED: ErrorDetails=" << e.ErrorDetails << "\n"
+                      << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    });
+    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs&)
+    {
+        recognitionEnd.set_value();
+    });
+
+    std::cout << "Recognizing ..." << std::endl;
+    recognizer->StartContinuousRecognitionAsync().get();
+
+    G711Upsampler upsampler(law);
+    uint8_t codes[160];
+    std::vector<int16_t> pcm;
+    while (file.read(reinterpret_cast<char*>(codes), sizeof(codes)) || file.gcount() > 0)
+    {
+        pcm.clear();
+        upsampler.Process(codes, static_cast<size_t>(file.gcount()), pcm);
+        pushStream->Write(reinterpret_cast<uint8_t*>(pcm.data()), static_cast<uint32_t>(pcm.size() * sizeof(int16_t)));
+    }
+    pcm.clear();
+    upsampler.Flush(pcm);
+    pushStream->Write(reinterpret_cast<uint8_t*>(pcm.data()), static_cast<uint32_t>(pcm.size() * sizeof(int16_t)));
+    pushStream->Close();
+
+    recognitionEnd.get_future().get();
+    recognizer->StopContinuousRecognitionAsync().get();
+}
+
+// Checks that the vectorized G.711 kernel is bit-exact: the original samples in its output must match the
+// reference tables for every code at every vector lane, and its whole output must match the scalar path for
+// random codes written in blocks of random sizes. Returns false on any difference.
+bool checkG711Kernel()
+{
+    if (!G711Upsampler::IsVectorSupported())
+    {
+        std::cout << "The vectorized G.711 kernel is not supported on this processor, nothing to check." << std::endl;
+        return true;
+    }
+
+    bool passed = true;
+    for (auto law : { G711Upsampler::Law::ALaw, G711Upsampler::Law::MuLaw })
+    {
+        auto name = law == G711Upsampler::Law::ALaw ? "A-law" : "mu-law";
+        auto table = law == G711Upsampler::Law::ALaw ? G711Tables::ALaw() : G711Tables::MuLaw();
+
+        // Each code is placed in every lane, by shifting the sequence of all codes by up to 15 positions.
+        for (size_t shift = 0; shift < 16; shift++)
+        {
+            std::vector<uint8_t> codes(shift, 0);
+            for (int code = 0; code < 256; code++)
+            {
+                codes.push_back(static_cast<uint8_t>(code));
+            }
+
+            G711Upsampler upsampler(law);
+            std::vector<int16_t> pcm;
+            upsampler.Process(codes.data(), codes.size(), pcm);
+            upsampler.Flush(pcm);
+
+            // The original samples are the even output samples, two input samples late.
+            for (size_t i = 0; i < codes.size(); i++)
+            {
+                if (pcm[2 * (i + 2)] != table[codes[i]])
+                {
+                    std::cout << name << ": code " << (int)codes[i] << " expanded to " << pcm[2 * (i + 2)]
+                              << " instead of " << table[codes[i]] << std::endl;
+                    passed = false;
+                }
+            }
+        }
+
+        std::mt19937 random(711);
+        std::vector<uint8_t> codes(1 << 20);
+        for (auto& code : codes)
+        {
+            code = static_cast<uint8_t>(random());
+        }
+        G711Upsampler vectorized(law, true);
+        G711Upsampler scalar(law, false);
+        std::vector<int16_t> vectorizedPcm;
+        std::vector<int16_t> scalarPcm;
+        for (size_t done = 0; done < codes.size();)
+        {
+            auto count = std::min<size_t>(random() % 2000, codes.size() - done);
+            vectorized.Process(codes.data() + done, count, vectorizedPcm);
+            scalar.Process(codes.data() + done, count, scalarPcm);
+            done += count;
+        }
+        vectorized.Flush(vectorizedPcm);
+        scalar.Flush(scalarPcm);
+        if (vectorizedPcm != scalarPcm)
+        {
+            std::cout << name << ": the vectorized output differs from the scalar output." << std::endl;
+            passed = false;
+        }
+        std::cout << name << ": " << (passed ? "bit-exact" : "FAILED") << std::endl;
+    }
+    return passed;
+}
+
+// Measures the throughput of the G.711 expansion and upsampling, vectorized and with the reference tables.
+void benchmarkG711Kernel(int seconds)
+{
+    using clock = std::chrono::steady_clock;
+
+    // One minute of random codes, processed in 20 ms packets.
+    std::mt19937 random(711);
+    std::vector<uint8_t> codes(8000 * 60);
+    for (auto& code : codes)
+    {
+        code = static_cast<uint8_t>(random());
+    }
+
+    std::vector<int16_t> pcm;
+    pcm.reserve(2 * codes.size() + 4);
+    for (auto law : { G711Upsampler::Law::ALaw, G711Upsampler::Law::MuLaw })
+    {
+        for (auto vectorized : { false, true })
+        {
+            G711Upsampler upsampler(law, vectorized);
+            if (vectorized && !upsampler.IsVectorized())
+            {
+                continue;
+            }
+
+            uint64_t processed = 0;
+            auto start = clock::now();
+            auto end = start + std::chrono::seconds(seconds);
+            while (clock::now() < end)
+            {
+                pcm.clear();
+                for (size_t i = 0; i < codes.size(); i += 160)
+                {
+                    upsampler.Process(codes.data() + i, 160, pcm);
+                }
+                processed += codes.size();
+            }
+            auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+            std::cout << (law == G711Upsampler::Law::ALaw ? "A-law " : "mu-law")
+                      << (vectorized ? " vectorized: " : " tables:     ")
+                      << processed / elapsed / 1e6 << " M codes/s, "
+                      << processed / 8000.0 / elapsed << "x real time per core" << std::endl;
+        }
+    }
+}
+
+// Reads the samples of a 16-bit PCM wav file.
+static bool ReadWavFile(const std::string& fileName, std::vector<int16_t>& samples, uint32_t& samplesPerSecond, uint16_t& channels)
+{
+    std::vector<uint8_t> contents;
+    if (!ReadWholeFile(fileName, contents) || contents.size() < 12 ||
+        memcmp(contents.data(), "RIFF", 4) != 0 || memcmp(contents.data() + 8, "WAVE", 4) != 0)
+    {
+        return false;
+    }
+
+    auto read16 = [&contents](size_t offset) { return static_cast<uint16_t>(contents[offset] | contents[offset + 1] << 8); };
+    auto read32 = [&](size_t offset) { return static_cast<uint32_t>(read16(offset) | read16(offset + 2) << 16); };
+    bool isPcm16 = false;
+    for (size_t offset = 12; offset + 8 <= contents.size();)
+    {
+        auto size = std::min<size_t>(read32(offset + 4), contents.size() - offset - 8);
+        if (memcmp(contents.data() + offset, "fmt ", 4) == 0 && size >= 16)
+        {
+            isPcm16 = read16(offset + 8) == 1 && read16(offset + 22) == 16;
+            channels = read16(offset + 10);
+            samplesPerSecond = read32(offset + 12);
+        }
+        else if (memcmp(contents.data() + offset, "data", 4) == 0)
+        {
+            samples.resize(size / 2);
+            memcpy(samples.data(), contents.data() + offset + 8, samples.size() * 2);
+            return isPcm16;
+        }
+        // Chunks are padded to an even size.
+        offset += 8 + size + (size & 1);
+    }
+    return false;
+}
+
+// Recognizes a wav file as it would be captured live, compressing the PCM to Ogg Opus on the client to cut the
+// upload bandwidth. The audio is written to the encode stage at real time, 20 ms at a time, like a microphone;
+// the stage encodes it on its worker thread into a compressed push stream.
+void recognizeSpeechWithOpusUpload(const std::string& wavFileName, int32_t bitrate)
+{
+    std::vector<int16_t> samples;
+    OpusEncodeStage::Options options;
+    uint16_t channels = 0;
+    if (!ReadWavFile(wavFileName, samples, options.SamplesPerSecond, channels) || channels == 0 || channels > 2)
+    {
+        std::cout << "Error: the input file must be a mono or stereo 16-bit PCM wav file" << std::endl;
+        return;
+    }
+    options.Channels = static_cast<uint8_t>(channels);
+    options.Bitrate = bitrate;
+
+    // The encoder is created before recognition starts, so that a sample rate Opus does not support, e.g. 44.1 kHz,
+    // is reported before any audio is sent. The stream holds the Ogg headers until the recognizer reads them.
+    auto pushStream = AudioInputStream::CreatePushStream(AudioStreamFormat::GetCompressedFormat(AudioStreamContainerFormat::OGG_OPUS));
+    std::unique_ptr<OpusEncodeStage> encoder;
+    try
+    {
+        encoder.reset(new OpusEncodeStage(pushStream, options));
+    }
+    catch (const std::invalid_argument& e)
+    {
+        std::cout << "Error: " << e.what() << std::endl;
+        return;
+    }
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pushStream));
+
+    std::promise<void> recognitionEnd;
+    recognizer->Recognized.Connect([](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            std::cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
+        }
+    });
+    recognizer->Canceled.Connect([](const SpeechRecognitionCanceledEventArgs& e)
+    {
+        std::cout << "CANCELED: Reason=" << (int)e.Reason << std::endl;
+        if (e.Reason == CancellationReason::Error)
+        {
+            std::cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << "\n"
+                      << "CANCELED: ErrorDetails=" << e.ErrorDetails << "\n"
+                      << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    });
+    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs&)
+    {
+        recognitionEnd.set_value();
+    });
+
+    std::cout << "Recognizing ..." << std::endl;
+    recognizer->StartContinuousRecognitionAsync().get();
+
+    size_t chunkSamples = options.SamplesPerSecond / 50 * channels;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t offset = 0; offset < samples.size(); offset += chunkSamples)
+    {
+        std::this_thread::sleep_until(start + std::chrono::milliseconds(20 * (offset / chunkSamples)));
+        encoder->Write(samples.data() + offset, std::min(chunkSamples, samples.size() - offset));
+    }
+    encoder->Close();
+
+    recognitionEnd.get_future().get();
+    recognizer->StopContinuousRecognitionAsync().get();
+
+    auto statistics = encoder->GetStatistics();
+    std::cout << statistics.AudioSeconds << " s of audio: PCM " << statistics.PcmKbps << " kbps, Ogg Opus "
+              << statistics.OggOpusKbps << " kbps (" << statistics.PcmKbps / statistics.OggOpusKbps << "x smaller)" << std::endl;
+    std::cout << "Encoder CPU: " << statistics.EncodeCpuSeconds * 1000 << " ms, "
+              << 100 * statistics.EncodeCpuSeconds / statistics.AudioSeconds << "% of one core per stream" << std::endl;
+    std::cout << "Added latency: average " << statistics.AverageLatencyMs << " ms, 95th percentile "
+              << statistics.P95LatencyMs << " ms, max " << statistics.MaxLatencyMs << " ms" << std::endl;
+}
+
 int main(int argc, char **argv) {
+    setlocale(LC_ALL, "");
+    if (argc >= 3 && std::string(argv[1]) == "--pooled")
+    {
+        recognizeSpeechWithPooledDecoders(std::vector<std::string>(argv + 2, argv + argc));
+        return 0;
+    }
+    if (argc >= 3 && std::string(argv[1]) == "--native")
+    {
+        recognizeSpeechWithNativeDecoders(std::vector<std::string>(argv + 2, argv + argc));
+        return 0;
+    }
+    if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--batch")
+    {
+        // Concurrency levels are given as a comma-separated list, e.g. 1,2,4,8.
+        std::vector<int> concurrencies;
+        std::istringstream levels(argc == 4 ? argv[3] : "4");
+        std::string level;
+        while (std::getline(levels, level, ','))
+        {
+            concurrencies.push_back(std::max(1, atoi(level.c_str())));
+        }
+        transcribeBatch(argv[2], concurrencies);
+        return 0;
+    }
+    if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--opus-upload")
+    {
+        recognizeSpeechWithOpusUpload(argv[2], argc == 4 ? std::max(6000, atoi(argv[3])) : 24000);
+        return 0;
+    }
+    if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--decode-throughput")
+    {
+        benchmarkDecodeThroughput(argv[2], argc == 4 ? std::max(1, atoi(argv[3])) : 100);
+        return 0;
+    }
+    if (argc >= 3 && std::string(argv[1]) == "--pool-check")
+    {
+        checkPooledDecoderReuse(std::vector<std::string>(argv + 2, argv + argc));
+        return 0;
+    }
+    if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--decode-benchmark")
+    {
+        benchmarkDecodeSetup(argv[2], argc == 4 ? std::max(1, atoi(argv[3])) : 100);
+        return 0;
+    }
+    if (argc == 2 && std::string(argv[1]) == "--g711-check")
+    {
+        return checkG711Kernel() ? 0 : 1;
+    }
+    if ((argc == 2 || argc == 3) && std::string(argv[1]) == "--g711-benchmark")
+    {
+        benchmarkG711Kernel(argc == 3 ? std::max(1, atoi(argv[2])) : 5);
+        return 0;
+    }
     if (argc != 2)
     {
         std::cout << "Usage: ./compressed-audio-input <filename>" << std::endl;
+        std::cout << "       ./compressed-audio-input --pooled <filename> [<filename> ...]" << std::endl;
+        std::cout << "       ./compressed-audio-input --native <filename> [<filename> ...]" << std::endl;
+        std::cout << "       ./compressed-audio-input --batch <directory|glob|manifest> [<concurrency>[,<concurrency>...]]" << std::endl;
+        std::cout << "       ./compressed-audio-input --opus-upload <wav filename> [<bitrate>]" << std::endl;
+        std::cout << "       ./compressed-audio-input --decode-benchmark <filename> [<clips>]" << std::endl;
+        std::cout << "       ./compressed-audio-input --pool-check <filename> [<filename> ...]" << std::endl;
+        std::cout << "       ./compressed-audio-input --decode-throughput <filename> [<clips>]" << std::endl;
+        std::cout << "       ./compressed-audio-input --g711-check" << std::endl;
+        std::cout << "       ./compressed-audio-input --g711-benchmark [<seconds>]" << std::endl;
+        return 0;
+    }
+
+    // G.711 is expanded in the process rather than going through the compressed stream format.
+    AudioStreamContainerFormat inputFormat;
+    if (GetContainerFormat(argv[1], inputFormat) &&
+        (inputFormat == AudioStreamContainerFormat::ALAW || inputFormat == AudioStreamContainerFormat::MULAW))
+    {
+        recognizeTelephonySpeech(argv[1], inputFormat == AudioStreamContainerFormat::ALAW ? G711Upsampler::Law::ALaw : G711Upsampler::Law::MuLaw);
         return 0;
     }
-    setlocale(LC_ALL, "");
     recognizeSpeech(argv[1]);
     return 0;
 }
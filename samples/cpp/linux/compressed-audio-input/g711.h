@@ -0,0 +1,281 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Expands G.711 A-law or mu-law codes to 16-bit linear PCM, as specified by ITU-T G.711.
+// The tables are built with the reference conversion, the same as the decoders of the ITU-T G.191 tools.
+class G711Tables final
+{
+public:
+    static const int16_t* ALaw()
+    {
+        static const G711Tables tables;
+        return tables.m_alaw;
+    }
+
+    static const int16_t* MuLaw()
+    {
+        static const G711Tables tables;
+        return tables.m_mulaw;
+    }
+
+    static int16_t ExpandALaw(uint8_t code)
+    {
+        int a = code ^ 0x55;
+        int segment = (a & 0x70) >> 4;
+        int t = (a & 0x0F) << 4;
+        switch (segment)
+        {
+        case 0:
+            t += 8;
+            break;
+        case 1:
+            t += 0x108;
+            break;
+        default:
+            t += 0x108;
+            t <<= segment - 1;
+        }
+        return static_cast<int16_t>((a & 0x80) ? t : -t);
+    }
+
+    static int16_t ExpandMuLaw(uint8_t code)
+    {
+        int u = ~code & 0xFF;
+        int t = (((u & 0x0F) << 3) + 0x84) << ((u & 0x70) >> 4);
+        return static_cast<int16_t>((u & 0x80) ? (0x84 - t) : (t - 0x84));
+    }
+
+private:
+    G711Tables()
+    {
+        for (int code = 0; code < 256; code++)
+        {
+            m_alaw[code] = ExpandALaw(static_cast<uint8_t>(code));
+            m_mulaw[code] = ExpandMuLaw(static_cast<uint8_t>(code));
+        }
+    }
+
+    int16_t m_alaw[256];
+    int16_t m_mulaw[256];
+};
+
+// Converts 8 kHz G.711 telephony audio to the 16 kHz, 16-bit PCM preferred by speech recognition, in one pass
+// over blocks small enough to stay in the L1 cache: codes are expanded, then each sample is followed by one
+// interpolated with the 4-tap half-band filter (-1, 9, 9, -1) / 16. The original samples pass through unchanged.
+// Output is delayed by two input samples, which are emitted by Flush() at the end of the stream.
+// On x86 processors with SSSE3, 16 codes are expanded at once, looking up the segment scale factors with byte
+// shuffles; elsewhere, or if Vectorized is off, the reference tables are used. Both give the same output.
+class G711Upsampler final
+{
+public:
+    enum class Law { ALaw, MuLaw };
+
+    explicit G711Upsampler(Law law, bool vectorized = true)
+        : m_law(law),
+          m_vectorized(vectorized && IsVectorSupported())
+    {
+    }
+
+    // Gets whether the processor supports the vectorized kernel.
+    static bool IsVectorSupported()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __builtin_cpu_supports("ssse3") != 0;
+#else
+        return false;
+#endif
+    }
+
+    bool IsVectorized() const
+    {
+        return m_vectorized;
+    }
+
+    // Appends two 16 kHz samples per code.
+    void Process(const uint8_t* codes, size_t count, std::vector<int16_t>& output)
+    {
+        auto offset = output.size();
+        output.resize(offset + 2 * count);
+        for (size_t done = 0; done < count;)
+        {
+            auto block = count - done < blockSize ? count - done : blockSize;
+            Expand(codes + done, block, m_work + historySize);
+            Interpolate(block, output.data() + offset + 2 * done);
+            std::copy(m_work + block, m_work + block + historySize, m_work);
+            done += block;
+        }
+    }
+
+    // Appends the samples still held back, interpolating towards silence.
+    void Flush(std::vector<int16_t>& output)
+    {
+        std::fill(m_work + historySize, m_work + historySize + 2, 0);
+        auto offset = output.size();
+        output.resize(offset + 4);
+        InterpolateScalar(0, 2, output.data() + offset);
+        m_work[0] = m_work[1] = m_work[2] = 0;
+    }
+
+    // Expands codes with the reference tables; the vectorized kernel is checked against this.
+    static void ExpandScalar(Law law, const uint8_t* codes, size_t count, int16_t* samples)
+    {
+        auto table = law == Law::ALaw ? G711Tables::ALaw() : G711Tables::MuLaw();
+        for (size_t i = 0; i < count; i++)
+        {
+            samples[i] = table[codes[i]];
+        }
+    }
+
+private:
+    // The work buffer holds three samples of the previous block, followed by the samples of the current one.
+    static constexpr size_t historySize = 3;
+    static constexpr size_t blockSize = 512;
+
+    void Expand(const uint8_t* codes, size_t count, int16_t* samples) const
+    {
+        size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        if (m_vectorized)
+        {
+            i = m_law == Law::ALaw ? ExpandALawSsse3(codes, count, samples) : ExpandMuLawSsse3(codes, count, samples);
+        }
+#endif
+        ExpandScalar(m_law, codes + i, count - i, samples + i);
+    }
+
+    // Writes the sample at each position p of the block, followed by the interpolation between p and p + 1.
+    void Interpolate(size_t count, int16_t* output) const
+    {
+        size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        if (m_vectorized)
+        {
+            i = InterpolateSsse3(m_work, count, output);
+        }
+#endif
+        InterpolateScalar(i, count, output + 2 * i);
+    }
+
+    void InterpolateScalar(size_t begin, size_t end, int16_t* output) const
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            auto p = m_work + i + 1;
+            int mid = (9 * (p[0] + p[1]) - p[-1] - p[2] + 8) >> 4;
+            *output++ = p[0];
+            *output++ = static_cast<int16_t>(std::max(-32768, std::min(32767, mid)));
+        }
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    // A-law: with a = code ^ 0x55, segment s and mantissa m, the magnitude is (m << 4) + 8 for s = 0,
+    // and ((m << 4) + 0x108) << (s - 1) otherwise; the sign bit set means positive.
+    __attribute__((target("ssse3")))
+    static size_t ExpandALawSsse3(const uint8_t* codes, size_t count, int16_t* samples)
+    {
+        const __m128i scales = _mm_setr_epi8(1, 1, 2, 4, 8, 16, 32, 64, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m128i offsets = _mm_setr_epi8(0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            auto a = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i)), _mm_set1_epi8(0x55));
+            auto segment = _mm_and_si128(_mm_srli_epi16(a, 4), _mm_set1_epi8(0x07));
+            auto scale = _mm_shuffle_epi8(scales, segment);
+            auto offset = _mm_shuffle_epi8(offsets, segment);
+            auto zero = _mm_setzero_si128();
+            Store(ALawHalf(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(scale, zero), _mm_unpacklo_epi8(offset, zero)), samples + i);
+            Store(ALawHalf(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(scale, zero), _mm_unpackhi_epi8(offset, zero)), samples + i + 8);
+        }
+        return i;
+    }
+
+    __attribute__((target("ssse3")))
+    static __m128i ALawHalf(__m128i a, __m128i scale, __m128i offset)
+    {
+        auto mantissa = _mm_slli_epi16(_mm_and_si128(a, _mm_set1_epi16(0x0F)), 4);
+        auto base = _mm_add_epi16(_mm_add_epi16(mantissa, _mm_set1_epi16(8)), _mm_slli_epi16(offset, 8));
+        auto magnitude = _mm_mullo_epi16(base, scale);
+        // Negates where the sign bit is clear.
+        auto negative = _mm_cmpeq_epi16(_mm_and_si128(a, _mm_set1_epi16(0x80)), _mm_setzero_si128());
+        return _mm_sub_epi16(_mm_xor_si128(magnitude, negative), negative);
+    }
+
+    // Mu-law: with u = ~code, segment s and mantissa m, the magnitude is (((m << 3) + 0x84) << s) - 0x84;
+    // the sign bit set means negative.
+    __attribute__((target("ssse3")))
+    static size_t ExpandMuLawSsse3(const uint8_t* codes, size_t count, int16_t* samples)
+    {
+        const __m128i scales = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, static_cast<char>(128), 0, 0, 0, 0, 0, 0, 0, 0);
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            auto u = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i)), _mm_set1_epi8(static_cast<char>(0xFF)));
+            auto segment = _mm_and_si128(_mm_srli_epi16(u, 4), _mm_set1_epi8(0x07));
+            auto scale = _mm_shuffle_epi8(scales, segment);
+            auto zero = _mm_setzero_si128();
+            Store(MuLawHalf(_mm_unpacklo_epi8(u, zero), _mm_unpacklo_epi8(scale, zero)), samples + i);
+            Store(MuLawHalf(_mm_unpackhi_epi8(u, zero), _mm_unpackhi_epi8(scale, zero)), samples + i + 8);
+        }
+        return i;
+    }
+
+    __attribute__((target("ssse3")))
+    static __m128i MuLawHalf(__m128i u, __m128i scale)
+    {
+        auto base = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(u, _mm_set1_epi16(0x0F)), 3), _mm_set1_epi16(0x84));
+        auto magnitude = _mm_sub_epi16(_mm_mullo_epi16(base, scale), _mm_set1_epi16(0x84));
+        auto negative = _mm_cmpeq_epi16(_mm_and_si128(u, _mm_set1_epi16(0x80)), _mm_set1_epi16(0x80));
+        return _mm_sub_epi16(_mm_xor_si128(magnitude, negative), negative);
+    }
+
+    __attribute__((target("ssse3")))
+    static void Store(__m128i samples, int16_t* destination)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination), samples);
+    }
+
+    // Interpolates 8 positions at once, in 32 bits: pairs (p[-1], p[0]) and (p[1], p[2]) are multiplied by
+    // (-1, 9) and (9, -1) and summed, then rounded, shifted and saturated to 16 bits.
+    __attribute__((target("ssse3")))
+    static size_t InterpolateSsse3(const int16_t* work, size_t count, int16_t* output)
+    {
+        const __m128i outer = _mm_setr_epi16(-1, 9, -1, 9, -1, 9, -1, 9);
+        const __m128i inner = _mm_setr_epi16(9, -1, 9, -1, 9, -1, 9, -1);
+        const __m128i rounding = _mm_set1_epi32(8);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            auto p = work + i + 1;
+            auto before = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p - 1));
+            auto current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            auto next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+            auto after = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2));
+
+            auto low = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(before, current), outer), _mm_madd_epi16(_mm_unpacklo_epi16(next, after), inner));
+            auto high = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(before, current), outer), _mm_madd_epi16(_mm_unpackhi_epi16(next, after), inner));
+            low = _mm_srai_epi32(_mm_add_epi32(low, rounding), 4);
+            high = _mm_srai_epi32(_mm_add_epi32(high, rounding), 4);
+            auto mid = _mm_packs_epi32(low, high);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 2 * i), _mm_unpacklo_epi16(current, mid));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 2 * i + 8), _mm_unpackhi_epi16(current, mid));
+        }
+        return i;
+    }
+#endif
+
+    Law m_law;
+    bool m_vectorized;
+    // History, a block, and room for the vectorized interpolation to read past the block.
+    int16_t m_work[historySize + blockSize + 8] = {};
+};
@@ -0,0 +1,366 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Decodes compressed audio clips to 16 kHz, 16-bit mono PCM with a GStreamer pipeline that is built once and
+// reset between clips. Compressed data is written to the appsrc of the pipeline, PCM is read from its appsink.
+class GstDecoder final
+{
+public:
+    explicit GstDecoder(Microsoft::CognitiveServices::Speech::Audio::AudioStreamContainerFormat format)
+    {
+        GError* error = nullptr;
+        m_pipeline = gst_parse_launch(GetPipelineDescription(format).c_str(), &error);
+        if (m_pipeline == nullptr || error != nullptr)
+        {
+            std::string message = error != nullptr ? error->message : "unknown error";
+            if (error != nullptr)
+            {
+                g_error_free(error);
+            }
+            if (m_pipeline != nullptr)
+            {
+                gst_object_unref(m_pipeline);
+            }
+            throw std::runtime_error("Failed to create the decoding pipeline: " + message);
+        }
+
+        m_source = gst_bin_get_by_name(GST_BIN(m_pipeline), "source");
+        m_sink = gst_bin_get_by_name(GST_BIN(m_pipeline), "sink");
+        m_bus = gst_element_get_bus(m_pipeline);
+        LinkDemuxer();
+        if (gst_element_set_state(m_pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+        {
+            Destroy();
+            throw std::runtime_error("Failed to start the decoding pipeline.");
+        }
+    }
+
+    ~GstDecoder()
+    {
+        Destroy();
+    }
+
+    GstDecoder(const GstDecoder&) = delete;
+    GstDecoder& operator=(const GstDecoder&) = delete;
+
+    // Writes compressed data of the current clip.
+    void Write(const uint8_t* data, size_t size)
+    {
+        auto buffer = gst_buffer_new_allocate(nullptr, size, nullptr);
+        gst_buffer_fill(buffer, 0, data, size);
+        // The source takes ownership of the buffer.
+        gst_app_src_push_buffer(GST_APP_SRC(m_source), buffer);
+    }
+
+    // Marks the end of the compressed data of the current clip.
+    void EndOfStream()
+    {
+        gst_app_src_end_of_stream(GST_APP_SRC(m_source));
+    }
+
+    // Reads decoded PCM of the current clip, waiting until some is available.
+    // Returns 0 at the end of the clip, or if the clip cannot be decoded.
+    size_t Read(uint8_t* buffer, size_t size)
+    {
+        if (m_mappedOffset == m_map.size && !NextSample())
+        {
+            return 0;
+        }
+
+        auto count = std::min<size_t>(size, m_map.size - m_mappedOffset);
+        memcpy(buffer, m_map.data + m_mappedOffset, count);
+        m_mappedOffset += count;
+        return count;
+    }
+
+    // Gets whether the pipeline reported an error while decoding the current clip.
+    bool HasFailed() const
+    {
+        return m_failed;
+    }
+
+    // Prepares the decoder for the next clip. Going through the READY state flushes all queued data and resets
+    // the state of the parser and decoder elements, without building them again.
+    // Returns false if the pipeline cannot be restarted and should be discarded.
+    bool Reset()
+    {
+        ReleaseSample();
+        if (gst_element_set_state(m_pipeline, GST_STATE_READY) == GST_STATE_CHANGE_FAILURE)
+        {
+            return false;
+        }
+        gst_element_get_state(m_pipeline, nullptr, nullptr, GST_CLOCK_TIME_NONE);
+
+        // Messages of the previous clip, e.g. its end of stream or errors, are dropped.
+        gst_bus_set_flushing(m_bus, TRUE);
+        gst_bus_set_flushing(m_bus, FALSE);
+
+        m_endOfStream = false;
+        m_failed = false;
+        return gst_element_set_state(m_pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE;
+    }
+
+private:
+    static std::string GetPipelineDescription(Microsoft::CognitiveServices::Speech::Audio::AudioStreamContainerFormat format)
+    {
+        using Microsoft::CognitiveServices::Speech::Audio::AudioStreamContainerFormat;
+
+        const std::string output = " ! audioconvert ! audioresample ! audio/x-raw,format=S16LE,rate=16000,channels=1 ! appsink name=sink sync=false";
+        switch (format)
+        {
+        case AudioStreamContainerFormat::MP3:
+            return "appsrc name=source format=bytes ! mpegaudioparse ! mpg123audiodec" + output;
+        case AudioStreamContainerFormat::OGG_OPUS:
+            // The demuxer is linked in LinkDemuxer(), see there.
+            return "appsrc name=source format=bytes ! oggdemux name=demux opusparse name=parse ! opusdec" + output;
+        case AudioStreamContainerFormat::FLAC:
+            return "appsrc name=source format=bytes ! flacparse ! flacdec" + output;
+        case AudioStreamContainerFormat::ALAW:
+            return "appsrc name=source format=bytes caps=audio/x-alaw,rate=8000,channels=1 ! alawdec" + output;
+        case AudioStreamContainerFormat::MULAW:
+            return "appsrc name=source format=bytes caps=audio/x-mulaw,rate=8000,channels=1 ! mulawdec" + output;
+        default:
+            throw std::invalid_argument("Unsupported container format.");
+        }
+    }
+
+    // Links the source pads of the Ogg demuxer, if any, to the parser. The demuxer adds a pad per stream when
+    // the data of a clip begins and removes it when the pipeline is reset, so the link is made again for every
+    // clip; a link delayed by gst_parse_launch() would only be made for the first clip.
+    void LinkDemuxer()
+    {
+        auto demux = gst_bin_get_by_name(GST_BIN(m_pipeline), "demux");
+        if (demux == nullptr)
+        {
+            return;
+        }
+        auto parse = gst_bin_get_by_name(GST_BIN(m_pipeline), "parse");
+
+        // Both elements are owned by the pipeline, which outlives the signal handler.
+        g_signal_connect(demux, "pad-added", G_CALLBACK(OnDemuxPadAdded), parse);
+        gst_object_unref(parse);
+        gst_object_unref(demux);
+    }
+
+    static void OnDemuxPadAdded(GstElement*, GstPad* pad, gpointer parse)
+    {
+        // Only the first stream of the clip is decoded.
+        auto sinkPad = gst_element_get_static_pad(GST_ELEMENT(parse), "sink");
+        if (!gst_pad_is_linked(sinkPad))
+        {
+            gst_pad_link(pad, sinkPad);
+        }
+        gst_object_unref(sinkPad);
+    }
+
+    bool NextSample()
+    {
+        ReleaseSample();
+        while (!m_endOfStream && !m_failed)
+        {
+            // Waits in short steps, so that a decoding error, which does not end the stream, is noticed.
+            m_sample = gst_app_sink_try_pull_sample(GST_APP_SINK(m_sink), 100 * GST_MSECOND);
+            if (m_sample != nullptr)
+            {
+                m_buffer = gst_sample_get_buffer(m_sample);
+                if (m_buffer != nullptr && gst_buffer_map(m_buffer, &m_map, GST_MAP_READ))
+                {
+                    m_mapped = true;
+                    m_mappedOffset = 0;
+                    return true;
+                }
+                ReleaseSample();
+                continue;
+            }
+
+            m_endOfStream = gst_app_sink_is_eos(GST_APP_SINK(m_sink)) != FALSE;
+            auto message = gst_bus_pop_filtered(m_bus, GST_MESSAGE_ERROR);
+            if (message != nullptr)
+            {
+                m_failed = true;
+                gst_message_unref(message);
+            }
+        }
+        return false;
+    }
+
+    void ReleaseSample()
+    {
+        if (m_mapped)
+        {
+            gst_buffer_unmap(m_buffer, &m_map);
+            m_mapped = false;
+        }
+        if (m_sample != nullptr)
+        {
+            gst_sample_unref(m_sample);
+            m_sample = nullptr;
+        }
+        m_buffer = nullptr;
+        m_map.size = 0;
+        m_mappedOffset = 0;
+    }
+
+    void Destroy()
+    {
+        if (m_pipeline == nullptr)
+        {
+            return;
+        }
+        ReleaseSample();
+        gst_element_set_state(m_pipeline, GST_STATE_NULL);
+        gst_object_unref(m_bus);
+        gst_object_unref(m_sink);
+        gst_object_unref(m_source);
+        gst_object_unref(m_pipeline);
+        m_pipeline = nullptr;
+    }
+
+    GstElement* m_pipeline = nullptr;
+    GstElement* m_source = nullptr;
+    GstElement* m_sink = nullptr;
+    GstBus* m_bus = nullptr;
+
+    GstSample* m_sample = nullptr;
+    GstBuffer* m_buffer = nullptr;
+    GstMapInfo m_map = {};
+    bool m_mapped = false;
+    size_t m_mappedOffset = 0;
+    bool m_endOfStream = false;
+    bool m_failed = false;
+};
+
+// Pool of decoders, per container format. GStreamer is initialized once per process; decoders are built on first
+// use, reset when released and handed out again, so a clip only pays for building a pipeline when all the
+// pipelines of its format are busy. The pool must outlive the decoders acquired from it.
+class GstDecoderPool final
+{
+public:
+    // Decoder acquired from the pool, returned to it when destroyed.
+    using Lease = std::unique_ptr<GstDecoder, std::function<void(GstDecoder*)>>;
+
+    // Constructor that keeps at most the given number of idle decoders per format.
+    explicit GstDecoderPool(size_t maxIdlePerFormat = 8)
+        : m_maxIdlePerFormat(maxIdlePerFormat)
+    {
+        Initialize();
+    }
+
+    GstDecoderPool(const GstDecoderPool&) = delete;
+    GstDecoderPool& operator=(const GstDecoderPool&) = delete;
+
+    Lease Acquire(Microsoft::CognitiveServices::Speech::Audio::AudioStreamContainerFormat format)
+    {
+        std::unique_ptr<GstDecoder> decoder;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto& idle = m_idle[format];
+            if (!idle.empty())
+            {
+                decoder = std::move(idle.back());
+                idle.pop_back();
+                m_reusedCount++;
+            }
+            else
+            {
+                m_createdCount++;
+            }
+        }
+
+        if (!decoder)
+        {
+            decoder.reset(new GstDecoder(format));
+        }
+        return Lease(decoder.release(), [this, format](GstDecoder* released) { Release(format, released); });
+    }
+
+    // Initializes GStreamer, once per process. Called by the pool, and by code building pipelines on its own.
+    static void Initialize()
+    {
+        static std::once_flag once;
+        std::call_once(once, []() { gst_init(nullptr, nullptr); });
+    }
+
+    // Gets the number of decoders built, and of clips served by a reused decoder.
+    uint64_t GetCreatedCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_createdCount;
+    }
+
+    uint64_t GetReusedCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_reusedCount;
+    }
+
+private:
+    void Release(Microsoft::CognitiveServices::Speech::Audio::AudioStreamContainerFormat format, GstDecoder* released)
+    {
+        std::unique_ptr<GstDecoder> decoder(released);
+
+        // The reset is done here rather than in Acquire(), off the path of the next clip.
+        if (!decoder->Reset())
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& idle = m_idle[format];
+        if (idle.size() < m_maxIdlePerFormat)
+        {
+            idle.push_back(std::move(decoder));
+        }
+    }
+
+    const size_t m_maxIdlePerFormat;
+    mutable std::mutex m_mutex;
+    std::map<Microsoft::CognitiveServices::Speech::Audio::AudioStreamContainerFormat, std::vector<std::unique_ptr<GstDecoder>>> m_idle;
+    uint64_t m_createdCount = 0;
+    uint64_t m_reusedCount = 0;
+};
+
+// Pull audio input stream callback reading the PCM decoded by a pooled decoder.
+class GstDecoderInputCallback final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+{
+public:
+    explicit GstDecoderInputCallback(GstDecoderPool::Lease decoder)
+        : m_decoder(std::move(decoder))
+    {
+    }
+
+    int Read(uint8_t* dataBuffer, uint32_t size) override
+    {
+        if (!m_decoder)
+        {
+            return 0;
+        }
+        return static_cast<int>(m_decoder->Read(dataBuffer, size));
+    }
+
+    // Returns the decoder to the pool.
+    void Close() override
+    {
+        m_decoder.reset();
+    }
+
+private:
+    GstDecoderPool::Lease m_decoder;
+};
@@ -0,0 +1,421 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <FLAC/stream_decoder.h>
+#include <opusfile.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "g711.h"
+
+// Low-pass filter and integer-factor decimator, e.g. from 48 kHz to 16 kHz, for mono audio.
+// The filter is a Blackman-windowed sinc cutting off just below the output Nyquist frequency.
+class Decimator final
+{
+public:
+    explicit Decimator(int factor)
+        : m_factor(factor)
+    {
+        if (factor <= 1)
+        {
+            return;
+        }
+
+        const int taps = 32 * factor + 1;
+        const double pi = 3.14159265358979323846;
+        const double cutoff = 0.45 / factor;   // Relative to the input sample rate.
+        m_coefficients.resize(taps);
+        double sum = 0;
+        for (int i = 0; i < taps; i++)
+        {
+            double n = i - (taps - 1) / 2.0;
+            double sinc = n == 0 ? 2 * cutoff : sin(2 * pi * cutoff * n) / (pi * n);
+            double window = 0.42 - 0.5 * cos(2 * pi * i / (taps - 1)) + 0.08 * cos(4 * pi * i / (taps - 1));
+            m_coefficients[i] = static_cast<float>(sinc * window);
+            sum += m_coefficients[i];
+        }
+        for (auto& c : m_coefficients)
+        {
+            c = static_cast<float>(c / sum);
+        }
+        m_history.assign(taps - 1, 0.0f);
+    }
+
+    // Filters the input samples and appends every factor-th output sample.
+    void Process(const float* input, size_t count, std::vector<int16_t>& output)
+    {
+        if (m_factor <= 1)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                output.push_back(Clamp(input[i]));
+            }
+            return;
+        }
+
+        // The history holds the last taps - 1 input samples from m_historyStart on, followed by the new ones.
+        auto taps = m_coefficients.size();
+        m_history.insert(m_history.end(), input, input + count);
+        size_t position = m_historyStart;
+        for (; position + taps <= m_history.size(); position++)
+        {
+            if (m_phase++ % m_factor != 0)
+            {
+                continue;
+            }
+            float sum = 0;
+            for (size_t k = 0; k < taps; k++)
+            {
+                sum += m_coefficients[k] * m_history[position + k];
+            }
+            output.push_back(Clamp(sum));
+        }
+        m_historyStart = position;
+
+        // The samples consumed are only dropped once they outnumber the samples kept, rather than on every call,
+        // so that each sample is moved at most once on average.
+        if (m_historyStart >= m_history.size() - m_historyStart)
+        {
+            m_history.erase(m_history.begin(), m_history.begin() + m_historyStart);
+            m_historyStart = 0;
+        }
+    }
+
+private:
+    static int16_t Clamp(float sample)
+    {
+        return static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, std::round(sample))));
+    }
+
+    int m_factor;
+    unsigned m_phase = 0;
+    std::vector<float> m_coefficients;
+    std::vector<float> m_history;
+    size_t m_historyStart = 0;
+};
+
+// Error thrown when opening a file with a sample rate the native decoders do not resample, unlike a file that
+// cannot be decoded at all; such a file can still be decoded with GStreamer.
+class UnsupportedSampleRateError final : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Decoder turning a compressed file into 16-bit mono PCM in the process, without GStreamer.
+// The output sample rate is 16 kHz, or 8 kHz for 8 kHz input, the PCM rates accepted by the SDK.
+class NativeDecoder
+{
+public:
+    virtual ~NativeDecoder() = default;
+
+    // Reads up to count samples, decoding as needed. Returns the number of samples read, 0 at the end of the file.
+    size_t Read(int16_t* samples, size_t count)
+    {
+        while (m_pendingOffset == m_pending.size() && !m_finished)
+        {
+            m_pending.clear();
+            m_pendingOffset = 0;
+            m_finished = !DecodeMore(m_pending);
+        }
+
+        count = std::min(count, m_pending.size() - m_pendingOffset);
+        memcpy(samples, m_pending.data() + m_pendingOffset, count * sizeof(int16_t));
+        m_pendingOffset += count;
+        return count;
+    }
+
+    uint32_t GetSamplesPerSecond() const
+    {
+        return m_samplesPerSecond;
+    }
+
+    // Gets whether the file could not be decoded completely.
+    bool HasFailed() const
+    {
+        return m_failed;
+    }
+
+protected:
+    // Appends the next decoded samples. Returns false at the end of the file or on error.
+    virtual bool DecodeMore(std::vector<int16_t>& samples) = 0;
+
+    // Gets the factor from the input sample rate to the output sample rate, setting the output rate.
+    int SetInputSampleRate(uint32_t inputSamplesPerSecond)
+    {
+        if (inputSamplesPerSecond == 8000)
+        {
+            m_samplesPerSecond = 8000;
+            return 1;
+        }
+        if (inputSamplesPerSecond % 16000 != 0 || inputSamplesPerSecond == 0 || inputSamplesPerSecond > 48000)
+        {
+            throw UnsupportedSampleRateError("Unsupported sample rate " + std::to_string(inputSamplesPerSecond) + ", only 8, 16, 32 and 48 kHz are decoded natively.");
+        }
+        m_samplesPerSecond = 16000;
+        return static_cast<int>(inputSamplesPerSecond / 16000);
+    }
+
+    bool m_failed = false;
+
+private:
+    uint32_t m_samplesPerSecond = 16000;
+    std::vector<int16_t> m_pending;
+    size_t m_pendingOffset = 0;
+    bool m_finished = false;
+};
+
+// FLAC decoder using libFLAC. Channels are mixed down to mono and samples scaled to 16 bits.
+class FlacDecoder final : public NativeDecoder
+{
+public:
+    explicit FlacDecoder(const std::string& fileName)
+        : m_decoder(FLAC__stream_decoder_new())
+    {
+        if (m_decoder == nullptr ||
+            FLAC__stream_decoder_init_file(m_decoder, fileName.c_str(), OnWrite, OnMetadata, OnError, this) != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+        {
+            Destroy();
+            throw std::invalid_argument("Failed to open the specified FLAC file.");
+        }
+
+        // The sample rate is in the stream info, at the start of the file.
+        if (!FLAC__stream_decoder_process_until_end_of_metadata(m_decoder) || m_inputSamplesPerSecond == 0)
+        {
+            Destroy();
+            throw std::runtime_error("Invalid FLAC file, no stream info found.");
+        }
+        m_decimator.reset(new Decimator(SetInputSampleRate(m_inputSamplesPerSecond)));
+    }
+
+    ~FlacDecoder()
+    {
+        Destroy();
+    }
+
+protected:
+    bool DecodeMore(std::vector<int16_t>& samples) override
+    {
+        m_output = &samples;
+        while (samples.empty())
+        {
+            if (!FLAC__stream_decoder_process_single(m_decoder))
+            {
+                m_failed = true;
+                return false;
+            }
+            if (FLAC__stream_decoder_get_state(m_decoder) == FLAC__STREAM_DECODER_END_OF_STREAM || m_failed)
+            {
+                return !samples.empty();
+            }
+        }
+        return true;
+    }
+
+private:
+    static FLAC__StreamDecoderWriteStatus OnWrite(const FLAC__StreamDecoder*, const FLAC__Frame* frame, const FLAC__int32* const buffer[], void* clientData)
+    {
+        auto self = static_cast<FlacDecoder*>(clientData);
+        auto channels = frame->header.channels;
+        auto blockSize = frame->header.blocksize;
+
+        // Scales to the range of 16-bit samples and averages the channels.
+        float scale = 1.0f / (static_cast<float>(1u << (frame->header.bits_per_sample - 1)) / 32768.0f) / channels;
+        self->m_mono.resize(blockSize);
+        for (unsigned i = 0; i < blockSize; i++)
+        {
+            FLAC__int64 sum = 0;
+            for (unsigned c = 0; c < channels; c++)
+            {
+                sum += buffer[c][i];
+            }
+            self->m_mono[i] = static_cast<float>(sum) * scale;
+        }
+        self->m_decimator->Process(self->m_mono.data(), blockSize, *self->m_output);
+        return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+    }
+
+    static void OnMetadata(const FLAC__StreamDecoder*, const FLAC__StreamMetadata* metadata, void* clientData)
+    {
+        if (metadata->type == FLAC__METADATA_TYPE_STREAMINFO)
+        {
+            static_cast<FlacDecoder*>(clientData)->m_inputSamplesPerSecond = metadata->data.stream_info.sample_rate;
+        }
+    }
+
+    static void OnError(const FLAC__StreamDecoder*, FLAC__StreamDecoderErrorStatus, void* clientData)
+    {
+        static_cast<FlacDecoder*>(clientData)->m_failed = true;
+    }
+
+    void Destroy()
+    {
+        if (m_decoder != nullptr)
+        {
+            FLAC__stream_decoder_finish(m_decoder);
+            FLAC__stream_decoder_delete(m_decoder);
+            m_decoder = nullptr;
+        }
+    }
+
+    FLAC__StreamDecoder* m_decoder;
+    uint32_t m_inputSamplesPerSecond = 0;
+    std::unique_ptr<Decimator> m_decimator;
+    std::vector<float> m_mono;
+    std::vector<int16_t>* m_output = nullptr;
+};
+
+// Ogg Opus decoder using libopusfile, which always decodes at 48 kHz; the output is decimated to 16 kHz.
+class OggOpusDecoder final : public NativeDecoder
+{
+public:
+    explicit OggOpusDecoder(const std::string& fileName)
+        : m_decimator(SetInputSampleRate(48000))
+    {
+        int error = 0;
+        m_file = op_open_file(fileName.c_str(), &error);
+        if (m_file == nullptr)
+        {
+            throw std::invalid_argument("Failed to open the specified Ogg Opus file, error " + std::to_string(error) + ".");
+        }
+    }
+
+    ~OggOpusDecoder()
+    {
+        op_free(m_file);
+    }
+
+protected:
+    bool DecodeMore(std::vector<int16_t>& samples) override
+    {
+        while (samples.empty())
+        {
+            // Up to 120 ms of 48 kHz stereo audio, the longest Opus packet.
+            int link = 0;
+            auto count = op_read(m_file, m_decoded, sizeof(m_decoded) / sizeof(m_decoded[0]), &link);
+            if (count <= 0)
+            {
+                m_failed = count < 0;
+                return false;
+            }
+
+            auto channels = op_channel_count(m_file, link);
+            m_mono.resize(count);
+            for (int i = 0; i < count; i++)
+            {
+                int sum = 0;
+                for (int c = 0; c < channels; c++)
+                {
+                    sum += m_decoded[i * channels + c];
+                }
+                m_mono[i] = static_cast<float>(sum) / channels;
+            }
+            m_decimator.Process(m_mono.data(), m_mono.size(), samples);
+        }
+        return true;
+    }
+
+private:
+    Decimator m_decimator;
+    OggOpusFile* m_file = nullptr;
+    opus_int16 m_decoded[5760 * 2];
+    std::vector<float> m_mono;
+};
+
+// G.711 decoder for headerless 8 kHz A-law or mu-law files, upsampled to 16 kHz.
+class G711Decoder final : public NativeDecoder
+{
+public:
+    G711Decoder(const std::string& fileName, G711Upsampler::Law law)
+        : m_file(fileName, std::ios_base::binary),
+          m_upsampler(law)
+    {
+        if (!m_file.good())
+        {
+            throw std::invalid_argument("Failed to open the specified G.711 file.");
+        }
+        SetInputSampleRate(16000);
+    }
+
+protected:
+    bool DecodeMore(std::vector<int16_t>& samples) override
+    {
+        if (m_flushed)
+        {
+            return false;
+        }
+
+        m_file.read(reinterpret_cast<char*>(m_codes), sizeof(m_codes));
+        auto count = static_cast<size_t>(m_file.gcount());
+        m_upsampler.Process(m_codes, count, samples);
+        if (count < sizeof(m_codes))
+        {
+            m_failed = m_file.bad();
+            m_upsampler.Flush(samples);
+            m_flushed = true;
+        }
+        return true;
+    }
+
+private:
+    std::ifstream m_file;
+    G711Upsampler m_upsampler;
+    uint8_t m_codes[4096];
+    bool m_flushed = false;
+};
+
+// Creates the native decoder of a container format, or returns nullptr if it has none and GStreamer is needed.
+inline std::unique_ptr<NativeDecoder> CreateNativeDecoder(Microsoft::CognitiveServices::Speech::Audio::AudioStreamContainerFormat format, const std::string& fileName)
+{
+    using Microsoft::CognitiveServices::Speech::Audio::AudioStreamContainerFormat;
+
+    switch (format)
+    {
+    case AudioStreamContainerFormat::FLAC:
+        return std::unique_ptr<NativeDecoder>(new FlacDecoder(fileName));
+    case AudioStreamContainerFormat::OGG_OPUS:
+        return std::unique_ptr<NativeDecoder>(new OggOpusDecoder(fileName));
+    case AudioStreamContainerFormat::ALAW:
+        return std::unique_ptr<NativeDecoder>(new G711Decoder(fileName, G711Upsampler::Law::ALaw));
+    case AudioStreamContainerFormat::MULAW:
+        return std::unique_ptr<NativeDecoder>(new G711Decoder(fileName, G711Upsampler::Law::MuLaw));
+    default:
+        return nullptr;
+    }
+}
+
+// Pull audio input stream callback reading the PCM of a native decoder.
+class NativeDecoderInputCallback final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+{
+public:
+    explicit NativeDecoderInputCallback(std::unique_ptr<NativeDecoder> decoder)
+        : m_decoder(std::move(decoder))
+    {
+    }
+
+    int Read(uint8_t* dataBuffer, uint32_t size) override
+    {
+        // The buffer may not be aligned for 16-bit samples.
+        m_samples.resize(size / sizeof(int16_t));
+        auto count = m_decoder->Read(m_samples.data(), m_samples.size());
+        memcpy(dataBuffer, m_samples.data(), count * sizeof(int16_t));
+        return static_cast<int>(count * sizeof(int16_t));
+    }
+
+    void Close() override
+    {
+    }
+
+private:
+    std::unique_ptr<NativeDecoder> m_decoder;
+    std::vector<int16_t> m_samples;
+};
@@ -0,0 +1,396 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <opus.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes Opus packets as an Ogg Opus stream (RFC 7845): an identification header page, a comment header page,
+// then pages of audio packets, each page written out as soon as it is complete.
+class OggOpusWriter final
+{
+public:
+    using Output = std::function<void(const uint8_t* data, size_t size)>;
+
+    // The pre-skip is the encoder lookahead, in 48 kHz samples, that players drop at the start.
+    OggOpusWriter(Output output, uint32_t inputSamplesPerSecond, uint8_t channels, uint16_t preSkip)
+        : m_output(output),
+          m_preSkip(preSkip)
+    {
+        std::vector<uint8_t> head = { 'O', 'p', 'u', 's', 'H', 'e', 'a', 'd', 1, channels };
+        AppendLittleEndian(head, preSkip, 2);
+        AppendLittleEndian(head, inputSamplesPerSecond, 4);
+        AppendLittleEndian(head, 0, 2);     // Output gain.
+        head.push_back(0);                  // Channel mapping family 0: mono or stereo.
+        AddPacket(head.data(), head.size(), 0);
+        WritePageOfType(0x02);
+
+        static const char vendor[] = "Speech SDK sample";
+        std::vector<uint8_t> tags = { 'O', 'p', 'u', 's', 'T', 'a', 'g', 's' };
+        AppendLittleEndian(tags, sizeof(vendor) - 1, 4);
+        tags.insert(tags.end(), vendor, vendor + sizeof(vendor) - 1);
+        AppendLittleEndian(tags, 0, 4);     // No user comments.
+        AddPacket(tags.data(), tags.size(), 0);
+        WritePageOfType(0);
+    }
+
+    // Adds an audio packet holding the given number of 48 kHz samples.
+    void AddPacket(const uint8_t* packet, size_t size, uint32_t samples48k)
+    {
+        // A page holds at most 255 segments, so the packets added before are written first if needed.
+        if (m_segments.size() + size / 255 + 1 > 255)
+        {
+            WritePageOfType(0);
+        }
+
+        // Lacing values: runs of 255 and a last value below 255, 0 if the size is a multiple of 255.
+        for (size_t remaining = size;; remaining -= 255)
+        {
+            m_segments.push_back(static_cast<uint8_t>(std::min<size_t>(remaining, 255)));
+            if (remaining < 255)
+            {
+                break;
+            }
+        }
+        m_body.insert(m_body.end(), packet, packet + size);
+        m_granulePosition += samples48k;
+        m_packetCount++;
+    }
+
+    size_t GetPendingPacketCount() const
+    {
+        return m_packetCount;
+    }
+
+    // Writes the packets added since the last page as one page. The end of stream page gives the exact number
+    // of samples, so that the padding of the last frame is dropped by decoders.
+    void WritePage(bool endOfStream, uint64_t totalSamples48k = 0)
+    {
+        if (endOfStream)
+        {
+            m_granulePosition = std::min(m_granulePosition, m_preSkip + totalSamples48k);
+        }
+        WritePageOfType(endOfStream ? 0x04 : 0);
+    }
+
+private:
+    static void AppendLittleEndian(std::vector<uint8_t>& buffer, uint64_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; i++)
+        {
+            buffer.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void WritePageOfType(uint8_t headerType)
+    {
+        std::vector<uint8_t> page = { 'O', 'g', 'g', 'S', 0, headerType };
+        AppendLittleEndian(page, m_granulePosition, 8);
+        AppendLittleEndian(page, m_serialNumber, 4);
+        AppendLittleEndian(page, m_pageSequence++, 4);
+        AppendLittleEndian(page, 0, 4);     // CRC, computed below with this field set to zero.
+        page.push_back(static_cast<uint8_t>(m_segments.size()));
+        page.insert(page.end(), m_segments.begin(), m_segments.end());
+        page.insert(page.end(), m_body.begin(), m_body.end());
+
+        uint32_t crc = 0;
+        for (auto byte : page)
+        {
+            crc = (crc << 8) ^ CrcTable()[((crc >> 24) ^ byte) & 0xFF];
+        }
+        for (int i = 0; i < 4; i++)
+        {
+            page[22 + i] = static_cast<uint8_t>(crc >> (8 * i));
+        }
+
+        m_output(page.data(), page.size());
+        m_segments.clear();
+        m_body.clear();
+        m_packetCount = 0;
+    }
+
+    // CRC-32 with polynomial 0x04C11DB7, not reflected, as specified for Ogg.
+    static const uint32_t* CrcTable()
+    {
+        static const std::vector<uint32_t> table = []()
+        {
+            std::vector<uint32_t> values(256);
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t crc = i << 24;
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+                }
+                values[i] = crc;
+            }
+            return values;
+        }();
+        return table.data();
+    }
+
+    Output m_output;
+    uint64_t m_preSkip;
+    uint64_t m_granulePosition = 0;
+    uint32_t m_serialNumber = 0x53504B53;
+    uint32_t m_pageSequence = 0;
+    std::vector<uint8_t> m_segments;
+    std::vector<uint8_t> m_body;
+    size_t m_packetCount = 0;
+};
+
+// Encodes PCM written by a capture thread to Ogg Opus on a worker thread, and writes the pages to a push stream
+// created with AudioStreamFormat::GetCompressedFormat(AudioStreamContainerFormat::OGG_OPUS). Packets are gathered
+// into pages of up to MaxPageMs of audio: longer pages save Ogg overhead, shorter ones cut the added latency.
+class OpusEncodeStage final
+{
+public:
+    struct Options
+    {
+        uint32_t SamplesPerSecond = 16000;  // 8, 12, 16, 24 or 48 kHz.
+        uint8_t Channels = 1;               // 1 or 2, as written with channel mapping family 0.
+        int32_t Bitrate = 24000;            // Bits per second.
+        int Complexity = 5;                 // 0 to 10, trading quality for encoder CPU.
+        uint32_t FrameMs = 20;              // 10, 20, 40 or 60.
+        uint32_t MaxPageMs = 100;
+    };
+
+    struct Statistics
+    {
+        double AudioSeconds = 0;
+        double PcmKbps = 0;
+        double OggOpusKbps = 0;             // Including the Ogg headers.
+        double EncodeCpuSeconds = 0;        // CPU time of the worker thread.
+        double AverageLatencyMs = 0;        // From the last sample of a frame written to its page written out.
+        double P95LatencyMs = 0;
+        double MaxLatencyMs = 0;
+    };
+
+    // Constructor that throws std::invalid_argument for options Opus does not support, e.g. a 44.1 kHz input;
+    // such audio must be resampled first. Nothing is written to the stream in that case.
+    OpusEncodeStage(std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> stream, const Options& options)
+        : m_stream(stream),
+          m_options(CheckOptions(options)),
+          m_frameSamples(options.SamplesPerSecond / 1000 * options.FrameMs)
+    {
+        int error = OPUS_OK;
+        m_encoder = opus_encoder_create(static_cast<opus_int32>(options.SamplesPerSecond), options.Channels, OPUS_APPLICATION_VOIP, &error);
+        if (m_encoder == nullptr || error != OPUS_OK)
+        {
+            throw std::invalid_argument("Failed to create the Opus encoder, check the sample rate and channels.");
+        }
+        opus_encoder_ctl(m_encoder, OPUS_SET_BITRATE(options.Bitrate));
+        opus_encoder_ctl(m_encoder, OPUS_SET_COMPLEXITY(options.Complexity));
+        opus_int32 lookahead = 0;
+        opus_encoder_ctl(m_encoder, OPUS_GET_LOOKAHEAD(&lookahead));
+
+        m_writer.reset(new OggOpusWriter([this](const uint8_t* data, size_t size)
+        {
+            m_stream->Write(const_cast<uint8_t*>(data), static_cast<uint32_t>(size));
+            m_outputBytes += size;
+        }, options.SamplesPerSecond, options.Channels, static_cast<uint16_t>(lookahead * (48000 / options.SamplesPerSecond))));
+        m_worker = std::thread([this]() { Run(); });
+    }
+
+    ~OpusEncodeStage()
+    {
+        Close();
+        opus_encoder_destroy(m_encoder);
+    }
+
+    OpusEncodeStage(const OpusEncodeStage&) = delete;
+    OpusEncodeStage& operator=(const OpusEncodeStage&) = delete;
+
+    // Queues interleaved samples for encoding; returns at once.
+    void Write(const int16_t* samples, size_t count)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending.insert(m_pending.end(), samples, samples + count);
+            m_inputSamples += count;
+
+            // The time each frame is complete, to measure the latency added by encoding and paging.
+            auto now = Clock::now();
+            for (auto frameEnd = (m_frameEnds.size() + m_encodedFrames + 1) * m_frameSamples * m_options.Channels;
+                 frameEnd <= m_inputSamples; frameEnd += m_frameSamples * m_options.Channels)
+            {
+                m_frameEnds.push_back(now);
+            }
+        }
+        m_available.notify_one();
+    }
+
+    // Encodes the rest of the audio, padding the last frame, writes the end of stream page and closes the stream.
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closing)
+            {
+                return;
+            }
+            m_closing = true;
+        }
+        m_available.notify_one();
+        m_worker.join();
+        m_stream->Close();
+    }
+
+    // Gets the statistics of the stream, once closed.
+    Statistics GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Statistics statistics;
+        statistics.AudioSeconds = static_cast<double>(m_inputSamples) / m_options.Channels / m_options.SamplesPerSecond;
+        if (statistics.AudioSeconds > 0)
+        {
+            statistics.PcmKbps = m_inputSamples * 16 / statistics.AudioSeconds / 1000;
+            statistics.OggOpusKbps = m_outputBytes.load() * 8 / statistics.AudioSeconds / 1000;
+        }
+        statistics.EncodeCpuSeconds = m_cpuSeconds;
+
+        auto latencies = m_latenciesMs;
+        if (!latencies.empty())
+        {
+            double sum = 0;
+            for (auto latency : latencies)
+            {
+                sum += latency;
+            }
+            statistics.AverageLatencyMs = sum / latencies.size();
+            std::sort(latencies.begin(), latencies.end());
+            statistics.P95LatencyMs = latencies[latencies.size() * 95 / 100];
+            statistics.MaxLatencyMs = latencies.back();
+        }
+        return statistics;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static const Options& CheckOptions(const Options& options)
+    {
+        auto rate = options.SamplesPerSecond;
+        if (rate != 8000 && rate != 12000 && rate != 16000 && rate != 24000 && rate != 48000)
+        {
+            throw std::invalid_argument("Unsupported sample rate " + std::to_string(rate) + ", Opus encodes 8, 12, 16, 24 or 48 kHz audio.");
+        }
+        if (options.Channels < 1 || options.Channels > 2)
+        {
+            throw std::invalid_argument("Unsupported channel count " + std::to_string(options.Channels) + ", only mono and stereo audio is encoded.");
+        }
+        if (options.FrameMs != 10 && options.FrameMs != 20 && options.FrameMs != 40 && options.FrameMs != 60)
+        {
+            throw std::invalid_argument("Unsupported frame duration " + std::to_string(options.FrameMs) + " ms, Opus frames of 10, 20, 40 or 60 ms are encoded.");
+        }
+        return options;
+    }
+
+    static double ThreadCpuSeconds()
+    {
+        timespec time = {};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+        return time.tv_sec + time.tv_nsec / 1e9;
+    }
+
+    void Run()
+    {
+        auto frameSize = m_frameSamples * m_options.Channels;
+        auto samples48k = static_cast<uint32_t>(48000 / 1000 * m_options.FrameMs);
+        auto framesPerPage = std::max<uint32_t>(m_options.MaxPageMs / m_options.FrameMs, 1);
+        std::vector<int16_t> frame(frameSize);
+        std::vector<uint8_t> packet(4000);
+        std::vector<Clock::time_point> pageFrameEnds;
+        std::vector<double> latencies;
+        double cpuSeconds = 0;
+        bool closing = false;
+
+        while (!closing)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_available.wait(lock, [&]() { return m_pending.size() >= frameSize || m_closing; });
+                closing = m_closing && m_pending.size() < frameSize;
+                if (closing)
+                {
+                    // The last, partial frame is padded with silence.
+                    if (m_pending.empty())
+                    {
+                        break;
+                    }
+                    m_pending.resize(frameSize, 0);
+                    m_frameEnds.push_back(Clock::now());
+                }
+                std::copy(m_pending.begin(), m_pending.begin() + frameSize, frame.begin());
+                m_pending.erase(m_pending.begin(), m_pending.begin() + frameSize);
+                pageFrameEnds.push_back(m_frameEnds.front());
+                m_frameEnds.pop_front();
+                m_encodedFrames++;
+            }
+
+            auto cpuStart = ThreadCpuSeconds();
+            auto size = opus_encode(m_encoder, frame.data(), static_cast<int>(m_frameSamples), packet.data(), static_cast<opus_int32>(packet.size()));
+            if (size > 0)
+            {
+                m_writer->AddPacket(packet.data(), static_cast<size_t>(size), samples48k);
+            }
+            if (m_writer->GetPendingPacketCount() >= framesPerPage)
+            {
+                m_writer->WritePage(false);
+                RecordLatencies(pageFrameEnds, latencies);
+            }
+            cpuSeconds += ThreadCpuSeconds() - cpuStart;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_writer->WritePage(true, m_inputSamples / m_options.Channels * (48000 / m_options.SamplesPerSecond));
+        RecordLatencies(pageFrameEnds, latencies);
+        m_latenciesMs = std::move(latencies);
+        m_cpuSeconds = cpuSeconds;
+    }
+
+    // Records the latency of the frames of the page just written out.
+    static void RecordLatencies(std::vector<Clock::time_point>& frameEnds, std::vector<double>& latencies)
+    {
+        auto now = Clock::now();
+        for (auto frameEnd : frameEnds)
+        {
+            latencies.push_back(std::chrono::duration<double, std::milli>(now - frameEnd).count());
+        }
+        frameEnds.clear();
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> m_stream;
+    Options m_options;
+    size_t m_frameSamples;
+    OpusEncoder* m_encoder = nullptr;
+    std::unique_ptr<OggOpusWriter> m_writer;
+    std::thread m_worker;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_available;
+    std::deque<int16_t> m_pending;
+    std::deque<Clock::time_point> m_frameEnds;
+    uint64_t m_inputSamples = 0;
+    uint64_t m_encodedFrames = 0;
+    bool m_closing = false;
+
+    std::atomic<uint64_t> m_outputBytes{ 0 };
+    double m_cpuSeconds = 0;
+    std::vector<double> m_latenciesMs;
+};
@@ -0,0 +1,320 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream> // cin, cout
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <speechapi_cxx.h>
+#include "rtp_ingest.h"
+
+using namespace Microsoft::CognitiveServices::Speech;
+using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+static bool ReadWholeFile(const std::string& fileName, std::vector<uint8_t>& contents)
+{
+    std::ifstream file(fileName, std::ios_base::binary);
+    if (!file.good())
+    {
+        return false;
+    }
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Reads the samples of a 16-bit PCM wav file.
+static bool ReadWavFile(const std::string& fileName, std::vector<int16_t>& samples, uint32_t& samplesPerSecond, uint16_t& channels)
+{
+    std::vector<uint8_t> contents;
+    if (!ReadWholeFile(fileName, contents) || contents.size() < 12 ||
+        memcmp(contents.data(), "RIFF", 4) != 0 || memcmp(contents.data() + 8, "WAVE", 4) != 0)
+    {
+        return false;
+    }
+
+    auto read16 = [&contents](size_t offset) { return static_cast<uint16_t>(contents[offset] | contents[offset + 1] << 8); };
+    auto read32 = [&](size_t offset) { return static_cast<uint32_t>(read16(offset) | read16(offset + 2) << 16); };
+    bool isPcm16 = false;
+    for (size_t offset = 12; offset + 8 <= contents.size();)
+    {
+        auto size = std::min<size_t>(read32(offset + 4), contents.size() - offset - 8);
+        if (memcmp(contents.data() + offset, "fmt ", 4) == 0 && size >= 16)
+        {
+            isPcm16 = read16(offset + 8) == 1 && read16(offset + 22) == 16;
+            channels = read16(offset + 10);
+            samplesPerSecond = read32(offset + 12);
+        }
+        else if (memcmp(contents.data() + offset, "data", 4) == 0)
+        {
+            samples.resize(size / 2);
+            memcpy(samples.data(), contents.data() + offset + 8, samples.size() * 2);
+            return isPcm16;
+        }
+        // Chunks are padded to an even size.
+        offset += 8 + size + (size & 1);
+    }
+    return false;
+}
+
+// Reads the audio an RTP sender sends: G.711 codes from .alaw and .mulaw files, or L16 samples from 16 kHz mono wav files.
+static bool readRtpAudio(const std::string& fileName, RtpPayloadType& payloadType, uint32_t& samplesPerSecond, std::vector<uint8_t>& audio)
+{
+    auto hasExtension = [&fileName](const std::string& extension)
+    {
+        return fileName.size() >= extension.size() &&
+            fileName.compare(fileName.size() - extension.size(), extension.size(), extension) == 0;
+    };
+
+    if (hasExtension(".alaw") || hasExtension(".mulaw"))
+    {
+        payloadType = hasExtension(".alaw") ? RtpPayloadType::PCMA : RtpPayloadType::PCMU;
+        samplesPerSecond = 8000;
+        return ReadWholeFile(fileName, audio);
+    }
+
+    std::vector<int16_t> samples;
+    uint16_t channels = 0;
+    if (!ReadWavFile(fileName, samples, samplesPerSecond, channels) || samplesPerSecond != 16000 || channels != 1)
+    {
+        return false;
+    }
+    payloadType = RtpPayloadType::L16;
+    audio.resize(samples.size() * sizeof(int16_t));
+    memcpy(audio.data(), samples.data(), audio.size());
+    return true;
+}
+
+// Recognizes the RTP streams received on a UDP port, e.g. from a media gateway or from --send, with one recognizer
+// per SSRC, until Enter is pressed. Recognition starts without blocking the receive threads, which serve many streams.
+void recognizeRtpStreams(uint16_t port, size_t sockets)
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    struct Session
+    {
+        std::shared_ptr<SpeechRecognizer> Recognizer;
+        std::future<void> Started;
+        std::promise<void> Stopped;
+    };
+    std::mutex mutex;
+    std::condition_variable sessionEnded;
+    std::unordered_map<uint32_t, std::shared_ptr<Session>> sessions;   // Of the streams being received, by SSRC.
+    std::deque<std::shared_ptr<Session>> endedSessions;
+    bool stopping = false;
+
+    // Stops and releases the sessions of ended streams, which would otherwise pile up in a long-running receiver.
+    // This waits for the recognizers to catch up, so it is done on a thread of its own rather than in the ingest
+    // callbacks, which should not block.
+    std::thread reaper([&]()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            sessionEnded.wait(lock, [&]() { return !endedSessions.empty() || stopping; });
+            if (endedSessions.empty())
+            {
+                break;
+            }
+            auto session = std::move(endedSessions.front());
+            endedSessions.pop_front();
+            lock.unlock();
+
+            // The push stream is closed, so the session stops once the recognizer has caught up.
+            session->Started.get();
+            session->Stopped.get_future().wait();
+            session->Recognizer->StopContinuousRecognitionAsync().get();
+            session.reset();
+            lock.lock();
+        }
+    });
+
+    RtpIngest::Options options;
+    options.Port = port;
+    options.Sockets = sockets;
+    auto onStarted = [&](const RtpIngest::StreamInfo& info, std::shared_ptr<PushAudioInputStream> pushStream)
+    {
+        auto session = std::make_shared<Session>();
+        auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pushStream));
+        auto ssrc = info.Ssrc;
+        recognizer->Recognized.Connect([&mutex, ssrc](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedSpeech)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::cout << "[" << std::hex << ssrc << std::dec << "] RECOGNIZED: Text=" << e.Result->Text << std::endl;
+            }
+        });
+        recognizer->Canceled.Connect([&mutex, ssrc](const SpeechRecognitionCanceledEventArgs& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::cout << "[" << std::hex << ssrc << std::dec << "] CANCELED: ErrorCode=" << (int)e.ErrorCode << "\n"
+                          << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+            }
+        });
+
+        // The session owns the recognizer, so it outlives the handler.
+        auto stopped = &session->Stopped;
+        recognizer->SessionStopped.Connect([stopped](const SessionEventArgs&)
+        {
+            stopped->set_value();
+        });
+        session->Recognizer = recognizer;
+        session->Started = recognizer->StartContinuousRecognitionAsync();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cout << "[" << std::hex << ssrc << std::dec << "] stream started, " << info.SamplesPerSecond << " Hz" << std::endl;
+
+        // A stream of the same SSRC on another socket is not expected; its session would be reaped when it ends.
+        auto& entry = sessions[ssrc];
+        if (entry)
+        {
+            endedSessions.push_back(std::move(entry));
+            sessionEnded.notify_one();
+        }
+        entry = session;
+    };
+    auto onEnded = [&](const RtpIngest::StreamInfo& info)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cout << "[" << std::hex << info.Ssrc << std::dec << "] stream ended: " << info.Packets << " packets, "
+                  << info.LostPackets << " lost, " << info.LatePackets << " late" << std::endl;
+        auto found = sessions.find(info.Ssrc);
+        if (found != sessions.end())
+        {
+            endedSessions.push_back(std::move(found->second));
+            sessions.erase(found);
+            sessionEnded.notify_one();
+        }
+    };
+
+    try
+    {
+        RtpIngest ingest(options, onStarted, onEnded);
+        std::cout << "Receiving RTP on UDP port " << port << ", press Enter to stop." << std::endl;
+        std::cin.get();
+        ingest.Stop();
+    }
+    catch (const std::runtime_error& e)
+    {
+        // E.g. the port is in use.
+        std::cout << "Error: " << e.what() << std::endl;
+    }
+
+    // All streams are ended, so the reaper stops once it has released their sessions.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    sessionEnded.notify_one();
+    reaper.join();
+}
+
+// Sends a file as RTP to a local UDP port from the given number of streams, 20 ms packets at real time.
+void sendRtpStreams(const std::string& fileName, uint16_t port, size_t streams, double lossPercent)
+{
+    RtpPayloadType payloadType;
+    uint32_t samplesPerSecond;
+    std::vector<uint8_t> audio;
+    if (!readRtpAudio(fileName, payloadType, samplesPerSecond, audio))
+    {
+        std::cout << "Error: the input file must be a .alaw or .mulaw file, or a 16 kHz mono 16-bit PCM wav file" << std::endl;
+        return;
+    }
+
+    RtpSender::Options options;
+    options.Port = port;
+    options.Streams = streams;
+    options.Sockets = std::min<size_t>(streams, 16);
+    options.LossPercent = lossPercent;
+    options.ReorderPercent = lossPercent;
+    RtpSender sender(options, payloadType, samplesPerSecond, audio);
+    auto sent = sender.Run(std::chrono::milliseconds(0));
+    std::cout << "Sent " << sent << " packets in " << streams << " streams." << std::endl;
+}
+
+// Measures the ingest alone: a file is sent in a loop from many streams to a local port, with 1% of the packets
+// lost and 2% reordered, and received, reordered and decoded without recognizers. Reports the packets received per
+// recvmmsg() call, the losses seen by the jitter buffers and the CPU time of the receive threads per stream.
+void benchmarkRtpIngest(const std::string& fileName, size_t streams, int seconds)
+{
+    RtpPayloadType payloadType;
+    uint32_t samplesPerSecond;
+    std::vector<uint8_t> audio;
+    if (!readRtpAudio(fileName, payloadType, samplesPerSecond, audio))
+    {
+        std::cout << "Error: the input file must be a .alaw or .mulaw file, or a 16 kHz mono 16-bit PCM wav file" << std::endl;
+        return;
+    }
+
+    RtpIngest::Options ingestOptions;
+    ingestOptions.Port = 15004;
+    ingestOptions.Sockets = std::max(1u, std::min(std::thread::hardware_concurrency() / 2, 8u));
+    ingestOptions.StreamTimeoutMs = 500;
+    ingestOptions.WriteToStreams = false;
+    RtpIngest ingest(ingestOptions, nullptr, nullptr);
+
+    RtpSender::Options senderOptions;
+    senderOptions.Port = ingestOptions.Port;
+    senderOptions.Streams = streams;
+    senderOptions.Sockets = std::min<size_t>(streams, 4 * ingestOptions.Sockets);
+    senderOptions.LossPercent = 1;
+    senderOptions.ReorderPercent = 2;
+    senderOptions.Loop = true;
+    RtpSender sender(senderOptions, payloadType, samplesPerSecond, audio);
+    auto sent = sender.Run(std::chrono::seconds(seconds));
+
+    // Waits for the streams to time out, so that the jitter buffers have released everything.
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * ingestOptions.StreamTimeoutMs));
+    ingest.Stop();
+
+    auto statistics = ingest.GetStatistics();
+    auto streamSeconds = static_cast<double>(streams) * seconds;
+    std::cout << streams << " streams on " << ingestOptions.Sockets << " sockets for " << seconds << " s: "
+              << statistics.Datagrams << " of " << sent << " packets received, "
+              << static_cast<double>(statistics.Datagrams) / std::max<uint64_t>(statistics.ReceiveCalls, 1) << " per recvmmsg() call" << std::endl;
+    std::cout << "Lost: " << statistics.LostPackets << ", late: " << statistics.LatePackets
+              << ", duplicate: " << statistics.DuplicatePackets << ", invalid: " << statistics.InvalidDatagrams << std::endl;
+    std::cout << "Receive CPU: " << statistics.ReceiveCpuSeconds << " s, " << 1e6 * statistics.ReceiveCpuSeconds / streamSeconds
+              << " us per stream second, " << streamSeconds / std::max(statistics.ReceiveCpuSeconds, 1e-9) / seconds
+              << " streams per core" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    setlocale(LC_ALL, "");
+    if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--receive")
+    {
+        recognizeRtpStreams(static_cast<uint16_t>(atoi(argv[2])), argc == 4 ? std::max(1, atoi(argv[3])) : 1);
+        return 0;
+    }
+    if (argc >= 4 && argc <= 6 && std::string(argv[1]) == "--send")
+    {
+        sendRtpStreams(argv[2], static_cast<uint16_t>(atoi(argv[3])), argc >= 5 ? std::max(1, atoi(argv[4])) : 1, argc == 6 ? atof(argv[5]) : 0);
+        return 0;
+    }
+    if (argc >= 3 && argc <= 5 && std::string(argv[1]) == "--benchmark")
+    {
+        benchmarkRtpIngest(argv[2], argc >= 4 ? std::max(1, atoi(argv[3])) : 1000, argc == 5 ? std::max(1, atoi(argv[4])) : 10);
+        return 0;
+    }
+
+    std::cout << "Usage: ./rtp-ingest --receive <port> [<sockets>]" << std::endl;
+    std::cout << "       ./rtp-ingest --send <filename> <port> [<streams> [<loss %>]]" << std::endl;
+    std::cout << "       ./rtp-ingest --benchmark <filename> [<streams> [<seconds>]]" << std::endl;
+    return 0;
+}
@@ -0,0 +1,794 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "g711.h"
+
+// RTP payload types handled by the ingest: the static types of G.711 (RFC 3551), and a dynamic type for L16.
+enum class RtpPayloadType : uint8_t
+{
+    PCMU = 0,
+    PCMA = 8,
+    L16 = 96,
+};
+
+// Fixed header fields and payload of an RTP packet (RFC 3550).
+struct RtpPacket
+{
+    uint8_t PayloadType = 0;
+    uint16_t SequenceNumber = 0;
+    uint32_t Timestamp = 0;
+    uint32_t Ssrc = 0;
+    const uint8_t* Payload = nullptr;
+    size_t PayloadSize = 0;
+
+    // Parses a datagram, skipping the CSRC list, the header extension and the padding. Returns false if it is not
+    // a version 2 RTP packet.
+    static bool Parse(const uint8_t* data, size_t size, RtpPacket& packet)
+    {
+        if (size < 12 || (data[0] >> 6) != 2)
+        {
+            return false;
+        }
+        size_t headerSize = 12 + 4 * (data[0] & 0x0f);
+        if ((data[0] & 0x10) != 0)
+        {
+            if (size < headerSize + 4)
+            {
+                return false;
+            }
+            headerSize += 4 + 4 * (data[headerSize + 2] << 8 | data[headerSize + 3]);
+        }
+        size_t padding = (data[0] & 0x20) != 0 && size > 0 ? data[size - 1] : 0;
+        if (size < headerSize + padding)
+        {
+            return false;
+        }
+
+        packet.PayloadType = data[1] & 0x7f;
+        packet.SequenceNumber = static_cast<uint16_t>(data[2] << 8 | data[3]);
+        packet.Timestamp = static_cast<uint32_t>(data[4]) << 24 | data[5] << 16 | data[6] << 8 | data[7];
+        packet.Ssrc = static_cast<uint32_t>(data[8]) << 24 | data[9] << 16 | data[10] << 8 | data[11];
+        packet.Payload = data + headerSize;
+        packet.PayloadSize = size - headerSize - padding;
+        return true;
+    }
+};
+
+// Receives RTP audio on a local UDP port and writes each source, told apart by its SSRC, to a push audio input
+// stream of its own. G.711 is expanded and upsampled to 16 kHz; L16 is written at the rate it is sent at.
+//
+// The port is opened by several sockets with SO_REUSEPORT, each served by one thread: the kernel hashes every
+// sender address to one socket, so the streams are shared between the threads without locks. Datagrams are
+// received in batches with recvmmsg(), one system call for up to 64 packets.
+//
+// Each stream reorders its packets in a jitter buffer. Unlike a playout buffer, it does not delay packets that
+// arrive in order; only a gap holds back the packets after it, until the missing packet arrives or the oldest
+// packet held has waited the jitter depth, when the missing packet is taken as lost and replaced by silence.
+// A burst loss longer than the buffer is filled with as much silence as the RTP timestamps show was lost, so the
+// offsets of the later audio are kept.
+class RtpIngest final
+{
+public:
+    struct Options
+    {
+        uint16_t Port = 5004;
+        size_t Sockets = 1;                 // Sockets on the port, and receive threads.
+        uint32_t JitterMs = 60;             // Longest time a packet is held back by a missing one.
+        uint32_t MaxLossFillMs = 5000;      // Longest burst loss filled with silence; a longer jump is a restart.
+        uint32_t StreamTimeoutMs = 2000;    // A stream without packets for this long has ended.
+        uint32_t L16SamplesPerSecond = 16000;
+        bool WriteToStreams = true;         // If false, the audio is decoded but not written, to measure the ingest.
+    };
+
+    struct StreamInfo
+    {
+        uint32_t Ssrc = 0;
+        uint32_t SamplesPerSecond = 0;
+        uint64_t Packets = 0;
+        uint64_t LostPackets = 0;
+        uint64_t LatePackets = 0;           // Arrived after they were taken as lost.
+        uint64_t DuplicatePackets = 0;
+    };
+
+    struct Statistics
+    {
+        uint64_t Datagrams = 0;
+        uint64_t Bytes = 0;
+        uint64_t ReceiveCalls = 0;          // Calls to recvmmsg() that returned datagrams.
+        uint64_t InvalidDatagrams = 0;      // Not RTP, or of a payload type that is not handled.
+        uint64_t LostPackets = 0;
+        uint64_t LatePackets = 0;
+        uint64_t DuplicatePackets = 0;
+        uint64_t Streams = 0;
+        uint64_t ActiveStreams = 0;
+        double ReceiveCpuSeconds = 0;       // CPU time of the receive threads, known once stopped.
+    };
+
+    // Called on a receive thread when a stream starts, with the push stream it is written to (null if
+    // WriteToStreams is off), and when it ends, after the push stream is closed. The calls should not block.
+    using StreamStarted = std::function<void(const StreamInfo&, std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream>)>;
+    using StreamEnded = std::function<void(const StreamInfo&)>;
+
+    RtpIngest(const Options& options, StreamStarted onStarted, StreamEnded onEnded)
+        : m_options(options),
+          m_onStarted(onStarted),
+          m_onEnded(onEnded)
+    {
+        for (size_t i = 0; i < std::max<size_t>(m_options.Sockets, 1); i++)
+        {
+            m_sockets.push_back(OpenSocket(m_options.Port));
+        }
+        for (auto socket : m_sockets)
+        {
+            m_threads.emplace_back([this, socket]() { Receive(socket); });
+        }
+    }
+
+    // Ends all streams and stops receiving.
+    ~RtpIngest()
+    {
+        Stop();
+    }
+
+    RtpIngest(const RtpIngest&) = delete;
+    RtpIngest& operator=(const RtpIngest&) = delete;
+
+    void Stop()
+    {
+        m_stopping = true;
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+        m_threads.clear();
+        for (auto socket : m_sockets)
+        {
+            close(socket);
+        }
+        m_sockets.clear();
+    }
+
+    Statistics GetStatistics() const
+    {
+        Statistics statistics;
+        statistics.Datagrams = m_datagrams;
+        statistics.Bytes = m_bytes;
+        statistics.ReceiveCalls = m_receiveCalls;
+        statistics.InvalidDatagrams = m_invalidDatagrams;
+        statistics.LostPackets = m_lostPackets;
+        statistics.LatePackets = m_latePackets;
+        statistics.DuplicatePackets = m_duplicatePackets;
+        statistics.Streams = m_streams;
+        statistics.ActiveStreams = m_activeStreams;
+        statistics.ReceiveCpuSeconds = m_receiveCpuMicroseconds / 1e6;
+        return statistics;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t batchSize = 64;
+    static constexpr size_t maxDatagramSize = 1500;
+    static constexpr uint16_t jitterSlots = 32;     // Packets held per stream, 640 ms of 20 ms packets.
+
+    struct Slot
+    {
+        bool Used = false;
+        uint16_t SequenceNumber = 0;
+        uint32_t Timestamp = 0;
+        Clock::time_point Arrival;
+        std::vector<uint8_t> Payload;
+    };
+
+    // Jitter buffer, decoder and push stream of one SSRC; only used by the thread of its socket.
+    class Stream final
+    {
+    public:
+        Stream(const StreamInfo& info, RtpPayloadType payloadType, std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> pushStream)
+            : m_info(info),
+              m_payloadType(payloadType),
+              m_upsampler(payloadType == RtpPayloadType::PCMA ? G711Upsampler::Law::ALaw : G711Upsampler::Law::MuLaw),
+              m_pushStream(pushStream),
+              m_slots(jitterSlots),
+              m_lastPayloadSize(payloadType == RtpPayloadType::L16 ? info.SamplesPerSecond / 50 * 2 : 160)
+        {
+        }
+
+        const StreamInfo& GetInfo() const
+        {
+            return m_info;
+        }
+
+        Clock::time_point GetLastArrival() const
+        {
+            return m_lastArrival;
+        }
+
+        void Insert(const RtpPacket& packet, Clock::time_point now)
+        {
+            m_lastArrival = now;
+            if (!m_started)
+            {
+                m_next = packet.SequenceNumber;
+                m_started = true;
+            }
+
+            // A packet at most a buffer behind arrived after it was taken as lost. For a packet further behind, or too
+            // far ahead for the buffer, the packets held are released first, which counts and fills the gaps between
+            // them. If the packet is still ahead, and its timestamp is ahead by at most the longest fill, the packets
+            // in between were lost in a burst and are replaced by the silence they covered. Otherwise the sender
+            // restarted with a new sequence number and timestamp, and the sequence restarts at the packet.
+            auto ahead = static_cast<int16_t>(packet.SequenceNumber - m_next);
+            if (ahead < 0 && ahead >= -static_cast<int16_t>(jitterSlots))
+            {
+                m_info.LatePackets++;
+                return;
+            }
+            if (ahead < 0 || ahead >= static_cast<int16_t>(jitterSlots))
+            {
+                Release(now, Clock::duration::zero());
+                auto lost = static_cast<int16_t>(packet.SequenceNumber - m_next);
+                auto elapsed = static_cast<int32_t>(packet.Timestamp - m_nextTimestamp);
+                if (lost > 0 && m_timestampKnown && elapsed > 0 && static_cast<uint32_t>(elapsed) <= m_maxLossFill)
+                {
+                    m_info.LostPackets += static_cast<uint16_t>(lost);
+                    WriteSilence(static_cast<uint32_t>(elapsed));
+                }
+                m_next = packet.SequenceNumber;
+            }
+
+            auto& slot = m_slots[packet.SequenceNumber % jitterSlots];
+            if (slot.Used)
+            {
+                m_info.DuplicatePackets++;
+                return;
+            }
+            slot.Used = true;
+            slot.SequenceNumber = packet.SequenceNumber;
+            slot.Timestamp = packet.Timestamp;
+            slot.Arrival = now;
+            slot.Payload.assign(packet.Payload, packet.Payload + packet.PayloadSize);
+            m_held++;
+            m_info.Packets++;
+            Release(now, m_jitter);
+        }
+
+        // Releases the packets in order, and skips a missing packet once a packet after it has waited the given time.
+        void Release(Clock::time_point now, Clock::duration jitter)
+        {
+            while (m_held > 0)
+            {
+                if (!m_slots[m_next % jitterSlots].Used)
+                {
+                    Clock::time_point oldest = Clock::time_point::max();
+                    for (uint16_t i = 1; i < jitterSlots; i++)
+                    {
+                        const auto& slot = m_slots[static_cast<uint16_t>(m_next + i) % jitterSlots];
+                        if (slot.Used)
+                        {
+                            oldest = std::min(oldest, slot.Arrival);
+                        }
+                    }
+                    if (now - oldest < jitter)
+                    {
+                        return;
+                    }
+                }
+                ReleaseNext();
+            }
+        }
+
+        // Writes the packets still held, and the end of the audio, then closes the push stream.
+        void End(Clock::time_point now)
+        {
+            Release(now, Clock::duration::zero());
+            m_pcm.clear();
+            if (m_payloadType != RtpPayloadType::L16)
+            {
+                m_upsampler.Flush(m_pcm);
+            }
+            Write();
+            if (m_pushStream)
+            {
+                m_pushStream->Close();
+            }
+        }
+
+        void SetJitter(Clock::duration jitter)
+        {
+            m_jitter = jitter;
+        }
+
+        void SetMaxLossFill(std::chrono::milliseconds maxLossFill)
+        {
+            // G.711 has a clock of 8 kHz; L16 of its sample rate.
+            auto clockRate = m_payloadType == RtpPayloadType::L16 ? m_info.SamplesPerSecond : 8000;
+            m_maxLossFill = static_cast<uint32_t>(static_cast<uint64_t>(maxLossFill.count()) * clockRate / 1000);
+        }
+
+    private:
+        void ReleaseNext()
+        {
+            auto& slot = m_slots[m_next % jitterSlots];
+            if (slot.Used && slot.SequenceNumber == m_next)
+            {
+                m_pcm.clear();
+                Decode(slot.Payload.data(), slot.Payload.size());
+                Write();
+                m_lastPayloadSize = slot.Payload.size();
+                m_nextTimestamp = slot.Timestamp + SamplesOf(slot.Payload.size());
+                m_timestampKnown = true;
+                slot.Used = false;
+                m_held--;
+            }
+            else
+            {
+                // A lost packet is replaced by silence as long as the last packet.
+                m_info.LostPackets++;
+                WriteSilence(SamplesOf(m_lastPayloadSize));
+            }
+            m_next++;
+        }
+
+        // Gets the number of samples, at the RTP clock rate, of a payload.
+        uint32_t SamplesOf(size_t payloadSize) const
+        {
+            return static_cast<uint32_t>(m_payloadType == RtpPayloadType::L16 ? payloadSize / 2 : payloadSize);
+        }
+
+        // Writes silence of the given number of samples at the RTP clock rate, and advances the expected timestamp.
+        void WriteSilence(uint32_t samples)
+        {
+            m_pcm.clear();
+            if (m_payloadType == RtpPayloadType::L16)
+            {
+                m_pcm.assign(samples, 0);
+            }
+            else
+            {
+                std::vector<uint8_t> silence(samples, m_payloadType == RtpPayloadType::PCMA ? 0xd5 : 0xff);
+                m_upsampler.Process(silence.data(), silence.size(), m_pcm);
+            }
+            Write();
+            m_nextTimestamp += samples;
+        }
+
+        void Decode(const uint8_t* payload, size_t size)
+        {
+            if (m_payloadType == RtpPayloadType::L16)
+            {
+                // L16 samples are in network byte order.
+                m_pcm.resize(size / 2);
+                for (size_t i = 0; i < m_pcm.size(); i++)
+                {
+                    m_pcm[i] = static_cast<int16_t>(payload[2 * i] << 8 | payload[2 * i + 1]);
+                }
+            }
+            else
+            {
+                m_upsampler.Process(payload, size, m_pcm);
+            }
+        }
+
+        void Write()
+        {
+            if (m_pushStream && !m_pcm.empty())
+            {
+                m_pushStream->Write(reinterpret_cast<uint8_t*>(m_pcm.data()), static_cast<uint32_t>(m_pcm.size() * sizeof(int16_t)));
+            }
+        }
+
+        StreamInfo m_info;
+        RtpPayloadType m_payloadType;
+        G711Upsampler m_upsampler;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> m_pushStream;
+        std::vector<Slot> m_slots;
+        std::vector<int16_t> m_pcm;
+        Clock::duration m_jitter = Clock::duration::zero();
+        Clock::time_point m_lastArrival;
+        bool m_started = false;
+        bool m_timestampKnown = false;
+        uint16_t m_next = 0;
+        uint32_t m_nextTimestamp = 0;   // Timestamp of the packet m_next, known once a packet is released.
+        uint32_t m_maxLossFill = 0;     // Longest burst loss filled with silence, in samples at the RTP clock rate.
+        uint16_t m_held = 0;
+        size_t m_lastPayloadSize;       // Of 20 ms of audio of the payload type until a packet is received.
+    };
+
+    static int OpenSocket(uint16_t port)
+    {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Cannot create a UDP socket.");
+        }
+        int one = 1;
+        int receiveBufferSize = 4 << 20;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize, sizeof(receiveBufferSize));
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+        if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("Cannot bind UDP port " + std::to_string(port) + ".");
+        }
+        return fd;
+    }
+
+    void Receive(int fd)
+    {
+        std::vector<uint8_t> buffers(batchSize * maxDatagramSize);
+        mmsghdr messages[batchSize];
+        iovec vectors[batchSize];
+        std::unordered_map<uint32_t, std::unique_ptr<Stream>> streams;
+        auto jitter = std::chrono::duration_cast<Clock::duration>(std::chrono::milliseconds(m_options.JitterMs));
+        auto timeout = std::chrono::milliseconds(m_options.StreamTimeoutMs);
+        auto lastSweep = Clock::now();
+
+        while (!m_stopping)
+        {
+            // Waits at most 10 ms, the resolution of the jitter and stream timers.
+            pollfd descriptor = { fd, POLLIN, 0 };
+            if (poll(&descriptor, 1, 10) > 0)
+            {
+                int received;
+                do
+                {
+                    for (size_t i = 0; i < batchSize; i++)
+                    {
+                        vectors[i].iov_base = buffers.data() + i * maxDatagramSize;
+                        vectors[i].iov_len = maxDatagramSize;
+                        messages[i].msg_hdr = {};
+                        messages[i].msg_hdr.msg_iov = &vectors[i];
+                        messages[i].msg_hdr.msg_iovlen = 1;
+                    }
+                    received = recvmmsg(fd, messages, batchSize, MSG_DONTWAIT, nullptr);
+                    if (received > 0)
+                    {
+                        m_receiveCalls++;
+                        Dispatch(messages, received, streams, jitter);
+                    }
+                } while (received == static_cast<int>(batchSize));
+            }
+
+            auto now = Clock::now();
+            if (now - lastSweep >= std::chrono::milliseconds(10))
+            {
+                lastSweep = now;
+                Sweep(streams, now, jitter, timeout);
+            }
+        }
+
+        auto now = Clock::now();
+        for (auto& stream : streams)
+        {
+            EndStream(*stream.second, now);
+        }
+
+        timespec cpuTime;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuTime);
+        m_receiveCpuMicroseconds += static_cast<uint64_t>(cpuTime.tv_sec) * 1000000 + cpuTime.tv_nsec / 1000;
+    }
+
+    void Dispatch(mmsghdr* messages, int count, std::unordered_map<uint32_t, std::unique_ptr<Stream>>& streams, Clock::duration jitter)
+    {
+        auto now = Clock::now();
+        uint64_t bytes = 0;
+        uint64_t invalid = 0;
+        for (int i = 0; i < count; i++)
+        {
+            auto data = static_cast<const uint8_t*>(messages[i].msg_hdr.msg_iov->iov_base);
+            bytes += messages[i].msg_len;
+            RtpPacket packet;
+            if (!RtpPacket::Parse(data, messages[i].msg_len, packet) ||
+                (packet.PayloadType != static_cast<uint8_t>(RtpPayloadType::PCMU) &&
+                 packet.PayloadType != static_cast<uint8_t>(RtpPayloadType::PCMA) &&
+                 packet.PayloadType != static_cast<uint8_t>(RtpPayloadType::L16)))
+            {
+                invalid++;
+                continue;
+            }
+
+            auto found = streams.find(packet.Ssrc);
+            if (found == streams.end())
+            {
+                found = streams.emplace(packet.Ssrc, StartStream(packet)).first;
+                found->second->SetJitter(jitter);
+                found->second->SetMaxLossFill(std::chrono::milliseconds(m_options.MaxLossFillMs));
+            }
+            found->second->Insert(packet, now);
+        }
+
+        m_datagrams += static_cast<uint64_t>(count);
+        m_bytes += bytes;
+        m_invalidDatagrams += invalid;
+    }
+
+    std::unique_ptr<Stream> StartStream(const RtpPacket& packet)
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        StreamInfo info;
+        info.Ssrc = packet.Ssrc;
+        auto payloadType = static_cast<RtpPayloadType>(packet.PayloadType);
+        info.SamplesPerSecond = payloadType == RtpPayloadType::L16 ? m_options.L16SamplesPerSecond : 16000;
+
+        std::shared_ptr<PushAudioInputStream> pushStream;
+        if (m_options.WriteToStreams)
+        {
+            pushStream = AudioInputStream::CreatePushStream(AudioStreamFormat::GetWaveFormatPCM(info.SamplesPerSecond, 16, 1));
+        }
+        m_streams++;
+        m_activeStreams++;
+        if (m_onStarted)
+        {
+            m_onStarted(info, pushStream);
+        }
+        return std::unique_ptr<Stream>(new Stream(info, payloadType, pushStream));
+    }
+
+    // Releases the packets held past the jitter depth, and ends the streams that timed out.
+    void Sweep(std::unordered_map<uint32_t, std::unique_ptr<Stream>>& streams, Clock::time_point now, Clock::duration jitter, Clock::duration timeout)
+    {
+        for (auto it = streams.begin(); it != streams.end();)
+        {
+            if (now - it->second->GetLastArrival() >= timeout)
+            {
+                EndStream(*it->second, now);
+                it = streams.erase(it);
+            }
+            else
+            {
+                it->second->Release(now, jitter);
+                ++it;
+            }
+        }
+    }
+
+    void EndStream(Stream& stream, Clock::time_point now)
+    {
+        stream.End(now);
+        const auto& info = stream.GetInfo();
+        m_lostPackets += info.LostPackets;
+        m_latePackets += info.LatePackets;
+        m_duplicatePackets += info.DuplicatePackets;
+        m_activeStreams--;
+        if (m_onEnded)
+        {
+            m_onEnded(info);
+        }
+    }
+
+    Options m_options;
+    StreamStarted m_onStarted;
+    StreamEnded m_onEnded;
+    std::vector<int> m_sockets;
+    std::vector<std::thread> m_threads;
+    std::atomic<bool> m_stopping{ false };
+    std::atomic<uint64_t> m_datagrams{ 0 };
+    std::atomic<uint64_t> m_bytes{ 0 };
+    std::atomic<uint64_t> m_receiveCalls{ 0 };
+    std::atomic<uint64_t> m_invalidDatagrams{ 0 };
+    std::atomic<uint64_t> m_lostPackets{ 0 };
+    std::atomic<uint64_t> m_latePackets{ 0 };
+    std::atomic<uint64_t> m_duplicatePackets{ 0 };
+    std::atomic<uint64_t> m_streams{ 0 };
+    std::atomic<uint64_t> m_activeStreams{ 0 };
+    std::atomic<uint64_t> m_receiveCpuMicroseconds{ 0 };
+};
+
+// Sends the same audio as RTP to a local port from many sources at once, 20 ms packets at real time, to test the
+// ingest. Packets can be dropped or swapped with the next packet of their stream at random, to exercise the
+// jitter buffer. The streams are spread over several sockets, so that the ingest spreads them over its sockets;
+// each tick, the packets of a socket are sent with one sendmmsg() call per 64 packets.
+class RtpSender final
+{
+public:
+    struct Options
+    {
+        uint16_t Port = 5004;
+        size_t Streams = 1;
+        size_t Sockets = 1;
+        double LossPercent = 0;
+        double ReorderPercent = 0;
+        bool Loop = false;              // Sends the audio again from the start once it ends.
+    };
+
+    // Payloads are G.711 codes for PCMU and PCMA, and 16-bit samples in host order for L16, at the rate of the
+    // ingest; each packet carries 20 ms of them.
+    RtpSender(const Options& options, RtpPayloadType payloadType, uint32_t samplesPerSecond, const std::vector<uint8_t>& audio)
+        : m_options(options),
+          m_payloadType(payloadType),
+          m_timestampStep(samplesPerSecond / 50)
+    {
+        size_t payloadSize = payloadType == RtpPayloadType::L16 ? m_timestampStep * 2 : m_timestampStep;
+        for (size_t offset = 0; payloadSize > 0 && offset + payloadSize <= audio.size(); offset += payloadSize)
+        {
+            std::vector<uint8_t> payload(audio.begin() + offset, audio.begin() + offset + payloadSize);
+            if (payloadType == RtpPayloadType::L16)
+            {
+                for (size_t i = 0; i < payload.size(); i += 2)
+                {
+                    std::swap(payload[i], payload[i + 1]);
+                }
+            }
+            m_payloads.push_back(std::move(payload));
+        }
+        if (m_payloads.empty())
+        {
+            throw std::invalid_argument("The audio is shorter than one packet.");
+        }
+
+        for (size_t i = 0; i < std::max<size_t>(m_options.Sockets, 1); i++)
+        {
+            int fd = socket(AF_INET, SOCK_DGRAM, 0);
+            if (fd < 0)
+            {
+                throw std::runtime_error("Cannot create a UDP socket.");
+            }
+            int sendBufferSize = 4 << 20;
+            setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sendBufferSize, sizeof(sendBufferSize));
+            m_sockets.push_back(fd);
+        }
+        m_address.sin_family = AF_INET;
+        m_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        m_address.sin_port = htons(m_options.Port);
+    }
+
+    ~RtpSender()
+    {
+        for (auto fd : m_sockets)
+        {
+            close(fd);
+        }
+    }
+
+    RtpSender(const RtpSender&) = delete;
+    RtpSender& operator=(const RtpSender&) = delete;
+
+    // Sends until the audio ends, or for the given time if it loops. Returns the number of packets sent.
+    uint64_t Run(std::chrono::milliseconds duration)
+    {
+        std::mt19937 random(42);
+        std::uniform_real_distribution<double> percent(0, 100);
+        std::vector<uint32_t> ssrcs(m_options.Streams);
+        std::vector<uint16_t> sequenceNumbers(m_options.Streams);
+        std::vector<uint32_t> timestamps(m_options.Streams);
+        std::vector<std::vector<uint8_t>> heldBack(m_options.Streams);
+        for (size_t i = 0; i < m_options.Streams; i++)
+        {
+            ssrcs[i] = static_cast<uint32_t>(random());
+            sequenceNumbers[i] = static_cast<uint16_t>(random());
+            timestamps[i] = static_cast<uint32_t>(random());
+        }
+
+        std::vector<std::vector<std::vector<uint8_t>>> packets(m_sockets.size());
+        uint64_t sent = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t tick = 0;; tick++)
+        {
+            bool last = m_options.Loop ? std::chrono::steady_clock::now() - start >= duration : tick >= m_payloads.size();
+            if (!last)
+            {
+                std::this_thread::sleep_until(start + std::chrono::milliseconds(20 * tick));
+            }
+
+            for (size_t i = 0; i < m_options.Streams; i++)
+            {
+                auto& socketPackets = packets[i % m_sockets.size()];
+                if (last)
+                {
+                    // The packets still held back are sent at the end.
+                    if (!heldBack[i].empty())
+                    {
+                        socketPackets.push_back(std::move(heldBack[i]));
+                    }
+                    continue;
+                }
+
+                auto packet = BuildPacket(ssrcs[i], sequenceNumbers[i]++, timestamps[i], m_payloads[tick % m_payloads.size()]);
+                timestamps[i] += m_timestampStep;
+                if (percent(random) < m_options.LossPercent)
+                {
+                    continue;
+                }
+                if (heldBack[i].empty() && percent(random) < m_options.ReorderPercent)
+                {
+                    heldBack[i] = std::move(packet);
+                    continue;
+                }
+                socketPackets.push_back(std::move(packet));
+                if (!heldBack[i].empty())
+                {
+                    socketPackets.push_back(std::move(heldBack[i]));
+                    heldBack[i].clear();
+                }
+            }
+
+            for (size_t i = 0; i < m_sockets.size(); i++)
+            {
+                sent += Send(m_sockets[i], packets[i]);
+                packets[i].clear();
+            }
+            if (last)
+            {
+                break;
+            }
+        }
+        return sent;
+    }
+
+private:
+    std::vector<uint8_t> BuildPacket(uint32_t ssrc, uint16_t sequenceNumber, uint32_t timestamp, const std::vector<uint8_t>& payload) const
+    {
+        std::vector<uint8_t> packet(12 + payload.size());
+        packet[0] = 0x80;
+        packet[1] = static_cast<uint8_t>(m_payloadType);
+        packet[2] = static_cast<uint8_t>(sequenceNumber >> 8);
+        packet[3] = static_cast<uint8_t>(sequenceNumber);
+        for (int i = 0; i < 4; i++)
+        {
+            packet[4 + i] = static_cast<uint8_t>(timestamp >> (24 - 8 * i));
+            packet[8 + i] = static_cast<uint8_t>(ssrc >> (24 - 8 * i));
+        }
+        std::copy(payload.begin(), payload.end(), packet.begin() + 12);
+        return packet;
+    }
+
+    uint64_t Send(int fd, std::vector<std::vector<uint8_t>>& packets)
+    {
+        mmsghdr messages[64];
+        iovec vectors[64];
+        uint64_t sent = 0;
+        for (size_t begin = 0; begin < packets.size(); begin += 64)
+        {
+            auto count = std::min<size_t>(packets.size() - begin, 64);
+            for (size_t i = 0; i < count; i++)
+            {
+                vectors[i].iov_base = packets[begin + i].data();
+                vectors[i].iov_len = packets[begin + i].size();
+                messages[i].msg_hdr = {};
+                messages[i].msg_hdr.msg_name = &m_address;
+                messages[i].msg_hdr.msg_namelen = sizeof(m_address);
+                messages[i].msg_hdr.msg_iov = &vectors[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+            }
+            auto result = sendmmsg(fd, messages, static_cast<unsigned int>(count), 0);
+            sent += result > 0 ? static_cast<uint64_t>(result) : 0;
+        }
+        return sent;
+    }
+
+    Options m_options;
+    RtpPayloadType m_payloadType;
+    uint32_t m_timestampStep;
+    std::vector<std::vector<uint8_t>> m_payloads;
+    std::vector<int> m_sockets;
+    sockaddr_in m_address = {};
+};
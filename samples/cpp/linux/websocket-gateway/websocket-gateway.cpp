@@ -0,0 +1,165 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream> // cin, cout
+#include <string>
+#include <sys/resource.h>
+#include <speechapi_cxx.h>
+#include "websocket_gateway.h"
+
+using namespace Microsoft::CognitiveServices::Speech;
+using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+// Gets the CPU time used by the process so far, in seconds.
+static double getProcessCpuSeconds()
+{
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// Serves recognition over WebSocket on a TCP port until Enter is pressed: each connection streams its audio into a
+// push stream of its own, recognized continuously, and gets partial and final results back as they come.
+void recognizeWebSocketStreams(uint16_t port)
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Stops recognition when destroyed, which the gateway does off its server thread once the connection is closed.
+    struct Session
+    {
+        std::shared_ptr<SpeechRecognizer> Recognizer;
+        std::future<void> Started;
+
+        ~Session()
+        {
+            Started.wait();
+            Recognizer->StopContinuousRecognitionAsync().get();
+        }
+    };
+
+    WebSocketGateway::Options options;
+    options.Port = port;
+    auto factory = [config](const std::string&, std::shared_ptr<PushAudioInputStream> stream, WebSocketGateway::ResultSink sink)
+    {
+        using ResultType = WebSocketGateway::ResultType;
+
+        auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(stream));
+        // Offsets and durations are in ticks of 100 ns.
+        recognizer->Recognizing.Connect([sink](const SpeechRecognitionEventArgs& e)
+        {
+            sink(ResultType::Partial, e.Result->Offset() / 10000, e.Result->Duration() / 10000, e.Result->Text);
+        });
+        recognizer->Recognized.Connect([sink](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedSpeech)
+            {
+                sink(ResultType::Final, e.Result->Offset() / 10000, e.Result->Duration() / 10000, e.Result->Text);
+            }
+        });
+        recognizer->Canceled.Connect([sink](const SpeechRecognitionCanceledEventArgs& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                sink(ResultType::Error, 0, 0, e.ErrorDetails);
+            }
+        });
+        recognizer->SessionStopped.Connect([sink](const SessionEventArgs&)
+        {
+            sink(ResultType::Done, 0, 0, std::string());
+        });
+
+        // Recognition starts without blocking the server thread; the session lives as long as the connection.
+        // A client that sent all its audio is closed after 'D', once the session has stopped on its own.
+        auto session = std::make_shared<Session>();
+        session->Recognizer = recognizer;
+        session->Started = recognizer->StartContinuousRecognitionAsync();
+        return WebSocketGateway::AudioEnded([session](uint64_t) {});
+    };
+
+    WebSocketGateway gateway(options, factory);
+    std::cout << "Listening for WebSocket connections on TCP port " << port << ", press Enter to stop." << std::endl;
+    std::cin.get();
+    gateway.Stop();
+
+    auto statistics = gateway.GetStatistics();
+    std::cout << statistics.Accepted << " connections, " << statistics.AudioBytes << " bytes of audio, "
+              << statistics.ResultFrames << " results (" << statistics.ReplacedPartials << " partials replaced)." << std::endl;
+}
+
+// Load test of the WebSocket gateway with the given number of local clients, each streaming the given seconds of
+// audio at real time in frames of the given duration. The gateway runs without recognizers, answering the end of the audio with a final result
+// and 'D', so that the connection handling, framing and result path are measured alone.
+void loadTestWebSocketGateway(size_t clients, uint32_t audioSeconds, uint32_t frameMs)
+{
+    // Each client takes two descriptors in the process, its own and the one of its connection in the gateway.
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    WebSocketGateway::Options options;
+    options.Port = 18080;
+    options.WriteToStreams = false;
+    auto factory = [](const std::string&, std::shared_ptr<PushAudioInputStream>, WebSocketGateway::ResultSink sink)
+    {
+        return WebSocketGateway::AudioEnded([sink](uint64_t audioBytes)
+        {
+            // 16 kHz 16-bit mono PCM is 32 bytes per millisecond.
+            sink(WebSocketGateway::ResultType::Final, 0, audioBytes / 32, std::to_string(audioBytes) + " bytes");
+            sink(WebSocketGateway::ResultType::Done, 0, 0, std::string());
+        });
+    };
+    WebSocketGateway gateway(options, factory);
+
+    WebSocketLoadTest::Options loadOptions;
+    loadOptions.Port = options.Port;
+    loadOptions.Clients = clients;
+    loadOptions.AudioSeconds = audioSeconds;
+    loadOptions.FrameMs = frameMs;
+    WebSocketLoadTest loadTest(loadOptions);
+    auto cpuStart = getProcessCpuSeconds();
+    auto start = std::chrono::steady_clock::now();
+    auto result = loadTest.Run();
+    auto wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    auto cpuSeconds = getProcessCpuSeconds() - cpuStart;
+    gateway.Stop();
+
+    auto statistics = gateway.GetStatistics();
+    std::cout << clients << " clients: " << result.Completed << " completed, " << result.Failed << " failed in " << wallSeconds << " s" << std::endl;
+    std::cout << "Handshake: average " << result.AverageHandshakeMs << " ms, 95th percentile " << result.P95HandshakeMs << " ms" << std::endl;
+    std::cout << "End of audio to results: average " << result.AverageTurnaroundMs << " ms, 95th percentile "
+              << result.P95TurnaroundMs << " ms, max " << result.MaxTurnaroundMs << " ms" << std::endl;
+    std::cout << "Gateway: " << statistics.AudioFrames << " audio frames, " << statistics.ResultFrames << " results, "
+              << statistics.LimitCloses << " closed over limits, peak buffers " << statistics.PeakBufferBytes / 1024 << " KB ("
+              << statistics.PeakBufferBytes / std::max<size_t>(clients, 1) << " bytes per connection)" << std::endl;
+    std::cout << "CPU of clients and gateway: " << cpuSeconds << " s" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    setlocale(LC_ALL, "");
+    if (argc == 3 && std::string(argv[1]) == "--serve")
+    {
+        recognizeWebSocketStreams(static_cast<uint16_t>(atoi(argv[2])));
+        return 0;
+    }
+    if (argc >= 2 && argc <= 5 && std::string(argv[1]) == "--loadtest")
+    {
+        loadTestWebSocketGateway(argc >= 3 ? std::max(1, atoi(argv[2])) : 1000, argc >= 4 ? std::max(1, atoi(argv[3])) : 5,
+                                 argc == 5 ? std::max(1, atoi(argv[4])) : 20);
+        return 0;
+    }
+
+    std::cout << "Usage: ./websocket-gateway --serve <port>" << std::endl;
+    std::cout << "       ./websocket-gateway --loadtest [<clients> [<seconds of audio> [<frame ms>]]]" << std::endl;
+    return 0;
+}
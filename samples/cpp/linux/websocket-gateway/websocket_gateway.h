@@ -0,0 +1,1241 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Opening handshake of RFC 6455: the accept key is the base64 of the SHA-1 of the client key and a fixed GUID.
+class WebSocketHandshake final
+{
+public:
+    static std::string GetAcceptKey(const std::string& key)
+    {
+        auto digest = Sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+        return Base64(digest, sizeof(digest));
+    }
+
+private:
+    struct Digest
+    {
+        uint8_t Bytes[20];
+    };
+
+    static uint32_t Rotate(uint32_t value, int bits)
+    {
+        return value << bits | value >> (32 - bits);
+    }
+
+    static std::string Base64(const Digest& digest, size_t size)
+    {
+        static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string encoded;
+        for (size_t i = 0; i < size; i += 3)
+        {
+            uint32_t group = static_cast<uint32_t>(digest.Bytes[i]) << 16;
+            group |= i + 1 < size ? digest.Bytes[i + 1] << 8 : 0;
+            group |= i + 2 < size ? digest.Bytes[i + 2] : 0;
+            encoded += alphabet[group >> 18 & 63];
+            encoded += alphabet[group >> 12 & 63];
+            encoded += i + 1 < size ? alphabet[group >> 6 & 63] : '=';
+            encoded += i + 2 < size ? alphabet[group & 63] : '=';
+        }
+        return encoded;
+    }
+
+    static Digest Sha1(const std::string& message)
+    {
+        uint32_t state[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+        std::vector<uint8_t> data(message.begin(), message.end());
+        uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+        data.push_back(0x80);
+        while (data.size() % 64 != 56)
+        {
+            data.push_back(0);
+        }
+        for (int i = 7; i >= 0; i--)
+        {
+            data.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+        }
+
+        for (size_t block = 0; block < data.size(); block += 64)
+        {
+            uint32_t w[80];
+            for (int i = 0; i < 16; i++)
+            {
+                const auto* p = &data[block + 4 * i];
+                w[i] = static_cast<uint32_t>(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3];
+            }
+            for (int i = 16; i < 80; i++)
+            {
+                w[i] = Rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+            for (int i = 0; i < 80; i++)
+            {
+                uint32_t f, k;
+                if (i < 20)
+                {
+                    f = (b & c) | (~b & d);
+                    k = 0x5a827999;
+                }
+                else if (i < 40)
+                {
+                    f = b ^ c ^ d;
+                    k = 0x6ed9eba1;
+                }
+                else if (i < 60)
+                {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8f1bbcdc;
+                }
+                else
+                {
+                    f = b ^ c ^ d;
+                    k = 0xca62c1d6;
+                }
+                auto temp = Rotate(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = Rotate(b, 30);
+                b = a;
+                a = temp;
+            }
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+        }
+
+        Digest digest;
+        for (int i = 0; i < 20; i++)
+        {
+            digest.Bytes[i] = static_cast<uint8_t>(state[i / 4] >> (24 - 8 * (i % 4)));
+        }
+        return digest;
+    }
+};
+
+// Local WebSocket server that browsers and apps stream audio to, one recognition session per connection.
+//
+// Binary messages carry the audio. Each frame is unmasked in place in the receive buffer of its connection and
+// written from there to the push stream of the connection, without being copied or reassembled; a text message
+// "end" ends the audio. Results are sent back as binary frames of 9 bytes followed by the UTF-8 text: the type
+// ('P' partial, 'F' final, 'E' error, 'D' done), then the offset and the duration in milliseconds, as 32-bit little
+// endian integers. After 'D', the server closes the connection.
+//
+// One thread serves all connections with epoll. The memory of a connection is bounded: its receive buffer grows
+// to the largest frame allowed and no further, and results that the client does not read pile up only to a limit,
+// past which the connection is closed; a partial result still queued is replaced by the next one instead.
+// The audio format is chosen by the request target: "/?format=opus" for Ogg Opus, 16 kHz mono PCM otherwise.
+class WebSocketGateway final
+{
+public:
+    enum class ResultType : uint8_t
+    {
+        Partial = 'P',
+        Final = 'F',
+        Error = 'E',
+        Done = 'D',
+    };
+
+    // Sends a result to the client; can be called from any thread, until the session is destroyed.
+    using ResultSink = std::function<void(ResultType type, uint64_t offsetMs, uint64_t durationMs, const std::string& text)>;
+
+    // Called on the server thread when the audio ends, after the push stream is closed, with the bytes received.
+    using AudioEnded = std::function<void(uint64_t audioBytes)>;
+
+    // Called on the server thread for each new connection, with its push stream (null if WriteToStreams is off).
+    // The returned function holds the state of the session, e.g. the recognizer, which lives as long as the connection.
+    // It is destroyed once the connection is closed, on another thread than the server thread, so its destruction may
+    // block, e.g. to stop the recognizer, without holding up the other connections.
+    using SessionFactory = std::function<AudioEnded(const std::string& target, std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> stream, ResultSink sink)>;
+
+    struct Options
+    {
+        uint16_t Port = 8080;
+        size_t MaxConnections = 10000;
+        uint32_t MaxFrameBytes = 64 * 1024;         // Largest audio frame; larger ones close the connection.
+        uint32_t MaxPendingResultBytes = 64 * 1024; // Results not yet sent to the client.
+        bool WriteToStreams = true;                 // If false, the audio is received but not written, to measure the server.
+        size_t ReaperThreads = 4;                   // Threads destroying the sessions of closed connections.
+    };
+
+    struct Statistics
+    {
+        uint64_t Accepted = 0;
+        uint64_t Refused = 0;               // Over the connection limit, or not a WebSocket handshake.
+        uint64_t ActiveConnections = 0;
+        uint64_t AudioFrames = 0;
+        uint64_t AudioBytes = 0;
+        uint64_t ResultFrames = 0;
+        uint64_t ReplacedPartials = 0;
+        uint64_t LimitCloses = 0;           // Connections closed for a frame or for results over the limits.
+        uint64_t BufferBytes = 0;           // Receive buffers and pending results of all connections.
+        uint64_t PeakBufferBytes = 0;
+    };
+
+    WebSocketGateway(const Options& options, SessionFactory factory)
+        : m_options(options),
+          m_factory(factory)
+    {
+        m_listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(m_options.Port);
+        if (m_listener < 0 || bind(m_listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(m_listener, 4096) != 0)
+        {
+            close(m_listener);
+            throw std::runtime_error("Cannot listen on TCP port " + std::to_string(m_options.Port) + ".");
+        }
+
+        m_epoll = epoll_create1(EPOLL_CLOEXEC);
+        m_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        Watch(m_listener, listenerId, EPOLLIN, EPOLL_CTL_ADD);
+        Watch(m_wakeup, wakeupId, EPOLLIN, EPOLL_CTL_ADD);
+        for (size_t i = 0; i < std::max<size_t>(m_options.ReaperThreads, 1); i++)
+        {
+            m_reapers.emplace_back([this]() { Reap(); });
+        }
+        m_thread = std::thread([this]() { Run(); });
+    }
+
+    // Closes all connections and stops the server.
+    ~WebSocketGateway()
+    {
+        Stop();
+        close(m_wakeup);
+        close(m_epoll);
+        close(m_listener);
+    }
+
+    WebSocketGateway(const WebSocketGateway&) = delete;
+    WebSocketGateway& operator=(const WebSocketGateway&) = delete;
+
+    void Stop()
+    {
+        if (m_thread.joinable())
+        {
+            m_stopping = true;
+            Wake();
+            m_thread.join();
+        }
+
+        // All connections are closed, so the reapers stop once they have destroyed their sessions.
+        {
+            std::lock_guard<std::mutex> lock(m_closedSessionsMutex);
+            m_reaperStopping = true;
+        }
+        m_closedSessionsChanged.notify_all();
+        for (auto& reaper : m_reapers)
+        {
+            reaper.join();
+        }
+        m_reapers.clear();
+    }
+
+    Statistics GetStatistics() const
+    {
+        Statistics statistics;
+        statistics.Accepted = m_accepted;
+        statistics.Refused = m_refused;
+        statistics.ActiveConnections = m_activeConnections;
+        statistics.AudioFrames = m_audioFrames;
+        statistics.AudioBytes = m_audioBytes;
+        statistics.ResultFrames = m_resultFrames;
+        statistics.ReplacedPartials = m_replacedPartials;
+        statistics.LimitCloses = m_limitCloses;
+        statistics.BufferBytes = m_bufferBytes;
+        statistics.PeakBufferBytes = m_peakBufferBytes;
+        return statistics;
+    }
+
+private:
+    static constexpr uint64_t listenerId = 0;
+    static constexpr uint64_t wakeupId = 1;
+    static constexpr size_t initialBufferSize = 4096;
+    static constexpr size_t maxHandshakeSize = 8192;
+    static constexpr size_t maxFrameHeaderSize = 14;
+
+    struct Connection
+    {
+        int Fd = -1;
+        uint64_t Id = 0;
+        bool Open = false;                  // Handshake done.
+        bool EndOfAudio = false;
+        bool Closing = false;               // Closed once the output is sent.
+        bool Writable = true;
+        std::vector<uint8_t> Input;
+        size_t InputSize = 0;
+        std::deque<std::string> Output;
+        size_t OutputOffset = 0;            // Bytes of the first output frame already sent.
+        size_t OutputBytes = 0;
+        bool LastOutputIsPartial = false;
+        uint64_t AudioBytes = 0;
+        uint8_t MessageOpcode = 0;          // Of the fragmented message being received, 0 if none.
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> Stream;
+        AudioEnded OnAudioEnded;
+    };
+
+    struct PostedResult
+    {
+        uint64_t ConnectionId;
+        ResultType Type;
+        std::string Frame;
+    };
+
+    void Watch(int fd, uint64_t id, uint32_t events, int operation)
+    {
+        epoll_event event = {};
+        event.events = events;
+        event.data.u64 = id;
+        epoll_ctl(m_epoll, operation, fd, &event);
+    }
+
+    void Wake()
+    {
+        uint64_t one = 1;
+        (void)write(m_wakeup, &one, sizeof(one));
+    }
+
+    void AddBufferBytes(int64_t bytes)
+    {
+        auto total = m_bufferBytes += static_cast<uint64_t>(bytes);
+        if (total > m_peakBufferBytes)
+        {
+            m_peakBufferBytes = total;
+        }
+    }
+
+    void Run()
+    {
+        epoll_event events[256];
+        while (!m_stopping)
+        {
+            int count = epoll_wait(m_epoll, events, 256, 100);
+            for (int i = 0; i < count; i++)
+            {
+                auto id = events[i].data.u64;
+                if (id == listenerId)
+                {
+                    Accept();
+                    continue;
+                }
+                if (id == wakeupId)
+                {
+                    uint64_t value;
+                    (void)read(m_wakeup, &value, sizeof(value));
+                    DeliverResults();
+                    continue;
+                }
+
+                auto found = m_connections.find(id);
+                if (found == m_connections.end())
+                {
+                    continue;
+                }
+                auto& connection = *found->second;
+                bool keep = true;
+                if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0)
+                {
+                    keep = Receive(connection);
+                }
+                if (keep && (events[i].events & EPOLLOUT) != 0)
+                {
+                    keep = Send(connection);
+                }
+                if (!keep)
+                {
+                    CloseConnection(id);
+                }
+            }
+        }
+
+        while (!m_connections.empty())
+        {
+            CloseConnection(m_connections.begin()->first);
+        }
+    }
+
+    void Accept()
+    {
+        for (;;)
+        {
+            int fd = accept4(m_listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+                return;
+            }
+            if (m_connections.size() >= m_options.MaxConnections)
+            {
+                m_refused++;
+                close(fd);
+                continue;
+            }
+
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            std::unique_ptr<Connection> connection(new Connection());
+            connection->Fd = fd;
+            connection->Id = m_nextId++;
+            connection->Input.resize(initialBufferSize);
+            AddBufferBytes(initialBufferSize);
+            Watch(fd, connection->Id, EPOLLIN, EPOLL_CTL_ADD);
+            m_connections.emplace(connection->Id, std::move(connection));
+            m_accepted++;
+            m_activeConnections++;
+        }
+    }
+
+    void CloseConnection(uint64_t id)
+    {
+        auto found = m_connections.find(id);
+        auto& connection = *found->second;
+        EndAudio(connection);
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, connection.Fd, nullptr);
+        close(connection.Fd);
+        AddBufferBytes(-static_cast<int64_t>(connection.Input.size() + connection.OutputBytes));
+        m_activeConnections--;
+
+        // The session is handed to the reapers after the connection is gone, so that results it still sends are dropped.
+        auto session = std::move(connection.OnAudioEnded);
+        m_connections.erase(found);
+        if (session)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_closedSessionsMutex);
+                m_closedSessions.push_back(std::move(session));
+            }
+            m_closedSessionsChanged.notify_one();
+        }
+    }
+
+    // Destroys the sessions of the closed connections, off the server thread.
+    void Reap()
+    {
+        std::unique_lock<std::mutex> lock(m_closedSessionsMutex);
+        for (;;)
+        {
+            m_closedSessionsChanged.wait(lock, [this]() { return !m_closedSessions.empty() || m_reaperStopping; });
+            if (m_closedSessions.empty())
+            {
+                return;
+            }
+            auto session = std::move(m_closedSessions.front());
+            m_closedSessions.pop_front();
+            lock.unlock();
+            session = nullptr;
+            lock.lock();
+        }
+    }
+
+    bool Receive(Connection& connection)
+    {
+        for (;;)
+        {
+            if (connection.InputSize == connection.Input.size())
+            {
+                // The buffer only grows when a frame needs it, see ProcessFrames().
+                connection.Closing = true;
+                m_limitCloses++;
+                return false;
+            }
+            auto received = recv(connection.Fd, connection.Input.data() + connection.InputSize, connection.Input.size() - connection.InputSize, 0);
+            if (received == 0)
+            {
+                return false;
+            }
+            if (received < 0)
+            {
+                // Sends what the frames received have queued, e.g. the handshake response or pongs.
+                return (errno == EAGAIN || errno == EWOULDBLOCK) && Send(connection);
+            }
+            connection.InputSize += static_cast<size_t>(received);
+            if (!(connection.Open ? ProcessFrames(connection) : ProcessHandshake(connection)))
+            {
+                return false;
+            }
+            if (connection.Closing)
+            {
+                // Ignores what the client sends after a close.
+                connection.InputSize = 0;
+                return Send(connection);
+            }
+        }
+    }
+
+    bool ProcessHandshake(Connection& connection)
+    {
+        std::string request(reinterpret_cast<const char*>(connection.Input.data()), connection.InputSize);
+        auto end = request.find("\r\n\r\n");
+        if (end == std::string::npos)
+        {
+            if (connection.InputSize == connection.Input.size() && connection.InputSize < maxHandshakeSize)
+            {
+                AddBufferBytes(static_cast<int64_t>(maxHandshakeSize - connection.Input.size()));
+                connection.Input.resize(maxHandshakeSize);
+            }
+            return connection.InputSize < maxHandshakeSize;
+        }
+
+        std::string target;
+        std::string key;
+        size_t lineStart = 0;
+        for (size_t line = 0; lineStart < end; line++)
+        {
+            auto lineEnd = request.find("\r\n", lineStart);
+            auto text = request.substr(lineStart, lineEnd - lineStart);
+            lineStart = lineEnd + 2;
+            if (line == 0)
+            {
+                if (text.compare(0, 4, "GET ") == 0)
+                {
+                    target = text.substr(4, text.find(' ', 4) - 4);
+                }
+                continue;
+            }
+            auto colon = text.find(':');
+            if (colon == std::string::npos)
+            {
+                continue;
+            }
+            auto name = text.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            if (name == "sec-websocket-key")
+            {
+                key = text.substr(text.find_first_not_of(' ', colon + 1));
+            }
+        }
+        if (target.empty() || key.empty())
+        {
+            static const char response[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            (void)send(connection.Fd, response, sizeof(response) - 1, MSG_NOSIGNAL);
+            m_refused++;
+            return false;
+        }
+
+        QueueOutput(connection, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                                "Sec-WebSocket-Accept: " + WebSocketHandshake::GetAcceptKey(key) + "\r\n\r\n", false);
+        connection.Open = true;
+        Consume(connection, end + 4, initialBufferSize);
+        StartSession(connection, target);
+        return ProcessFrames(connection);
+    }
+
+    void StartSession(Connection& connection, const std::string& target)
+    {
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        if (m_options.WriteToStreams)
+        {
+            auto format = target.find("format=opus") != std::string::npos
+                ? AudioStreamFormat::GetCompressedFormat(AudioStreamContainerFormat::OGG_OPUS)
+                : AudioStreamFormat::GetWaveFormatPCM(16000, 16, 1);
+            connection.Stream = AudioInputStream::CreatePushStream(format);
+        }
+
+        auto id = connection.Id;
+        ResultSink sink = [this, id](ResultType type, uint64_t offsetMs, uint64_t durationMs, const std::string& text)
+        {
+            PostedResult result{ id, type, std::string() };
+            result.Frame.reserve(9 + text.size());
+            result.Frame += static_cast<char>(type);
+            for (auto value : { offsetMs, durationMs })
+            {
+                for (int i = 0; i < 4; i++)
+                {
+                    result.Frame += static_cast<char>(value >> (8 * i));
+                }
+            }
+            result.Frame += text;
+            {
+                std::lock_guard<std::mutex> lock(m_resultsMutex);
+                m_results.push_back(std::move(result));
+            }
+            Wake();
+        };
+        connection.OnAudioEnded = m_factory(target, connection.Stream, sink);
+    }
+
+    // Handles the complete frames in the receive buffer, and makes room for the next one.
+    bool ProcessFrames(Connection& connection)
+    {
+        size_t offset = 0;
+        size_t needed = initialBufferSize;     // Buffer size needed by the frame partly received, if larger.
+        for (;;)
+        {
+            auto* data = connection.Input.data() + offset;
+            auto available = connection.InputSize - offset;
+            if (available < 2)
+            {
+                break;
+            }
+            bool final = (data[0] & 0x80) != 0;
+            uint8_t opcode = data[0] & 0x0f;
+            bool masked = (data[1] & 0x80) != 0;
+            uint64_t length = data[1] & 0x7f;
+            size_t headerSize = 2;
+            if (length == 126)
+            {
+                headerSize = 4;
+                if (available < headerSize)
+                {
+                    break;
+                }
+                length = static_cast<uint64_t>(data[2]) << 8 | data[3];
+            }
+            else if (length == 127)
+            {
+                headerSize = 10;
+                if (available < headerSize)
+                {
+                    break;
+                }
+                length = 0;
+                for (int i = 0; i < 8; i++)
+                {
+                    length = length << 8 | data[2 + i];
+                }
+            }
+            if (!masked)
+            {
+                // Client frames must be masked (RFC 6455, 5.1).
+                QueueClose(connection, 1002);
+                return true;
+            }
+            if (length > m_options.MaxFrameBytes)
+            {
+                m_limitCloses++;
+                QueueClose(connection, 1009);
+                return true;
+            }
+            headerSize += 4;
+            if (available < headerSize + length)
+            {
+                needed = std::max(needed, headerSize + static_cast<size_t>(length));
+                if (needed > connection.Input.size())
+                {
+                    AddBufferBytes(static_cast<int64_t>(needed - connection.Input.size()));
+                    connection.Input.resize(needed);
+                    data = connection.Input.data() + offset;
+                }
+                break;
+            }
+
+            // Unmasks the payload in place.
+            auto* payload = data + headerSize;
+            const auto* mask = data + headerSize - 4;
+            for (size_t i = 0; i < length; i++)
+            {
+                payload[i] ^= mask[i & 3];
+            }
+            offset += headerSize + static_cast<size_t>(length);
+            HandleFrame(connection, opcode, final, payload, static_cast<size_t>(length));
+            if (connection.Closing)
+            {
+                return true;
+            }
+        }
+        Consume(connection, offset, needed);
+        return true;
+    }
+
+    void HandleFrame(Connection& connection, uint8_t opcode, bool final, uint8_t* payload, size_t length)
+    {
+        // A continuation frame is of the type of the text or binary frame that began its message.
+        auto messageOpcode = opcode;
+        if (opcode <= 0x2)
+        {
+            if ((opcode == 0x0) == (connection.MessageOpcode == 0))
+            {
+                // A continuation without a message begun, or a new message before the last one ended.
+                QueueClose(connection, 1002);
+                return;
+            }
+            if (opcode == 0x0)
+            {
+                messageOpcode = connection.MessageOpcode;
+            }
+            connection.MessageOpcode = final ? 0 : messageOpcode;
+        }
+
+        switch (messageOpcode)
+        {
+        case 0x2: // Binary
+            if (!connection.EndOfAudio)
+            {
+                if (connection.Stream && length > 0)
+                {
+                    connection.Stream->Write(payload, static_cast<uint32_t>(length));
+                }
+                connection.AudioBytes += length;
+                m_audioFrames++;
+                m_audioBytes += length;
+            }
+            break;
+        case 0x1: // Text
+            // Only an unfragmented "end" is a command; other text is ignored.
+            if (opcode == 0x1 && final && length == 3 && memcmp(payload, "end", 3) == 0)
+            {
+                EndAudio(connection);
+            }
+            break;
+        case 0x8: // Close
+            EndAudio(connection);
+            QueueClose(connection, 1000);
+            break;
+        case 0x9: // Ping
+            QueueOutput(connection, Frame(0xa, std::string(reinterpret_cast<const char*>(payload), std::min<size_t>(length, 125))), false);
+            break;
+        case 0xa: // Pong
+            break;
+        default:
+            QueueClose(connection, 1002);
+            break;
+        }
+    }
+
+    void EndAudio(Connection& connection)
+    {
+        if (connection.EndOfAudio || !connection.Open)
+        {
+            return;
+        }
+        connection.EndOfAudio = true;
+        if (connection.Stream)
+        {
+            connection.Stream->Close();
+        }
+        if (connection.OnAudioEnded)
+        {
+            connection.OnAudioEnded(connection.AudioBytes);
+        }
+    }
+
+    // Removes the frames handled from the receive buffer, which keeps at least the size the next frame needs.
+    void Consume(Connection& connection, size_t size, size_t needed)
+    {
+        connection.InputSize -= size;
+        memmove(connection.Input.data(), connection.Input.data() + size, connection.InputSize);
+
+        // Gives back the memory of a large frame once it is handled, unless the frame partly received needs it.
+        if (connection.Input.size() > needed && connection.InputSize <= needed)
+        {
+            AddBufferBytes(static_cast<int64_t>(needed) - static_cast<int64_t>(connection.Input.size()));
+            connection.Input.resize(needed);
+            connection.Input.shrink_to_fit();
+        }
+    }
+
+    static std::string Frame(uint8_t opcode, const std::string& payload)
+    {
+        std::string frame;
+        frame += static_cast<char>(0x80 | opcode);
+        if (payload.size() < 126)
+        {
+            frame += static_cast<char>(payload.size());
+        }
+        else
+        {
+            // Results are far shorter than 64 KB.
+            frame += static_cast<char>(126);
+            frame += static_cast<char>(payload.size() >> 8);
+            frame += static_cast<char>(payload.size());
+        }
+        return frame + payload;
+    }
+
+    void QueueOutput(Connection& connection, std::string data, bool isPartial)
+    {
+        // A partial result not yet being sent is out of date, and replaced.
+        bool replace = isPartial && connection.LastOutputIsPartial && connection.Output.size() > (connection.OutputOffset > 0 ? 1u : 0u);
+        if (replace)
+        {
+            AddBufferBytes(-static_cast<int64_t>(connection.Output.back().size()));
+            connection.OutputBytes -= connection.Output.back().size();
+            connection.Output.back() = std::move(data);
+            m_replacedPartials++;
+        }
+        else
+        {
+            connection.Output.push_back(std::move(data));
+        }
+        connection.OutputBytes += connection.Output.back().size();
+        AddBufferBytes(static_cast<int64_t>(connection.Output.back().size()));
+        connection.LastOutputIsPartial = isPartial;
+    }
+
+    void QueueClose(Connection& connection, uint16_t status)
+    {
+        if (!connection.Closing)
+        {
+            std::string payload{ static_cast<char>(status >> 8), static_cast<char>(status & 0xff) };
+            QueueOutput(connection, Frame(0x8, payload), false);
+            connection.Closing = true;
+        }
+    }
+
+    void DeliverResults()
+    {
+        std::vector<PostedResult> results;
+        {
+            std::lock_guard<std::mutex> lock(m_resultsMutex);
+            results.swap(m_results);
+        }
+
+        for (auto& result : results)
+        {
+            auto found = m_connections.find(result.ConnectionId);
+            if (found == m_connections.end() || found->second->Closing)
+            {
+                continue;
+            }
+            auto& connection = *found->second;
+            QueueOutput(connection, Frame(0x2, result.Frame), result.Type == ResultType::Partial);
+            m_resultFrames++;
+            if (connection.OutputBytes > m_options.MaxPendingResultBytes)
+            {
+                m_limitCloses++;
+                CloseConnection(result.ConnectionId);
+                continue;
+            }
+            if (result.Type == ResultType::Done)
+            {
+                QueueClose(connection, 1000);
+            }
+            if (!Send(connection))
+            {
+                CloseConnection(result.ConnectionId);
+            }
+        }
+    }
+
+    // Sends the queued output; returns false once the connection is to be closed.
+    bool Send(Connection& connection)
+    {
+        while (!connection.Output.empty())
+        {
+            const auto& data = connection.Output.front();
+            auto sent = send(connection.Fd, data.data() + connection.OutputOffset, data.size() - connection.OutputOffset, MSG_NOSIGNAL);
+            if (sent < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                {
+                    return false;
+                }
+                if (connection.Writable)
+                {
+                    connection.Writable = false;
+                    Watch(connection.Fd, connection.Id, EPOLLIN | EPOLLOUT, EPOLL_CTL_MOD);
+                }
+                return true;
+            }
+            connection.OutputOffset += static_cast<size_t>(sent);
+            if (connection.OutputOffset == data.size())
+            {
+                AddBufferBytes(-static_cast<int64_t>(data.size()));
+                connection.OutputBytes -= data.size();
+                connection.OutputOffset = 0;
+                connection.Output.pop_front();
+                if (connection.Output.empty())
+                {
+                    connection.LastOutputIsPartial = false;
+                }
+            }
+        }
+
+        if (!connection.Writable)
+        {
+            connection.Writable = true;
+            Watch(connection.Fd, connection.Id, EPOLLIN, EPOLL_CTL_MOD);
+        }
+        return !connection.Closing;
+    }
+
+    Options m_options;
+    SessionFactory m_factory;
+    int m_listener = -1;
+    int m_epoll = -1;
+    int m_wakeup = -1;
+    std::thread m_thread;
+    std::atomic<bool> m_stopping{ false };
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> m_connections;
+    std::vector<std::thread> m_reapers;
+    std::mutex m_closedSessionsMutex;
+    std::condition_variable m_closedSessionsChanged;
+    std::deque<AudioEnded> m_closedSessions;
+    bool m_reaperStopping = false;
+    uint64_t m_nextId = 2;
+    std::mutex m_resultsMutex;
+    std::vector<PostedResult> m_results;
+    std::atomic<uint64_t> m_accepted{ 0 };
+    std::atomic<uint64_t> m_refused{ 0 };
+    std::atomic<uint64_t> m_activeConnections{ 0 };
+    std::atomic<uint64_t> m_audioFrames{ 0 };
+    std::atomic<uint64_t> m_audioBytes{ 0 };
+    std::atomic<uint64_t> m_resultFrames{ 0 };
+    std::atomic<uint64_t> m_replacedPartials{ 0 };
+    std::atomic<uint64_t> m_limitCloses{ 0 };
+    std::atomic<uint64_t> m_bufferBytes{ 0 };
+    std::atomic<uint64_t> m_peakBufferBytes{ 0 };
+};
+
+// Load test of the gateway with many local clients in one thread: each connects, streams a 440 Hz tone at real time
+// in frames of 20 ms or of the given duration, ends the audio and waits for the 'D' result. Reports the handshake time and the time from the
+// end of the audio to 'D', which is the turnaround time of the results when the gateway runs recognizers.
+class WebSocketLoadTest final
+{
+public:
+    struct Options
+    {
+        uint16_t Port = 8080;
+        size_t Clients = 1000;
+        uint32_t AudioSeconds = 5;
+        uint32_t FrameMs = 20;              // Audio per frame, 32 bytes per millisecond; frames are sent at real time.
+        uint32_t RampMs = 1000;             // Time over which the clients connect.
+        uint32_t TimeoutSeconds = 30;       // After the end of the audio.
+    };
+
+    struct Result
+    {
+        size_t Completed = 0;
+        size_t Failed = 0;
+        uint64_t FramesSent = 0;
+        uint64_t ResultFrames = 0;
+        double AverageHandshakeMs = 0;
+        double P95HandshakeMs = 0;
+        double AverageTurnaroundMs = 0;
+        double P95TurnaroundMs = 0;
+        double MaxTurnaroundMs = 0;
+    };
+
+    explicit WebSocketLoadTest(const Options& options)
+        : m_options(options)
+    {
+    }
+
+    Result Run()
+    {
+        using Clock = std::chrono::steady_clock;
+        enum class Phase { Waiting, Connecting, Handshake, Streaming, Ending, Done, Failed };
+        struct Client
+        {
+            int Fd = -1;
+            Phase State = Phase::Waiting;
+            std::string Output;
+            size_t OutputOffset = 0;
+            std::vector<uint8_t> Input;
+            uint32_t FramesSent = 0;
+            Clock::time_point Connected;
+            Clock::time_point Streaming;
+            Clock::time_point Ended;
+        };
+
+        // FrameMs of 16 kHz 16-bit mono PCM.
+        const auto frameMs = std::chrono::milliseconds(std::max<uint32_t>(m_options.FrameMs, 1));
+        std::string frame(static_cast<size_t>(frameMs.count()) * 32, '\0');
+        for (size_t i = 0; i < frame.size() / 2; i++)
+        {
+            auto sample = static_cast<int16_t>(8000 * std::sin(2 * 3.14159265358979 * 440 * i / 16000));
+            frame[2 * i] = static_cast<char>(sample & 0xff);
+            frame[2 * i + 1] = static_cast<char>(sample >> 8);
+        }
+        const auto totalFrames = std::max<uint32_t>(static_cast<uint32_t>(m_options.AudioSeconds * 1000 / frameMs.count()), 1);
+        const std::string request = "GET /?format=pcm HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                                    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+        const std::string expectedAccept = "Sec-WebSocket-Accept: " + WebSocketHandshake::GetAcceptKey("dGhlIHNhbXBsZSBub25jZQ==");
+
+        Result result;
+        std::vector<Client> clients(m_options.Clients);
+        std::vector<double> handshakeMs;
+        std::vector<double> turnaroundMs;
+        std::mt19937 random(7);
+        int epoll = epoll_create1(EPOLL_CLOEXEC);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(m_options.Port);
+
+        auto fail = [&](Client& client)
+        {
+            if (client.Fd >= 0)
+            {
+                close(client.Fd);
+                client.Fd = -1;
+            }
+            client.State = Phase::Failed;
+            result.Failed++;
+        };
+        auto flush = [&](Client& client)
+        {
+            while (client.OutputOffset < client.Output.size())
+            {
+                auto sent = send(client.Fd, client.Output.data() + client.OutputOffset, client.Output.size() - client.OutputOffset, MSG_NOSIGNAL);
+                if (sent < 0)
+                {
+                    if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    {
+                        fail(client);
+                    }
+                    return;
+                }
+                client.OutputOffset += static_cast<size_t>(sent);
+            }
+            client.Output.clear();
+            client.OutputOffset = 0;
+        };
+        auto queueFrame = [&](Client& client, uint8_t opcode, const std::string& payload)
+        {
+            client.Output += static_cast<char>(0x80 | opcode);
+            if (payload.size() < 126)
+            {
+                client.Output += static_cast<char>(0x80 | payload.size());
+            }
+            else if (payload.size() < 65536)
+            {
+                client.Output += static_cast<char>(0x80 | 126);
+                client.Output += static_cast<char>(payload.size() >> 8);
+                client.Output += static_cast<char>(payload.size());
+            }
+            else
+            {
+                client.Output += static_cast<char>(0x80 | 127);
+                for (int shift = 56; shift >= 0; shift -= 8)
+                {
+                    client.Output += static_cast<char>(static_cast<uint64_t>(payload.size()) >> shift);
+                }
+            }
+            uint8_t mask[4];
+            for (auto& byte : mask)
+            {
+                byte = static_cast<uint8_t>(random());
+                client.Output += static_cast<char>(byte);
+            }
+            for (size_t i = 0; i < payload.size(); i++)
+            {
+                client.Output += static_cast<char>(payload[i] ^ mask[i & 3]);
+            }
+        };
+
+        auto start = Clock::now();
+        size_t finished = 0;
+        size_t next = 0;
+        epoll_event events[256];
+        while (finished < clients.size())
+        {
+            auto now = Clock::now();
+            for (; next < clients.size() && now - start >= std::chrono::milliseconds(m_options.RampMs * next / clients.size()); next++)
+            {
+                auto& client = clients[next];
+                client.Fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+                client.Connected = now;
+                if (client.Fd < 0 || (connect(client.Fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 && errno != EINPROGRESS))
+                {
+                    fail(client);
+                    finished++;
+                    continue;
+                }
+                client.State = Phase::Connecting;
+                epoll_event event = {};
+                event.events = EPOLLIN | EPOLLOUT;
+                event.data.u64 = next;
+                epoll_ctl(epoll, EPOLL_CTL_ADD, client.Fd, &event);
+            }
+
+            for (auto& client : clients)
+            {
+                if (client.State == Phase::Ending && now - client.Ended > std::chrono::seconds(m_options.TimeoutSeconds))
+                {
+                    fail(client);
+                    finished++;
+                }
+                if (client.State != Phase::Streaming)
+                {
+                    continue;
+                }
+                auto due = std::min<uint32_t>(totalFrames, static_cast<uint32_t>((now - client.Streaming) / frameMs) + 1);
+                for (; client.FramesSent < due; client.FramesSent++)
+                {
+                    queueFrame(client, 0x2, frame);
+                    result.FramesSent++;
+                }
+                if (client.FramesSent == totalFrames)
+                {
+                    queueFrame(client, 0x1, "end");
+                    client.State = Phase::Ending;
+                    client.Ended = now;
+                }
+                flush(client);
+                finished += client.State == Phase::Failed ? 1 : 0;
+            }
+
+            int count = epoll_wait(epoll, events, 256, 5);
+            for (int i = 0; i < count; i++)
+            {
+                auto& client = clients[events[i].data.u64];
+                if (client.State == Phase::Done || client.State == Phase::Failed)
+                {
+                    continue;
+                }
+                if (client.State == Phase::Connecting)
+                {
+                    int error = 0;
+                    socklen_t length = sizeof(error);
+                    getsockopt(client.Fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                    if (error != 0)
+                    {
+                        fail(client);
+                        finished++;
+                        continue;
+                    }
+                    epoll_event event = {};
+                    event.events = EPOLLIN;
+                    event.data.u64 = events[i].data.u64;
+                    epoll_ctl(epoll, EPOLL_CTL_MOD, client.Fd, &event);
+                    client.State = Phase::Handshake;
+                    client.Output = request;
+                    flush(client);
+                    continue;
+                }
+                if ((events[i].events & EPOLLIN) == 0)
+                {
+                    continue;
+                }
+
+                uint8_t buffer[4096];
+                auto received = recv(client.Fd, buffer, sizeof(buffer), 0);
+                if (received <= 0)
+                {
+                    if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                    {
+                        fail(client);
+                        finished++;
+                    }
+                    continue;
+                }
+                client.Input.insert(client.Input.end(), buffer, buffer + received);
+
+                if (client.State == Phase::Handshake)
+                {
+                    std::string response(client.Input.begin(), client.Input.end());
+                    auto end = response.find("\r\n\r\n");
+                    if (end == std::string::npos)
+                    {
+                        continue;
+                    }
+                    if (response.compare(0, 12, "HTTP/1.1 101") != 0 || response.find(expectedAccept) == std::string::npos)
+                    {
+                        fail(client);
+                        finished++;
+                        continue;
+                    }
+                    client.Input.erase(client.Input.begin(), client.Input.begin() + end + 4);
+                    client.State = Phase::Streaming;
+                    client.Streaming = Clock::now();
+                    handshakeMs.push_back(std::chrono::duration<double, std::milli>(client.Streaming - client.Connected).count());
+                }
+
+                // Server frames are not masked, and results are shorter than 64 KB.
+                size_t offset = 0;
+                while (client.Input.size() - offset >= 2)
+                {
+                    const auto* data = client.Input.data() + offset;
+                    size_t length = data[1] & 0x7f;
+                    size_t headerSize = 2;
+                    if (length == 126)
+                    {
+                        if (client.Input.size() - offset < 4)
+                        {
+                            break;
+                        }
+                        length = static_cast<size_t>(data[2]) << 8 | data[3];
+                        headerSize = 4;
+                    }
+                    if (client.Input.size() - offset < headerSize + length)
+                    {
+                        break;
+                    }
+                    offset += headerSize + length;
+                    if ((data[0] & 0x0f) == 0x2 && length >= 9)
+                    {
+                        result.ResultFrames++;
+                        if (data[headerSize] == static_cast<uint8_t>(WebSocketGateway::ResultType::Done))
+                        {
+                            turnaroundMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - client.Ended).count());
+                            client.State = Phase::Done;
+                            result.Completed++;
+                            finished++;
+                            close(client.Fd);
+                            client.Fd = -1;
+                            break;
+                        }
+                    }
+                }
+                if (client.Fd >= 0)
+                {
+                    client.Input.erase(client.Input.begin(), client.Input.begin() + offset);
+                }
+            }
+        }
+        close(epoll);
+
+        auto summarize = [](std::vector<double>& values, double& average, double& p95, double* max)
+        {
+            if (values.empty())
+            {
+                return;
+            }
+            std::sort(values.begin(), values.end());
+            double sum = 0;
+            for (auto value : values)
+            {
+                sum += value;
+            }
+            average = sum / values.size();
+            p95 = values[values.size() * 95 / 100];
+            if (max != nullptr)
+            {
+                *max = values.back();
+            }
+        };
+        summarize(handshakeMs, result.AverageHandshakeMs, result.P95HandshakeMs, nullptr);
+        summarize(turnaroundMs, result.AverageTurnaroundMs, result.P95TurnaroundMs, &result.MaxTurnaroundMs);
+        return result;
+    }
+
+private:
+    Options m_options;
+};
@@ -0,0 +1,339 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "wav_file_reader.h"
+
+// Fingerprint of the audio content of a recording, independent of how it is stored. The samples are normalized to
+// 16-bit mono, and digital silence (zero samples) at the start and end is left out, so the same recording gets the
+// same fingerprint whatever its wav header chunks, sample width or padding. The hash is not cryptographic; it is
+// meant to find duplicates among a pipeline's own recordings, not to resist crafted collisions.
+struct AudioFingerprint
+{
+    uint64_t Hash[2] = {};
+    uint32_t SamplesPerSecond = 0;
+    uint64_t SampleCount = 0;       // From the first to the last non-silent sample.
+    uint64_t LeadingSamples = 0;    // Silent samples before the first non-silent one, not part of the key.
+
+    bool operator<(const AudioFingerprint& other) const
+    {
+        return std::tie(Hash[0], Hash[1], SamplesPerSecond, SampleCount) <
+            std::tie(other.Hash[0], other.Hash[1], other.SamplesPerSecond, other.SampleCount);
+    }
+
+    double GetSeconds() const
+    {
+        return SamplesPerSecond > 0 ? static_cast<double>(SampleCount) / SamplesPerSecond : 0;
+    }
+
+    // Gets the duration of the leading silence in ticks of 100 ns, the unit of result offsets.
+    uint64_t GetLeadingTicks() const
+    {
+        return SamplesPerSecond > 0 ? LeadingSamples * 10000000 / SamplesPerSecond : 0;
+    }
+};
+
+// Computes the fingerprint of normalized samples, added one at a time.
+class AudioFingerprinter final
+{
+public:
+    explicit AudioFingerprinter(uint32_t samplesPerSecond)
+    {
+        m_fingerprint.SamplesPerSecond = samplesPerSecond;
+    }
+
+    void Add(int16_t sample)
+    {
+        if (sample == 0)
+        {
+            // Silence is only hashed once a non-silent sample follows it.
+            (m_started ? m_pendingSilence : m_fingerprint.LeadingSamples)++;
+            return;
+        }
+
+        for (; m_pendingSilence > 0; m_pendingSilence--)
+        {
+            Hash(0);
+        }
+        m_started = true;
+        Hash(sample);
+    }
+
+    AudioFingerprint Finish() const
+    {
+        // The sample count is mixed in, so that recordings differing only in length cannot collide.
+        auto fingerprint = m_fingerprint;
+        fingerprint.Hash[0] = Mix(m_lanes[0] ^ fingerprint.SampleCount);
+        fingerprint.Hash[1] = Mix(m_lanes[1] ^ Mix(fingerprint.SampleCount + fingerprint.SamplesPerSecond));
+        return fingerprint;
+    }
+
+    // Computes the fingerprint of the audio data of a wav file, in 8, 16, 24 or 32-bit integer or 32-bit float PCM.
+    static AudioFingerprint FromWavFile(const std::string& fileName)
+    {
+        WavFileReader reader(fileName);
+        auto formatTag = reader.GetFormatTag();
+        auto channels = reader.GetChannels();
+        auto bytesPerSample = reader.GetBitsPerSample() / 8;
+        bool isFloat = formatTag == 3;
+        if ((formatTag != 1 && !(isFloat && bytesPerSample == 4)) ||
+            channels == 0 || bytesPerSample == 0 || bytesPerSample > 4)
+        {
+            throw std::invalid_argument("Unsupported audio format, only PCM wav files are fingerprinted.");
+        }
+
+        AudioFingerprinter fingerprinter(reader.GetSamplesPerSecond());
+        size_t frameSize = channels * bytesPerSample;
+        std::vector<uint8_t> buffer(frameSize * 4096);
+        size_t buffered = 0;
+        uint64_t remaining = reader.GetDataSize();
+        while (remaining > 0)
+        {
+            auto count = reader.Read(buffer.data() + buffered, static_cast<uint32_t>(std::min<uint64_t>(buffer.size() - buffered, remaining)));
+            if (count <= 0)
+            {
+                break;
+            }
+            remaining -= static_cast<uint64_t>(count);
+            buffered += static_cast<size_t>(count);
+
+            // A frame may be split between two reads; the incomplete part is kept for the next one.
+            size_t frames = buffered / frameSize;
+            for (size_t frame = 0; frame < frames; frame++)
+            {
+                int64_t sum = 0;
+                for (size_t channel = 0; channel < channels; channel++)
+                {
+                    sum += ToInt16(buffer.data() + frame * frameSize + channel * bytesPerSample, bytesPerSample, isFloat);
+                }
+                fingerprinter.Add(static_cast<int16_t>(sum / static_cast<int64_t>(channels)));
+            }
+            memmove(buffer.data(), buffer.data() + frames * frameSize, buffered - frames * frameSize);
+            buffered -= frames * frameSize;
+        }
+        reader.Close();
+        return fingerprinter.Finish();
+    }
+
+private:
+    static int16_t ToInt16(const uint8_t* sample, size_t bytesPerSample, bool isFloat)
+    {
+        uint32_t bits = 0;
+        for (size_t i = 0; i < bytesPerSample; i++)
+        {
+            bits |= static_cast<uint32_t>(sample[i]) << (8 * i);
+        }
+
+        if (isFloat)
+        {
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            return static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, value * 32768.0f)));
+        }
+        if (bytesPerSample == 1)
+        {
+            // 8-bit samples are unsigned.
+            return static_cast<int16_t>((static_cast<int>(bits) - 128) * 256);
+        }
+        // The most significant 16 bits of the sample.
+        return static_cast<int16_t>(static_cast<uint16_t>(bits >> (8 * bytesPerSample - 16)));
+    }
+
+    void Hash(int16_t sample)
+    {
+        auto value = static_cast<uint16_t>(sample);
+        m_lanes[0] = (m_lanes[0] ^ value) * 0x100000001B3ull;
+        m_lanes[1] = (m_lanes[1] ^ value) * 0x9E3779B97F4A7C15ull + 0x632BE59BD9B4E019ull;
+        m_fingerprint.SampleCount++;
+    }
+
+    // Final mixing, from splitmix64, so that each bit of the lanes affects all bits of the hash.
+    static uint64_t Mix(uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    AudioFingerprint m_fingerprint;
+    uint64_t m_lanes[2] = { 0xCBF29CE484222325ull, 0x84222325CBF29CE4ull };
+    uint64_t m_pendingSilence = 0;
+    bool m_started = false;
+};
+
+// Cache of recognition results by audio fingerprint, so that a recording received again, e.g. a retry, a forwarded
+// voicemail or a re-upload, is answered without being recognized again. Phrase offsets are kept relative to the
+// first non-silent sample and moved by the leading silence of each duplicate. The cache can be used from several
+// threads at once, and saved to a file to be shared between runs.
+class RecognitionResultCache final
+{
+public:
+    struct Phrase
+    {
+        uint64_t Offset = 0;      // In ticks of 100 ns, from the start of the recording.
+        uint64_t Duration = 0;    // In ticks of 100 ns.
+        std::string Text;
+    };
+
+    // Gets the phrases recognized in a recording with the same fingerprint, if any.
+    bool TryGet(const AudioFingerprint& fingerprint, std::vector<Phrase>& phrases)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto entry = m_entries.find(fingerprint);
+        if (entry == m_entries.end())
+        {
+            m_missCount++;
+            return false;
+        }
+
+        phrases = entry->second;
+        for (auto& phrase : phrases)
+        {
+            phrase.Offset += fingerprint.GetLeadingTicks();
+        }
+        m_hitCount++;
+        m_savedAudioSeconds += static_cast<double>(fingerprint.LeadingSamples + fingerprint.SampleCount) / fingerprint.SamplesPerSecond;
+        return true;
+    }
+
+    // Adds the phrases recognized in a recording, with offsets from the start of the recording.
+    void Add(const AudioFingerprint& fingerprint, std::vector<Phrase> phrases)
+    {
+        for (auto& phrase : phrases)
+        {
+            phrase.Offset -= std::min(phrase.Offset, fingerprint.GetLeadingTicks());
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries[fingerprint] = std::move(phrases);
+    }
+
+    // Loads the entries saved with Save(). Returns false if the file does not exist.
+    bool Load(const std::string& fileName)
+    {
+        std::ifstream fs(fileName, std::ios_base::binary | std::ios_base::in);
+        if (!fs.good())
+        {
+            return false;
+        }
+
+        uint32_t header[3] = {};
+        fs.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!fs.good() || header[0] != magic || header[1] != version)
+        {
+            throw std::runtime_error("Invalid recognition cache file header.");
+        }
+
+        std::map<AudioFingerprint, std::vector<Phrase>> entries;
+        for (uint32_t i = 0; i < header[2] && fs.good(); i++)
+        {
+            AudioFingerprint fingerprint;
+            uint32_t phraseCount = 0;
+            fs.read(reinterpret_cast<char*>(fingerprint.Hash), sizeof(fingerprint.Hash));
+            fs.read(reinterpret_cast<char*>(&fingerprint.SamplesPerSecond), sizeof(fingerprint.SamplesPerSecond));
+            fs.read(reinterpret_cast<char*>(&fingerprint.SampleCount), sizeof(fingerprint.SampleCount));
+            fs.read(reinterpret_cast<char*>(&phraseCount), sizeof(phraseCount));
+
+            auto& phrases = entries[fingerprint];
+            phrases.resize(fs.good() ? phraseCount : 0);
+            for (auto& phrase : phrases)
+            {
+                uint32_t textSize = 0;
+                fs.read(reinterpret_cast<char*>(&phrase.Offset), sizeof(phrase.Offset));
+                fs.read(reinterpret_cast<char*>(&phrase.Duration), sizeof(phrase.Duration));
+                fs.read(reinterpret_cast<char*>(&textSize), sizeof(textSize));
+                phrase.Text.resize(fs.good() ? textSize : 0);
+                fs.read(&phrase.Text[0], phrase.Text.size());
+            }
+        }
+        if (!fs.good())
+        {
+            throw std::runtime_error("Unexpected end of file or error when reading recognition cache file.");
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.insert(entries.begin(), entries.end());
+        return true;
+    }
+
+    void Save(const std::string& fileName) const
+    {
+        std::ofstream fs(fileName, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+        if (!fs.good())
+        {
+            throw std::invalid_argument("Failed to open the specified recognition cache file.");
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint32_t header[3] = { magic, version, static_cast<uint32_t>(m_entries.size()) };
+        fs.write(reinterpret_cast<const char*>(header), sizeof(header));
+        for (const auto& entry : m_entries)
+        {
+            uint32_t phraseCount = static_cast<uint32_t>(entry.second.size());
+            fs.write(reinterpret_cast<const char*>(entry.first.Hash), sizeof(entry.first.Hash));
+            fs.write(reinterpret_cast<const char*>(&entry.first.SamplesPerSecond), sizeof(entry.first.SamplesPerSecond));
+            fs.write(reinterpret_cast<const char*>(&entry.first.SampleCount), sizeof(entry.first.SampleCount));
+            fs.write(reinterpret_cast<const char*>(&phraseCount), sizeof(phraseCount));
+            for (const auto& phrase : entry.second)
+            {
+                uint32_t textSize = static_cast<uint32_t>(phrase.Text.size());
+                fs.write(reinterpret_cast<const char*>(&phrase.Offset), sizeof(phrase.Offset));
+                fs.write(reinterpret_cast<const char*>(&phrase.Duration), sizeof(phrase.Duration));
+                fs.write(reinterpret_cast<const char*>(&textSize), sizeof(textSize));
+                fs.write(phrase.Text.data(), phrase.Text.size());
+            }
+        }
+        fs.close();
+        if (!fs.good())
+        {
+            throw std::runtime_error("Error when writing recognition cache file.");
+        }
+    }
+
+    size_t Size() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+    // Gets the number of lookups answered from the cache and not, and the audio not recognized again thanks to it.
+    uint64_t GetHitCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_hitCount;
+    }
+
+    uint64_t GetMissCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_missCount;
+    }
+
+    double GetSavedAudioSeconds() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_savedAudioSeconds;
+    }
+
+private:
+    // The file starts with the tag 'AFPC', in the byte order of the machine that wrote it.
+    static constexpr uint32_t magic = 0x43504641;
+    static constexpr uint32_t version = 1;
+
+    mutable std::mutex m_mutex;
+    std::map<AudioFingerprint, std::vector<Phrase>> m_entries;
+    uint64_t m_hitCount = 0;
+    uint64_t m_missCount = 0;
+    double m_savedAudioSeconds = 0;
+};
@@ -0,0 +1,222 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Synthesizes many short texts with few requests.
+// Consecutive texts are packed into one SSML document, synthesized once, and the audio is split
+// back into one clip per text at the audio offset of the first word of each text, as reported by
+// the WordBoundary event. The number of texts per request adapts to the given latency target.
+class BatchSynthesizer final
+{
+public:
+    // Statistics about the requests sent so far.
+    struct Statistics
+    {
+        uint32_t Requests = 0;
+        uint32_t Texts = 0;
+        double TotalLatencyMs = 0;
+        double MaxLatencyMs = 0;
+    };
+
+    // Constructor that creates a synthesizer from the given config.
+    // The config is switched to raw PCM output so that clips can be cut at any sample.
+    BatchSynthesizer(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config,
+                     const std::string& voiceName,
+                     double latencyTargetMs,
+                     size_t maxBatchSize = 64)
+        : m_voiceName(voiceName),
+          m_latencyTargetMs(latencyTargetMs),
+          m_maxBatchSize(std::max<size_t>(maxBatchSize, 1)),
+          m_batchSize(initialBatchSize < m_maxBatchSize ? initialBatchSize : m_maxBatchSize)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        config->SetSpeechSynthesisOutputFormat(SpeechSynthesisOutputFormat::Raw16Khz16BitMonoPcm);
+        m_synthesizer = SpeechSynthesizer::FromConfig(config, nullptr);
+
+        m_synthesizer->WordBoundary += [this](const SpeechSynthesisWordBoundaryEventArgs& e)
+        {
+            std::lock_guard<std::mutex> lock(m_boundariesMutex);
+            m_boundaries.push_back({ e.TextOffset, e.AudioOffset });
+        };
+    }
+
+    ~BatchSynthesizer()
+    {
+        m_synthesizer->WordBoundary.DisconnectAll();
+    }
+
+    // Synthesizes all texts and returns one PCM clip (16 kHz, 16 bits, mono) per text, in input order.
+    // Throws std::runtime_error if a request is canceled.
+    std::vector<std::vector<uint8_t>> Synthesize(const std::vector<std::string>& texts)
+    {
+        std::vector<std::vector<uint8_t>> clips;
+        clips.reserve(texts.size());
+
+        size_t next = 0;
+        while (next < texts.size())
+        {
+            auto count = std::min(m_batchSize, texts.size() - next);
+            auto start = std::chrono::steady_clock::now();
+            SynthesizeBatch(texts, next, count, clips);
+            auto latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            m_statistics.Requests++;
+            m_statistics.Texts += (uint32_t)count;
+            m_statistics.TotalLatencyMs += latencyMs;
+            m_statistics.MaxLatencyMs = std::max(m_statistics.MaxLatencyMs, latencyMs);
+
+            AdaptBatchSize(count, latencyMs);
+            next += count;
+        }
+
+        return clips;
+    }
+
+    // Gets the number of texts that will be packed into the next request.
+    size_t GetBatchSize() const
+    {
+        return m_batchSize;
+    }
+
+    // Gets the statistics about the requests sent so far.
+    const Statistics& GetStatistics() const
+    {
+        return m_statistics;
+    }
+
+private:
+    static constexpr size_t initialBatchSize = 8;
+    static constexpr uint32_t bytesPerSecond = 16000 * 2;
+    static constexpr uint32_t ticksPerSecond = 10000000;
+
+    struct WordBoundary
+    {
+        uint32_t TextOffset;
+        uint64_t AudioOffset;
+    };
+
+    void SynthesizeBatch(const std::vector<std::string>& texts, size_t first, size_t count, std::vector<std::vector<uint8_t>>& clips)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+
+        // Builds the SSML document, remembering the text offset at which each text starts.
+        // The offsets are counted in characters, like the TextOffset of the WordBoundary event.
+        std::string ssml = "<speak version='1.0' xmlns='http://www.w3.org/2001/10/synthesis' xml:lang='en-US'><voice name='" + m_voiceName + "'>";
+        std::vector<uint32_t> textOffsets;
+        textOffsets.reserve(count);
+        size_t counted = 0;
+        uint32_t characters = 0;
+        for (size_t i = first; i < first + count; i++)
+        {
+            if (i != first)
+            {
+                // A short pause keeps the end of a text out of the next clip.
+                ssml += "<break time='100ms'/>";
+            }
+            characters += CountCharacters(ssml, counted);
+            counted = ssml.size();
+            textOffsets.push_back(characters);
+            AppendEscaped(ssml, texts[i]);
+        }
+        ssml += "</voice></speak>";
+
+        {
+            std::lock_guard<std::mutex> lock(m_boundariesMutex);
+            m_boundaries.clear();
+        }
+
+        auto result = m_synthesizer->SpeakSsmlAsync(ssml).get();
+        if (result->Reason != ResultReason::SynthesizingAudioCompleted)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+            throw std::runtime_error("Batch synthesis canceled: " + cancellation->ErrorDetails);
+        }
+
+        auto audio = result->GetAudioData();
+
+        std::vector<WordBoundary> boundaries;
+        {
+            std::lock_guard<std::mutex> lock(m_boundariesMutex);
+            boundaries.swap(m_boundaries);
+        }
+
+        // Each clip starts at the first word of its text. Texts without any word keep an empty clip.
+        std::vector<size_t> clipStarts(count + 1, audio->size());
+        clipStarts[0] = 0;
+        for (size_t i = 1; i < count; i++)
+        {
+            auto boundary = std::find_if(boundaries.begin(), boundaries.end(),
+                [&](const WordBoundary& b) { return b.TextOffset >= textOffsets[i]; });
+            clipStarts[i] = boundary == boundaries.end() ? audio->size() : TicksToByteOffset(boundary->AudioOffset, audio->size());
+            clipStarts[i] = std::max(clipStarts[i], clipStarts[i - 1]);
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            clips.emplace_back(audio->begin() + clipStarts[i], audio->begin() + clipStarts[i + 1]);
+        }
+    }
+
+    // Grows the batch while the latency stays well below the target and halves it when the target is missed.
+    void AdaptBatchSize(size_t count, double latencyMs)
+    {
+        if (latencyMs > m_latencyTargetMs)
+        {
+            m_batchSize = std::max<size_t>(count / 2, 1);
+        }
+        else if (latencyMs < m_latencyTargetMs * 0.7 && count == m_batchSize)
+        {
+            m_batchSize = std::min(m_batchSize + std::max<size_t>(m_batchSize / 4, 1), m_maxBatchSize);
+        }
+    }
+
+    static size_t TicksToByteOffset(uint64_t ticks, size_t audioSize)
+    {
+        // Rounds down to a sample boundary (2 bytes per sample).
+        auto offset = (size_t)(ticks * bytesPerSecond / ticksPerSecond) & ~(size_t)1;
+        return std::min(offset, audioSize);
+    }
+
+    static uint32_t CountCharacters(const std::string& utf8, size_t from)
+    {
+        // Counts UTF-8 lead bytes only, so multi-byte characters count once.
+        return (uint32_t)std::count_if(utf8.begin() + from, utf8.end(), [](char c) { return ((unsigned char)c & 0xC0) != 0x80; });
+    }
+
+    static void AppendEscaped(std::string& ssml, const std::string& text)
+    {
+        for (auto c : text)
+        {
+            switch (c)
+            {
+            case '&': ssml += "&amp;"; break;
+            case '<': ssml += "&lt;"; break;
+            case '>': ssml += "&gt;"; break;
+            case '\'': ssml += "&apos;"; break;
+            case '"': ssml += "&quot;"; break;
+            default: ssml += c; break;
+            }
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechSynthesizer> m_synthesizer;
+    std::string m_voiceName;
+    double m_latencyTargetMs;
+    size_t m_maxBatchSize;
+    size_t m_batchSize;
+    Statistics m_statistics;
+
+    std::mutex m_boundariesMutex;
+    std::vector<WordBoundary> m_boundaries;
+};
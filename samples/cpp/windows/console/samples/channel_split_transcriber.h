@@ -0,0 +1,189 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "wav_file_reader.h"
+
+// Transcribes a multichannel recording with one speaker per channel, e.g. a call with the agent on the left channel
+// and the customer on the right, into one transcript attributed to the speakers. The file is read once; each block
+// is split into its channels, which are written to push streams recognized at the same time, one recognizer each.
+// The phrases of all channels are then merged in order of offset, all channels sharing the timeline of the file.
+class ChannelSplitTranscriber final
+{
+public:
+    struct Phrase
+    {
+        size_t Channel = 0;
+        std::string Speaker;
+        uint64_t Offset = 0;        // In ticks of 100 ns.
+        uint64_t Duration = 0;      // In ticks of 100 ns.
+        std::string Text;
+    };
+
+    struct Transcript
+    {
+        std::vector<Phrase> Phrases;        // In order of offset.
+        std::vector<std::string> Errors;    // Per channel, empty if the channel was recognized.
+        double AudioSeconds = 0;
+    };
+
+    // Constructor taking the speaker of each channel, in channel order.
+    ChannelSplitTranscriber(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, const std::vector<std::string>& speakers)
+        : m_config(config),
+          m_speakers(speakers)
+    {
+    }
+
+    // Transcribes a 16-bit PCM wav file with as many channels as speakers.
+    Transcript Transcribe(const std::string& fileName) const
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        WavFileReader reader(fileName);
+        auto channels = static_cast<size_t>(reader.GetChannels());
+        if (reader.GetFormatTag() != 1 || reader.GetBitsPerSample() != 16 || channels != m_speakers.size())
+        {
+            throw std::invalid_argument("Unsupported audio format, a 16-bit PCM wav file with one channel per speaker is expected.");
+        }
+
+        Transcript transcript;
+        transcript.Errors.resize(channels);
+        transcript.AudioSeconds = static_cast<double>(reader.GetDataSize()) / (2.0 * channels * reader.GetSamplesPerSecond());
+
+        std::vector<std::shared_ptr<PushAudioInputStream>> streams;
+        std::vector<std::shared_ptr<SpeechRecognizer>> recognizers;
+        std::vector<std::vector<Phrase>> phrases(channels);
+        std::vector<std::promise<void>> recognitionEnds(channels);
+        auto format = AudioStreamFormat::GetWaveFormatPCM(reader.GetSamplesPerSecond(), 16, 1);
+        for (size_t channel = 0; channel < channels; channel++)
+        {
+            streams.push_back(AudioInputStream::CreatePushStream(format));
+            auto recognizer = SpeechRecognizer::FromConfig(m_config, AudioConfig::FromStreamInput(streams.back()));
+
+            // Each recognizer raises its events one at a time, and has a list of phrases of its own.
+            auto& channelPhrases = phrases[channel];
+            const auto& speaker = m_speakers[channel];
+            recognizer->Recognized.Connect([&channelPhrases, &speaker, channel](const SpeechRecognitionEventArgs& e)
+            {
+                if (e.Result->Reason == ResultReason::RecognizedSpeech && !e.Result->Text.empty())
+                {
+                    Phrase phrase;
+                    phrase.Channel = channel;
+                    phrase.Speaker = speaker;
+                    phrase.Offset = e.Result->Offset();
+                    phrase.Duration = e.Result->Duration();
+                    phrase.Text = e.Result->Text;
+                    channelPhrases.push_back(phrase);
+                }
+            });
+            auto& error = transcript.Errors[channel];
+            recognizer->Canceled.Connect([&error](const SpeechRecognitionCanceledEventArgs& e)
+            {
+                if (e.Reason == CancellationReason::Error)
+                {
+                    error = e.ErrorDetails;
+                }
+            });
+            auto& recognitionEnd = recognitionEnds[channel];
+            recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs&)
+            {
+                recognitionEnd.set_value();
+            });
+            recognizers.push_back(recognizer);
+        }
+
+        // Starts all recognizers at once, then waits for them to be started.
+        std::vector<std::future<void>> starts;
+        for (auto& recognizer : recognizers)
+        {
+            starts.push_back(recognizer->StartContinuousRecognitionAsync());
+        }
+        for (auto& start : starts)
+        {
+            start.get();
+        }
+
+        // Reads 100 ms of every channel at a time, up to the end of the data chunk.
+        auto frameBytes = static_cast<uint32_t>(2 * channels);
+        auto framesPerBlock = std::max<uint32_t>(reader.GetSamplesPerSecond() / 10, 1);
+        std::vector<int16_t> block(framesPerBlock * channels);
+        std::vector<std::vector<int16_t>> channelBlocks(channels, std::vector<int16_t>(framesPerBlock));
+        for (uint64_t remaining = reader.GetDataSize(); remaining >= frameBytes;)
+        {
+            auto size = static_cast<uint32_t>(std::min<uint64_t>(remaining, static_cast<uint64_t>(framesPerBlock) * frameBytes));
+            size -= size % frameBytes;
+            auto read = reader.Read(reinterpret_cast<uint8_t*>(block.data()), size);
+            auto frames = read > 0 ? static_cast<size_t>(read) / frameBytes : 0;
+            if (frames == 0)
+            {
+                break;
+            }
+            Deinterleave(block.data(), frames, channelBlocks);
+            for (size_t channel = 0; channel < channels; channel++)
+            {
+                streams[channel]->Write(reinterpret_cast<uint8_t*>(channelBlocks[channel].data()), static_cast<uint32_t>(frames * 2));
+            }
+            remaining -= frames * frameBytes;
+        }
+        reader.Close();
+
+        for (auto& stream : streams)
+        {
+            stream->Close();
+        }
+        for (size_t channel = 0; channel < channels; channel++)
+        {
+            recognitionEnds[channel].get_future().get();
+            recognizers[channel]->StopContinuousRecognitionAsync().get();
+        }
+
+        for (auto& channelPhrases : phrases)
+        {
+            transcript.Phrases.insert(transcript.Phrases.end(), channelPhrases.begin(), channelPhrases.end());
+        }
+        std::stable_sort(transcript.Phrases.begin(), transcript.Phrases.end(),
+            [](const Phrase& a, const Phrase& b) { return a.Offset < b.Offset; });
+        return transcript;
+    }
+
+private:
+    // Splits interleaved frames into one block of samples per channel.
+    static void Deinterleave(const int16_t* samples, size_t frames, std::vector<std::vector<int16_t>>& channelBlocks)
+    {
+        auto channels = channelBlocks.size();
+        if (channels == 2)
+        {
+            auto* left = channelBlocks[0].data();
+            auto* right = channelBlocks[1].data();
+            for (size_t i = 0; i < frames; i++)
+            {
+                left[i] = samples[2 * i];
+                right[i] = samples[2 * i + 1];
+            }
+            return;
+        }
+
+        for (size_t channel = 0; channel < channels; channel++)
+        {
+            auto* output = channelBlocks[channel].data();
+            for (size_t i = 0; i < frames; i++)
+            {
+                output[i] = samples[i * channels + channel];
+            }
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    std::vector<std::string> m_speakers;
+};
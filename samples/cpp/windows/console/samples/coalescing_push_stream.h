@@ -0,0 +1,214 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Adapter that batches small writes, e.g. one 20 ms network frame of 640 bytes at a time, into larger writes to a
+// push audio input stream. Every PushAudioInputStream::Write() crosses into the native library and takes its locks,
+// so fewer, larger writes cost less; the price is the time audio waits in the adapter, which is bounded.
+// Audio is written to the stream when a block is full, when it has waited the maximum added latency, and at the
+// first frame of silence after speech, so that the end of an utterance is not held back from the recognizer.
+class CoalescingPushStream final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        uint32_t BlockBytes = 1920;         // Size of the writes to the stream, three 20 ms frames of 16 kHz 16-bit mono audio.
+        uint32_t MaxLatencyMs = 100;        // Longest time audio waits in the adapter.
+        int16_t SilenceThreshold = 300;     // Peak amplitude of 16-bit PCM frames taken as silence, 0 to disable.
+    };
+
+    struct Statistics
+    {
+        uint64_t Writes = 0;                // Calls to Write().
+        uint64_t StreamWrites = 0;          // Calls to PushAudioInputStream::Write().
+        uint64_t Bytes = 0;
+        uint64_t FullBlockFlushes = 0;
+        uint64_t SilenceFlushes = 0;
+        uint64_t TimeoutFlushes = 0;
+        double StreamWriteMs = 0;           // Time spent in PushAudioInputStream::Write().
+        double AverageAddedLatencyMs = 0;   // Time from Write() to the stream, averaged over writes.
+        double MaxAddedLatencyMs = 0;
+    };
+
+    CoalescingPushStream(std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> stream, const Options& options)
+        : m_stream(stream),
+          m_options(options)
+    {
+        m_buffer.reserve(m_options.BlockBytes);
+        m_timer = std::thread([this]() { RunTimer(); });
+    }
+
+    // Writes the audio still buffered and closes the stream.
+    ~CoalescingPushStream()
+    {
+        Close();
+    }
+
+    CoalescingPushStream(const CoalescingPushStream&) = delete;
+    CoalescingPushStream& operator=(const CoalescingPushStream&) = delete;
+
+    // Buffers a frame of audio, and writes the buffer to the stream if it is full or the frame ends speech.
+    void Write(const uint8_t* data, uint32_t size)
+    {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_closed)
+        {
+            return;
+        }
+
+        if (m_buffer.empty())
+        {
+            m_oldest = now;
+            m_timerChanged.notify_one();
+        }
+        m_buffer.insert(m_buffer.end(), data, data + size);
+        m_pendingWrites++;
+        m_pendingArrivalMs += ToMs(now);
+        m_statistics.Writes++;
+        m_statistics.Bytes += size;
+
+        bool silent = IsSilent(data, size);
+        if (m_buffer.size() >= m_options.BlockBytes)
+        {
+            m_statistics.FullBlockFlushes++;
+            FlushLocked(now);
+        }
+        else if (silent && m_inSpeech)
+        {
+            m_statistics.SilenceFlushes++;
+            FlushLocked(now);
+        }
+        m_inSpeech = !silent;
+    }
+
+    // Writes the buffered audio to the stream.
+    void Flush()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        FlushLocked(Clock::now());
+    }
+
+    // Writes the buffered audio and closes the stream. Later writes are dropped.
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closed)
+            {
+                return;
+            }
+            FlushLocked(Clock::now());
+            m_closed = true;
+            m_stream->Close();
+        }
+        m_timerChanged.notify_one();
+        m_timer.join();
+    }
+
+    Statistics GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto statistics = m_statistics;
+        statistics.AverageAddedLatencyMs = m_flushedWrites > 0 ? m_addedLatencyMs / m_flushedWrites : 0;
+        return statistics;
+    }
+
+private:
+    static double ToMs(Clock::time_point time)
+    {
+        return std::chrono::duration<double, std::milli>(time.time_since_epoch()).count();
+    }
+
+    // Flushes the buffer once the oldest audio in it has waited the maximum added latency, in case no write
+    // comes to flush it, e.g. when the network stalls.
+    void RunTimer()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_closed)
+        {
+            if (m_buffer.empty())
+            {
+                m_timerChanged.wait(lock);
+                continue;
+            }
+
+            auto deadline = m_oldest + std::chrono::milliseconds(m_options.MaxLatencyMs);
+            if (Clock::now() >= deadline)
+            {
+                m_statistics.TimeoutFlushes++;
+                FlushLocked(Clock::now());
+            }
+            else
+            {
+                m_timerChanged.wait_until(lock, deadline);
+            }
+        }
+    }
+
+    bool IsSilent(const uint8_t* data, uint32_t size) const
+    {
+        if (m_options.SilenceThreshold <= 0)
+        {
+            return false;
+        }
+
+        // Little-endian 16-bit samples, read bytewise since frames need not be aligned.
+        int peak = 0;
+        for (uint32_t i = 0; i + 1 < size; i += 2)
+        {
+            auto sample = static_cast<int16_t>(data[i] | data[i + 1] << 8);
+            peak = std::max(peak, sample < 0 ? -static_cast<int>(sample) : static_cast<int>(sample));
+        }
+        return peak < m_options.SilenceThreshold;
+    }
+
+    void FlushLocked(Clock::time_point now)
+    {
+        if (m_buffer.empty())
+        {
+            return;
+        }
+
+        m_addedLatencyMs += m_pendingWrites * ToMs(now) - m_pendingArrivalMs;
+        m_flushedWrites += m_pendingWrites;
+        m_statistics.MaxAddedLatencyMs = std::max(m_statistics.MaxAddedLatencyMs, std::chrono::duration<double, std::milli>(now - m_oldest).count());
+        m_pendingWrites = 0;
+        m_pendingArrivalMs = 0;
+
+        auto start = Clock::now();
+        m_stream->Write(m_buffer.data(), static_cast<uint32_t>(m_buffer.size()));
+        m_statistics.StreamWriteMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        m_statistics.StreamWrites++;
+        m_buffer.clear();
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> m_stream;
+    Options m_options;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_timerChanged;
+    std::thread m_timer;
+    std::vector<uint8_t> m_buffer;
+    Clock::time_point m_oldest;
+    uint64_t m_pendingWrites = 0;
+    double m_pendingArrivalMs = 0;      // Sum of the arrival times of the buffered writes.
+    uint64_t m_flushedWrites = 0;
+    double m_addedLatencyMs = 0;        // Sum of the added latencies of the flushed writes.
+    bool m_inSpeech = false;
+    bool m_closed = false;
+    Statistics m_statistics;
+};
@@ -0,0 +1,213 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "worker_pool.h"
+#include "zip_dataset_reader.h"
+
+// Replays the audio of a Custom Speech dataset through speech recognition, several sessions at a time.
+// The audio of each item is inflated from the archive and written to a push stream at a multiple of real time,
+// as a live source would write it, so the measured latencies are those a client would see. The endpoint is
+// whatever the speech config points to, e.g. the service or a container running on this machine.
+class EvaluationHarness final
+{
+public:
+    struct Options
+    {
+        size_t MaxSessions = 8;     // Recognition sessions running at the same time.
+        double Speed = 1.0;         // Multiple of real time the audio is written at, 0 for as fast as possible.
+        uint32_t ChunkMs = 100;     // Duration of the audio written at once.
+        size_t Repetitions = 1;     // Times the dataset is replayed, for load testing.
+    };
+
+    struct UtteranceResult
+    {
+        std::string Name;
+        std::string Reference;
+        std::string Recognized;
+        double AudioSeconds = 0;
+        double WallSeconds = 0;                 // From the first audio written to the end of the session.
+        double FinalLatencyMs = 0;              // From the last audio written to the end of the session.
+        std::vector<double> PhraseLatenciesMs;  // From the end of each phrase's audio being written to its final result.
+        bool Failed = false;
+        std::string Error;
+
+        double RealTimeFactor() const
+        {
+            return AudioSeconds > 0 ? WallSeconds / AudioSeconds : 0;
+        }
+    };
+
+    EvaluationHarness(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, const Options& options)
+        : m_config(config),
+          m_options(options)
+    {
+    }
+
+    // Runs all items of the dataset, as many times as requested. Results are in the order of the items, repeated.
+    std::vector<UtteranceResult> Run(const CustomSpeechDataset& dataset)
+    {
+        const auto& items = dataset.GetItems();
+        std::vector<UtteranceResult> results(items.size() * m_options.Repetitions);
+        {
+            WorkerPool pool(m_options.MaxSessions);
+            for (size_t i = 0; i < results.size(); i++)
+            {
+                pool.Post([this, &dataset, &items, &results, i]()
+                {
+                    results[i] = RunUtterance(dataset, items[i % items.size()]);
+                });
+            }
+            pool.WaitIdle();
+        }
+        return results;
+    }
+
+    // Gets the value below which the given fraction of the values fall, e.g. 0.9 for the 90th percentile.
+    static double Percentile(std::vector<double> values, double fraction)
+    {
+        if (values.empty())
+        {
+            return 0;
+        }
+        auto index = static_cast<size_t>(fraction * (values.size() - 1) + 0.5);
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index];
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static double Milliseconds(Clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    UtteranceResult RunUtterance(const CustomSpeechDataset& dataset, const CustomSpeechDataset::Item& item)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        UtteranceResult result;
+        result.Name = item.Audio->Name;
+        result.Reference = item.Transcript;
+
+        try
+        {
+            auto audio = dataset.OpenAudio(item);
+            uint64_t blockAlign = audio->GetBitsPerSample() / 8 * audio->GetChannels();
+            uint64_t bytesPerSecond = audio->GetSamplesPerSecond() * blockAlign;
+            if (bytesPerSecond == 0)
+            {
+                throw std::runtime_error("Invalid audio format.");
+            }
+
+            // Cumulative bytes written and when, to find when the audio at the end of a phrase was sent.
+            std::mutex mutex;
+            std::vector<std::pair<uint64_t, Clock::time_point>> written;
+            std::promise<void> sessionStopped;
+
+            auto stream = AudioInputStream::CreatePushStream(
+                AudioStreamFormat::GetWaveFormatPCM(audio->GetSamplesPerSecond(), audio->GetBitsPerSample(), audio->GetChannels()));
+            auto recognizer = SpeechRecognizer::FromConfig(m_config, AudioConfig::FromStreamInput(stream));
+
+            recognizer->Recognized.Connect([&](const SpeechRecognitionEventArgs& e)
+            {
+                auto now = Clock::now();
+                if (e.Result->Reason != ResultReason::RecognizedSpeech)
+                {
+                    return;
+                }
+
+                // Offset and duration are in ticks of 100 ns.
+                auto endByte = (e.Result->Offset() + e.Result->Duration()) * bytesPerSecond / 10000000;
+                std::lock_guard<std::mutex> lock(mutex);
+                result.Recognized += (result.Recognized.empty() ? "" : " ") + e.Result->Text;
+                auto sent = std::lower_bound(written.begin(), written.end(), endByte,
+                    [](const std::pair<uint64_t, Clock::time_point>& chunk, uint64_t byte) { return chunk.first < byte; });
+                if (sent != written.end())
+                {
+                    result.PhraseLatenciesMs.push_back(Milliseconds(now - sent->second));
+                }
+            });
+
+            recognizer->Canceled.Connect([&](const SpeechRecognitionCanceledEventArgs& e)
+            {
+                if (e.Reason == CancellationReason::Error)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    result.Failed = true;
+                    result.Error = e.ErrorDetails;
+                }
+            });
+
+            recognizer->SessionStopped.Connect([&sessionStopped](const SessionEventArgs&)
+            {
+                sessionStopped.set_value();
+            });
+
+            recognizer->StartContinuousRecognitionAsync().get();
+
+            auto chunkBytes = std::max<uint64_t>(bytesPerSecond * m_options.ChunkMs / 1000 / blockAlign, 1) * blockAlign;
+            std::vector<uint8_t> chunk(static_cast<size_t>(chunkBytes));
+            uint64_t total = 0;
+            auto start = Clock::now();
+            while (true)
+            {
+                auto count = audio->Read(chunk.data(), static_cast<uint32_t>(chunk.size()));
+                if (count <= 0)
+                {
+                    break;
+                }
+
+                // Each chunk is written when the audio before it has played at the requested speed.
+                if (m_options.Speed > 0)
+                {
+                    std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(total / (bytesPerSecond * m_options.Speed))));
+                }
+                stream->Write(chunk.data(), static_cast<uint32_t>(count));
+                total += static_cast<uint64_t>(count);
+
+                std::lock_guard<std::mutex> lock(mutex);
+                written.emplace_back(total, Clock::now());
+            }
+            auto endOfAudio = Clock::now();
+            stream->Close();
+
+            sessionStopped.get_future().get();
+            auto end = Clock::now();
+            recognizer->StopContinuousRecognitionAsync().get();
+
+            result.AudioSeconds = static_cast<double>(total) / bytesPerSecond;
+            result.WallSeconds = Milliseconds(end - start) / 1000;
+            result.FinalLatencyMs = Milliseconds(end - endOfAudio);
+            if (audio->HasFailed())
+            {
+                result.Failed = true;
+                result.Error = "The audio could not be read completely from the archive.";
+            }
+        }
+        catch (const std::exception& e)
+        {
+            result.Failed = true;
+            result.Error = e.what();
+        }
+        return result;
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    Options m_options;
+};
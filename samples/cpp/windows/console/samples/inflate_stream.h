@@ -0,0 +1,376 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+// Streaming decoder for raw DEFLATE data (RFC 1951), the compression used by ZIP archives.
+// Compressed input is pulled from a source as needed and output is produced in pieces of the size the caller
+// asks for, so data of any size is decompressed with fixed memory: the input buffer and the 32 KB window that
+// back-references point into. Huffman codes are decoded canonically, bit by bit, which is far faster than audio
+// is consumed by recognition.
+class InflateStream final
+{
+public:
+    // Reads up to size bytes of compressed data into buffer. Returns the number of bytes read, 0 at the end.
+    using Source = std::function<size_t(uint8_t* buffer, size_t size)>;
+
+    explicit InflateStream(Source source)
+        : m_source(std::move(source)),
+          m_input(16 * 1024),
+          m_window(windowSize)
+    {
+    }
+
+    // Decompresses up to size bytes into buffer. Returns the number of bytes produced, 0 at the end of the data.
+    // Throws std::runtime_error if the data is malformed or ends early.
+    size_t Read(uint8_t* buffer, size_t size)
+    {
+        size_t produced = 0;
+        while (produced < size)
+        {
+            if (m_copyLength > 0)
+            {
+                while (m_copyLength > 0 && produced < size)
+                {
+                    Emit(m_window[(m_totalOut - m_copyDistance) & (windowSize - 1)], buffer, produced);
+                    m_copyLength--;
+                }
+                continue;
+            }
+
+            switch (m_state)
+            {
+            case State::Done:
+                return produced;
+
+            case State::BlockHeader:
+                ReadBlockHeader();
+                break;
+
+            case State::Stored:
+                if (m_storedRemaining == 0)
+                {
+                    m_state = State::BlockHeader;
+                }
+                else
+                {
+                    Emit(static_cast<uint8_t>(Bits(8)), buffer, produced);
+                    m_storedRemaining--;
+                }
+                break;
+
+            case State::Huffman:
+                DecodeSymbol(buffer, produced);
+                break;
+            }
+        }
+        return produced;
+    }
+
+    // Gets whether the end of the compressed data has been reached.
+    bool IsFinished() const
+    {
+        return m_state == State::Done && m_copyLength == 0;
+    }
+
+private:
+    static const size_t windowSize = 32768;
+    static const int maxBits = 15;
+
+    enum class State
+    {
+        BlockHeader,
+        Stored,
+        Huffman,
+        Done
+    };
+
+    // Canonical Huffman code: number of codes of each length, and symbols ordered by code.
+    struct Huffman
+    {
+        uint16_t Counts[maxBits + 1];
+        uint16_t Symbols[288];
+
+        void Build(const uint8_t* lengths, int count)
+        {
+            for (auto& c : Counts)
+            {
+                c = 0;
+            }
+            for (int symbol = 0; symbol < count; symbol++)
+            {
+                Counts[lengths[symbol]]++;
+            }
+
+            int left = 1;
+            for (int length = 1; length <= maxBits; length++)
+            {
+                left = (left << 1) - Counts[length];
+                if (left < 0)
+                {
+                    throw std::runtime_error("Invalid compressed data, over-subscribed Huffman code.");
+                }
+            }
+
+            uint16_t offsets[maxBits + 1];
+            offsets[1] = 0;
+            for (int length = 1; length < maxBits; length++)
+            {
+                offsets[length + 1] = offsets[length] + Counts[length];
+            }
+            for (int symbol = 0; symbol < count; symbol++)
+            {
+                if (lengths[symbol] != 0)
+                {
+                    Symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+                }
+            }
+        }
+    };
+
+    void Emit(uint8_t value, uint8_t* buffer, size_t& produced)
+    {
+        buffer[produced++] = value;
+        m_window[m_totalOut & (windowSize - 1)] = value;
+        m_totalOut++;
+    }
+
+    uint8_t NextByte()
+    {
+        if (m_inputPosition == m_inputSize)
+        {
+            m_inputSize = m_source(m_input.data(), m_input.size());
+            m_inputPosition = 0;
+            if (m_inputSize == 0)
+            {
+                throw std::runtime_error("Unexpected end of compressed data.");
+            }
+        }
+        return m_input[m_inputPosition++];
+    }
+
+    uint32_t Bits(int count)
+    {
+        while (m_bitCount < count)
+        {
+            m_bitBuffer |= static_cast<uint64_t>(NextByte()) << m_bitCount;
+            m_bitCount += 8;
+        }
+        auto value = static_cast<uint32_t>(m_bitBuffer & ((1ULL << count) - 1));
+        m_bitBuffer >>= count;
+        m_bitCount -= count;
+        return value;
+    }
+
+    int Decode(const Huffman& huffman)
+    {
+        int code = 0;
+        int first = 0;
+        int index = 0;
+        for (int length = 1; length <= maxBits; length++)
+        {
+            code |= static_cast<int>(Bits(1));
+            int count = huffman.Counts[length];
+            if (code - count < first)
+            {
+                return huffman.Symbols[index + (code - first)];
+            }
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        throw std::runtime_error("Invalid compressed data, unknown Huffman code.");
+    }
+
+    void ReadBlockHeader()
+    {
+        if (m_final)
+        {
+            m_state = State::Done;
+            return;
+        }
+
+        m_final = Bits(1) != 0;
+        switch (Bits(2))
+        {
+        case 0:
+        {
+            // Stored blocks start at a byte boundary.
+            auto skip = m_bitCount % 8;
+            m_bitBuffer >>= skip;
+            m_bitCount -= skip;
+            auto length = Bits(16);
+            if ((length ^ 0xFFFF) != Bits(16))
+            {
+                throw std::runtime_error("Invalid compressed data, stored block length mismatch.");
+            }
+            m_storedRemaining = length;
+            m_state = State::Stored;
+            break;
+        }
+
+        case 1:
+            BuildFixedCodes();
+            m_state = State::Huffman;
+            break;
+
+        case 2:
+            BuildDynamicCodes();
+            m_state = State::Huffman;
+            break;
+
+        default:
+            throw std::runtime_error("Invalid compressed data, unknown block type.");
+        }
+    }
+
+    void BuildFixedCodes()
+    {
+        uint8_t lengths[288];
+        for (int symbol = 0; symbol < 288; symbol++)
+        {
+            lengths[symbol] = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+        }
+        m_literals.Build(lengths, 288);
+
+        for (int symbol = 0; symbol < 30; symbol++)
+        {
+            lengths[symbol] = 5;
+        }
+        m_distances.Build(lengths, 30);
+    }
+
+    void BuildDynamicCodes()
+    {
+        static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+        int literalCount = static_cast<int>(Bits(5)) + 257;
+        int distanceCount = static_cast<int>(Bits(5)) + 1;
+        int codeLengthCount = static_cast<int>(Bits(4)) + 4;
+        if (literalCount > 286 || distanceCount > 30)
+        {
+            throw std::runtime_error("Invalid compressed data, too many codes.");
+        }
+
+        uint8_t lengths[288 + 32] = {};
+        for (int i = 0; i < codeLengthCount; i++)
+        {
+            lengths[order[i]] = static_cast<uint8_t>(Bits(3));
+        }
+        Huffman codeLengths;
+        codeLengths.Build(lengths, 19);
+
+        // Literal/length and distance code lengths form one sequence, repeats may cross from one to the other.
+        int index = 0;
+        while (index < literalCount + distanceCount)
+        {
+            auto symbol = Decode(codeLengths);
+            if (symbol < 16)
+            {
+                lengths[index++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+
+            uint8_t value = 0;
+            int repeat = 0;
+            if (symbol == 16)
+            {
+                if (index == 0)
+                {
+                    throw std::runtime_error("Invalid compressed data, repeat with no previous length.");
+                }
+                value = lengths[index - 1];
+                repeat = 3 + static_cast<int>(Bits(2));
+            }
+            else if (symbol == 17)
+            {
+                repeat = 3 + static_cast<int>(Bits(3));
+            }
+            else
+            {
+                repeat = 11 + static_cast<int>(Bits(7));
+            }
+            if (index + repeat > literalCount + distanceCount)
+            {
+                throw std::runtime_error("Invalid compressed data, too many code lengths.");
+            }
+            while (repeat-- > 0)
+            {
+                lengths[index++] = value;
+            }
+        }
+
+        if (lengths[256] == 0)
+        {
+            throw std::runtime_error("Invalid compressed data, no end of block code.");
+        }
+        m_literals.Build(lengths, literalCount);
+        m_distances.Build(lengths + literalCount, distanceCount);
+    }
+
+    void DecodeSymbol(uint8_t* buffer, size_t& produced)
+    {
+        static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        auto symbol = Decode(m_literals);
+        if (symbol < 256)
+        {
+            Emit(static_cast<uint8_t>(symbol), buffer, produced);
+            return;
+        }
+        if (symbol == 256)
+        {
+            m_state = State::BlockHeader;
+            return;
+        }
+
+        symbol -= 257;
+        if (symbol >= 29)
+        {
+            throw std::runtime_error("Invalid compressed data, invalid length code.");
+        }
+        auto length = lengthBase[symbol] + Bits(lengthExtra[symbol]);
+
+        auto distanceSymbol = Decode(m_distances);
+        if (distanceSymbol >= 30)
+        {
+            throw std::runtime_error("Invalid compressed data, invalid distance code.");
+        }
+        auto distance = distanceBase[distanceSymbol] + Bits(distanceExtra[distanceSymbol]);
+        if (distance > m_totalOut)
+        {
+            throw std::runtime_error("Invalid compressed data, distance too far back.");
+        }
+
+        // The copy is done by Read(), possibly over several calls.
+        m_copyLength = length;
+        m_copyDistance = distance;
+    }
+
+    Source m_source;
+    std::vector<uint8_t> m_input;
+    size_t m_inputSize = 0;
+    size_t m_inputPosition = 0;
+    uint64_t m_bitBuffer = 0;
+    int m_bitCount = 0;
+
+    State m_state = State::BlockHeader;
+    bool m_final = false;
+    uint32_t m_storedRemaining = 0;
+    Huffman m_literals;
+    Huffman m_distances;
+
+    std::vector<uint8_t> m_window;
+    uint64_t m_totalOut = 0;
+    uint32_t m_copyLength = 0;
+    uint32_t m_copyDistance = 0;
+};
@@ -0,0 +1,185 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Resolves fixed command phrasings to intents locally, so that they do not need a round-trip
+// to the Language Understanding service. Phrases are added first, then compiled into a trie stored
+// in flat arrays. Matching walks the trie while normalizing the recognized text on the fly:
+// letters are lower-cased, apostrophes are dropped and other punctuation and white space collapse
+// into single spaces, so "Turn on the lights." matches the phrase "turn on the lights".
+class IntentPhraseMatcher final
+{
+public:
+    // Match statistics.
+    struct Statistics
+    {
+        uint64_t Hits;
+        uint64_t Misses;
+        double TotalHitMicroseconds;
+        double TotalMissMicroseconds;
+    };
+
+    // Adds a phrase resolving to the given intent. Phrases must be added before Compile().
+    void AddPhrase(const std::string& phrase, const std::string& intentId)
+    {
+        if (m_compiled)
+        {
+            throw std::logic_error("Phrases cannot be added after the matcher is compiled.");
+        }
+
+        auto intent = std::find(m_intents.begin(), m_intents.end(), intentId) - m_intents.begin();
+        if (intent == static_cast<std::ptrdiff_t>(m_intents.size()))
+        {
+            m_intents.push_back(intentId);
+        }
+
+        auto node = m_builder.get();
+        Normalize(phrase, [&node](char c)
+        {
+            auto& child = node->Children[c];
+            if (!child)
+            {
+                child.reset(new BuilderNode());
+            }
+            node = child.get();
+            return true;
+        });
+        node->Intent = static_cast<int32_t>(intent);
+    }
+
+    // Compiles the added phrases into the flat trie used for matching.
+    void Compile()
+    {
+        // Lays out the nodes breadth first; the children of each node are contiguous and sorted by label.
+        std::vector<const BuilderNode*> order{ m_builder.get() };
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            m_firstEdge.push_back(static_cast<uint32_t>(m_edgeLabels.size()));
+            m_nodeIntent.push_back(order[i]->Intent);
+            for (const auto& child : order[i]->Children)
+            {
+                m_edgeLabels.push_back(child.first);
+                m_edgeTargets.push_back(static_cast<uint32_t>(order.size()));
+                order.push_back(child.second.get());
+            }
+        }
+        m_firstEdge.push_back(static_cast<uint32_t>(m_edgeLabels.size()));
+
+        m_builder.reset();
+        m_compiled = true;
+    }
+
+    // Matches the whole recognized text against the compiled phrases.
+    // Returns the intent id, or nullptr if the text is not a known phrasing and should go to the remote model.
+    const std::string* Match(const std::string& text)
+    {
+        if (!m_compiled)
+        {
+            throw std::logic_error("The matcher must be compiled before matching.");
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        uint32_t node = 0;
+        auto found = Normalize(text, [this, &node](char c)
+        {
+            auto first = m_edgeLabels.begin() + m_firstEdge[node];
+            auto last = m_edgeLabels.begin() + m_firstEdge[node + 1];
+            auto edge = std::lower_bound(first, last, c);
+            if (edge == last || *edge != c)
+            {
+                return false;
+            }
+            node = m_edgeTargets[edge - m_edgeLabels.begin()];
+            return true;
+        });
+        auto intent = found ? m_nodeIntent[node] : -1;
+        auto elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+        if (intent < 0)
+        {
+            m_misses++;
+            m_missNanoseconds += elapsed;
+            return nullptr;
+        }
+
+        m_hits++;
+        m_hitNanoseconds += elapsed;
+        return &m_intents[intent];
+    }
+
+    // Gets the match statistics.
+    Statistics GetStatistics() const
+    {
+        return Statistics{ m_hits, m_misses, m_hitNanoseconds / 1000.0, m_missNanoseconds / 1000.0 };
+    }
+
+private:
+    struct BuilderNode
+    {
+        std::map<char, std::unique_ptr<BuilderNode>> Children;
+        int32_t Intent = -1;
+    };
+
+    // Calls step() with each character of the normalized text, stopping early when it returns false.
+    // Returns false if stopped early.
+    template<class Step>
+    static bool Normalize(const std::string& text, Step step)
+    {
+        bool pendingSpace = false;
+        bool emitted = false;
+        for (auto c : text)
+        {
+            auto u = static_cast<unsigned char>(c);
+            if (u == '\'')
+            {
+                continue;
+            }
+
+            // Bytes of non-ASCII characters are kept as they are.
+            if (u >= 0x80 || (u >= '0' && u <= '9') || (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z'))
+            {
+                if (pendingSpace && emitted && !step(' '))
+                {
+                    return false;
+                }
+                pendingSpace = false;
+                emitted = true;
+                if (!step(u >= 'A' && u <= 'Z' ? static_cast<char>(u - 'A' + 'a') : c))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                pendingSpace = true;
+            }
+        }
+        return true;
+    }
+
+    std::unique_ptr<BuilderNode> m_builder{ new BuilderNode() };
+    bool m_compiled = false;
+    std::vector<std::string> m_intents;
+
+    std::vector<uint32_t> m_firstEdge;
+    std::vector<char> m_edgeLabels;
+    std::vector<uint32_t> m_edgeTargets;
+    std::vector<int32_t> m_nodeIntent;
+
+    std::atomic<uint64_t> m_hits{ 0 };
+    std::atomic<uint64_t> m_misses{ 0 };
+    std::atomic<uint64_t> m_hitNanoseconds{ 0 };
+    std::atomic<uint64_t> m_missNanoseconds{ 0 };
+};
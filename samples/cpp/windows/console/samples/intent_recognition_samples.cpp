@@ -7,6 +7,16 @@
 
 // <toplevel>
 #include <speechapi_cxx.h>
+#include "intent_phrase_matcher.h"
+#include "json_view.h"
+#include "wav_file_reader.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -222,3 +232,513 @@ void IntentContinuousRecognitionWithFile()
     recognizer->StopContinuousRecognitionAsync().get();
     // </IntentContinuousRecognitionWithFile>
 }
+
+// Continuous intent recognition resolving frequent phrasings locally. Speech is only transcribed; an utterance the
+// matcher does not know falls back to the Language Understanding service, by sending its audio again to an intent
+// recognizer. The latency of both paths is reported.
+void IntentContinuousRecognitionWithLocalPhraseMatcher()
+{
+    // Compiles the fixed phrasings that make up most of the traffic.
+    // Replace with your own phrasings and the intent ids of your Language Understanding model.
+    IntentPhraseMatcher matcher;
+    matcher.AddPhrase("What's the weather like", "weather");
+    matcher.AddPhrase("What is the weather like", "weather");
+    matcher.AddPhrase("Turn on the lights", "lights_on");
+    matcher.AddPhrase("Turn off the lights", "lights_off");
+    matcher.Compile();
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates an instance of a speech config with your Language Understanding subscription key ('endpoint key')
+    // and service region, for the utterances resolved remotely.
+    auto intentConfig = SpeechConfig::FromSubscription("YourLanguageUnderstandingSubscriptionKey", "YourLanguageUnderstandingServiceRegion");
+    auto model = LanguageUnderstandingModel::FromAppId("YourLanguageUnderstandingAppId");
+
+    // Reads the audio into memory, so that the audio of an utterance can be sent again to the intent recognizer.
+    // Replace with your own 16-bit PCM wav file.
+    WavFileReader reader("whatstheweatherlike.wav");
+    if (reader.GetFormatTag() != 1 || reader.GetBitsPerSample() != 16 || reader.GetChannels() == 0)
+    {
+        cout << "Unsupported audio format, a 16-bit PCM wav file is expected." << std::endl;
+        return;
+    }
+    auto format = AudioStreamFormat::GetWaveFormatPCM(reader.GetSamplesPerSecond(), 16, reader.GetChannels());
+    size_t frameBytes = 2 * reader.GetChannels();
+    double bytesPerTick = reader.GetSamplesPerSecond() * frameBytes / 10000000.0;
+    vector<uint8_t> audio(reader.GetDataSize());
+    audio.resize(static_cast<size_t>(max(reader.Read(audio.data(), static_cast<uint32_t>(audio.size())), 0)));
+    reader.Close();
+
+    auto pushStream = AudioInputStream::CreatePushStream(format);
+    pushStream->Write(audio.data(), static_cast<uint32_t>(audio.size()));
+    pushStream->Close();
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pushStream));
+
+    // Utterances to be resolved by the remote model, with their position in the audio in ticks of 100 ns.
+    struct Miss
+    {
+        string Text;
+        uint64_t Offset;
+        uint64_t Duration;
+    };
+    vector<Miss> misses;
+
+    // promise for synchronization of recognition end.
+    std::promise<void> recognitionEnd;
+
+    // Subscribes to events.
+    recognizer->Recognized.Connect([&matcher, &misses] (const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            auto intentId = matcher.Match(e.Result->Text);
+            if (intentId != nullptr)
+            {
+                cout << "RECOGNIZED LOCALLY: Text=" << e.Result->Text << std::endl;
+                cout << "  Intent Id: " << *intentId << std::endl;
+            }
+            else
+            {
+                cout << "RECOGNIZED: Text=" << e.Result->Text << " (to be resolved by the Language Understanding service)" << std::endl;
+                misses.push_back(Miss{ e.Result->Text, e.Result->Offset(), e.Result->Duration() });
+            }
+        }
+        else if (e.Result->Reason == ResultReason::NoMatch)
+        {
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        }
+    });
+
+    recognizer->Canceled.Connect([&recognitionEnd](const SpeechRecognitionCanceledEventArgs& e)
+    {
+        cout << "CANCELED: Reason=" << (int)e.Reason << std::endl;
+
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+
+        recognitionEnd.set_value(); // Notify to stop recognition.
+    });
+
+    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
+    {
+        cout << "Session stopped.";
+        recognitionEnd.set_value(); // Notify to stop recognition.
+    });
+
+    // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
+    recognizer->StartContinuousRecognitionAsync().get();
+
+    // Waits for recognition end.
+    recognitionEnd.get_future().get();
+
+    // Stops recognition.
+    recognizer->StopContinuousRecognitionAsync().get();
+    cout << std::endl;
+
+    // Resolves the misses remotely, one intent recognition of the audio of each utterance. The round trip is timed
+    // from the creation of the intent recognizer, since a fallback made on demand also pays for connecting.
+    const uint64_t margin = 1000000;    // 100 ms of audio around the utterance, so that no word is cut.
+    double totalRemoteMs = 0;
+    size_t resolved = 0;
+    for (const auto& miss : misses)
+    {
+        auto begin = min(audio.size(), static_cast<size_t>((miss.Offset > margin ? miss.Offset - margin : 0) * bytesPerTick) / frameBytes * frameBytes);
+        auto end = min(audio.size(), static_cast<size_t>((miss.Offset + miss.Duration + margin) * bytesPerTick) / frameBytes * frameBytes);
+
+        auto start = chrono::steady_clock::now();
+        auto utteranceStream = AudioInputStream::CreatePushStream(format);
+        utteranceStream->Write(audio.data() + begin, static_cast<uint32_t>(end - begin));
+        utteranceStream->Close();
+        auto intentRecognizer = IntentRecognizer::FromConfig(intentConfig, AudioConfig::FromStreamInput(utteranceStream));
+        intentRecognizer->AddAllIntents(model);
+        auto result = intentRecognizer->RecognizeOnceAsync().get();
+        auto remoteMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        totalRemoteMs += remoteMs;
+
+        if (result->Reason == ResultReason::RecognizedIntent)
+        {
+            resolved++;
+            cout << "RECOGNIZED REMOTELY: Text=" << miss.Text << " (" << remoteMs << "ms)" << std::endl;
+            cout << "  Intent Id: " << result->IntentId << std::endl;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = CancellationDetails::FromResult(result);
+            cout << "CANCELED: Text=" << miss.Text << ", ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+        }
+        else
+        {
+            cout << "NO INTENT: Text=" << miss.Text << " (" << remoteMs << "ms)" << std::endl;
+        }
+    }
+
+    auto statistics = matcher.GetStatistics();
+    cout << "\nLocal phrase matcher: " << statistics.Hits << " hits, " << statistics.Misses << " misses." << std::endl;
+    double localUs = statistics.Hits > 0 ? statistics.TotalHitMicroseconds / statistics.Hits : 0;
+    if (statistics.Hits > 0)
+    {
+        cout << "  Average local resolution latency: " << localUs << "us" << std::endl;
+    }
+    if (!misses.empty())
+    {
+        auto remoteMs = totalRemoteMs / misses.size();
+        cout << "  Average remote resolution latency: " << remoteMs << "ms, " << misses.size() << " utterances sent to the "
+             << "Language Understanding service, " << resolved << " resolved to an intent." << std::endl;
+        if (statistics.Hits > 0)
+        {
+            cout << "  Each local hit saved about " << remoteMs - localUs / 1000 << "ms." << std::endl;
+        }
+    }
+}
+
+// Prints the top scoring intent and the entities of a Language Understanding service response.
+static void PrintIntentAndEntities(const JsonView& response)
+{
+    auto topScoringIntent = response["topScoringIntent"];
+    cout << "  Top scoring intent: " << topScoringIntent["intent"].AsString().ToString()
+         << ", score: " << topScoringIntent["score"].AsNumber() << std::endl;
+
+    response["entities"].ForEachElement([](const JsonView& entity)
+    {
+        cout << "  Entity: " << entity["entity"].AsString().ToString()
+             << ", type: " << entity["type"].AsString().ToString()
+             << ", score: " << entity["score"].AsNumber() << std::endl;
+        return true;
+    });
+}
+
+// Continuous intent recognition, reading the top scoring intent and entities straight from the service JSON.
+void IntentContinuousRecognitionWithJsonView()
+{
+    // Creates an instance of a speech config with specified subscription key
+    // and service region. Replace with your own Language Understanding subscription key
+    // and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourLanguageUnderstandingSubscriptionKey", "YourLanguageUnderstandingServiceRegion");
+
+    // Creates an intent recognizer using file as audio input.
+    // Replace with your own audio file name.
+    auto audioInput = AudioConfig::FromWavFileInput("whatstheweatherlike.wav");
+    auto recognizer = IntentRecognizer::FromConfig(config, audioInput);
+
+    // promise for synchronization of recognition end.
+    std::promise<void> recognitionEnd;
+
+    // Creates a Language Understanding model using the app id, and adds all intents from your model
+    auto model = LanguageUnderstandingModel::FromAppId("YourLanguageUnderstandingAppId");
+    recognizer->AddAllIntents(model);
+
+    // Subscribes to events.
+    recognizer->Recognized.Connect([] (const IntentRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedIntent)
+        {
+            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
+            cout << "  Intent Id: " << e.Result->IntentId << std::endl;
+
+            // The property is retrieved once; the view reads the values it needs in place.
+            auto json = e.Result->Properties.GetProperty(PropertyId::LanguageUnderstandingServiceResponse_JsonResult);
+            PrintIntentAndEntities(JsonView(json));
+        }
+        else if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << e.Result->Text << " (intent could not be recognized)" << std::endl;
+        }
+        else if (e.Result->Reason == ResultReason::NoMatch)
+        {
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        }
+    });
+
+    recognizer->Canceled.Connect([&recognitionEnd](const IntentRecognitionCanceledEventArgs& e)
+    {
+        cout << "CANCELED: Reason=" << (int)e.Reason << std::endl;
+
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+
+        recognitionEnd.set_value(); // Notify to stop recognition.
+    });
+
+    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
+    {
+        cout << "Session stopped.";
+        recognitionEnd.set_value(); // Notify to stop recognition.
+    });
+
+    // Starts continuous recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
+    recognizer->StartContinuousRecognitionAsync().get();
+
+    // Waits for recognition end.
+    recognitionEnd.get_future().get();
+
+    // Stops recognition.
+    recognizer->StopContinuousRecognitionAsync().get();
+}
+
+// Document model of the baseline of IntentJsonExtractionBenchmark: the whole text is parsed in one recursive descent
+// pass into maps, vectors and unescaped strings, as a general purpose JSON library does.
+struct JsonDomValue
+{
+    enum class Type { Null, Boolean, Number, String, Array, Object };
+
+    Type Kind = Type::Null;
+    bool Boolean = false;
+    double Number = 0;
+    string String;
+    vector<unique_ptr<JsonDomValue>> Elements;
+    map<string, unique_ptr<JsonDomValue>> Members;
+
+    const JsonDomValue& operator[](const string& key) const
+    {
+        auto member = Members.find(key);
+        if (member == Members.end())
+        {
+            throw runtime_error("Missing JSON member " + key);
+        }
+        return *member->second;
+    }
+
+    static JsonDomValue Parse(const string& text)
+    {
+        JsonDomValue value;
+        size_t position = 0;
+        ParseValue(text, position, value);
+        SkipSpace(text, position);
+        if (position != text.size())
+        {
+            throw runtime_error("Invalid JSON, unexpected text after the value.");
+        }
+        return value;
+    }
+
+private:
+    static void SkipSpace(const string& text, size_t& position)
+    {
+        while (position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r'))
+        {
+            position++;
+        }
+    }
+
+    // Skips white space, then the expected character; returns false if another character is found.
+    static bool Accept(const string& text, size_t& position, char expected)
+    {
+        SkipSpace(text, position);
+        if (position < text.size() && text[position] == expected)
+        {
+            position++;
+            return true;
+        }
+        return false;
+    }
+
+    static void Expect(const string& text, size_t& position, char expected)
+    {
+        if (!Accept(text, position, expected))
+        {
+            throw runtime_error(string("Invalid JSON, '") + expected + "' expected.");
+        }
+    }
+
+    static void ParseValue(const string& text, size_t& position, JsonDomValue& value)
+    {
+        SkipSpace(text, position);
+        if (position == text.size())
+        {
+            throw runtime_error("Invalid JSON, value expected.");
+        }
+
+        switch (text[position])
+        {
+        case '{':
+            value.Kind = Type::Object;
+            position++;
+            if (Accept(text, position, '}'))
+            {
+                return;
+            }
+            do
+            {
+                string key;
+                SkipSpace(text, position);
+                ParseString(text, position, key);
+                Expect(text, position, ':');
+                unique_ptr<JsonDomValue> member(new JsonDomValue());
+                ParseValue(text, position, *member);
+                value.Members[move(key)] = move(member);
+            } while (Accept(text, position, ','));
+            Expect(text, position, '}');
+            return;
+        case '[':
+            value.Kind = Type::Array;
+            position++;
+            if (Accept(text, position, ']'))
+            {
+                return;
+            }
+            do
+            {
+                value.Elements.emplace_back(new JsonDomValue());
+                ParseValue(text, position, *value.Elements.back());
+            } while (Accept(text, position, ','));
+            Expect(text, position, ']');
+            return;
+        case '"':
+            value.Kind = Type::String;
+            ParseString(text, position, value.String);
+            return;
+        case 't':
+        case 'f':
+        case 'n':
+            for (const char* literal : { "true", "false", "null" })
+            {
+                auto length = strlen(literal);
+                if (text.compare(position, length, literal) == 0)
+                {
+                    value.Kind = literal[0] == 'n' ? Type::Null : Type::Boolean;
+                    value.Boolean = literal[0] == 't';
+                    position += length;
+                    return;
+                }
+            }
+            throw runtime_error("Invalid JSON literal.");
+        default:
+        {
+            char* end = nullptr;
+            value.Kind = Type::Number;
+            value.Number = strtod(text.c_str() + position, &end);
+            if (end == text.c_str() + position)
+            {
+                throw runtime_error("Invalid JSON, value expected.");
+            }
+            position = static_cast<size_t>(end - text.c_str());
+            return;
+        }
+        }
+    }
+
+    // Parses a string, unescaping it; characters escaped as \\u are encoded as UTF-8.
+    static void ParseString(const string& text, size_t& position, string& output)
+    {
+        if (position == text.size() || text[position] != '"')
+        {
+            throw runtime_error("Invalid JSON, string expected.");
+        }
+        for (position++; position < text.size() && text[position] != '"'; position++)
+        {
+            if (text[position] != '\\')
+            {
+                output += text[position];
+                continue;
+            }
+            if (++position == text.size())
+            {
+                break;
+            }
+            switch (text[position])
+            {
+            case 'b': output += '\b'; break;
+            case 'f': output += '\f'; break;
+            case 'n': output += '\n'; break;
+            case 'r': output += '\r'; break;
+            case 't': output += '\t'; break;
+            case 'u':
+            {
+                if (position + 4 >= text.size())
+                {
+                    throw runtime_error("Invalid JSON escape sequence.");
+                }
+                auto code = static_cast<uint32_t>(strtoul(text.substr(position + 1, 4).c_str(), nullptr, 16));
+                position += 4;
+                if (code < 0x80)
+                {
+                    output += static_cast<char>(code);
+                }
+                else if (code < 0x800)
+                {
+                    output += static_cast<char>(0xC0 | code >> 6);
+                    output += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                else
+                {
+                    output += static_cast<char>(0xE0 | code >> 12);
+                    output += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+                    output += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: output += text[position]; break;
+            }
+        }
+        if (position == text.size())
+        {
+            throw runtime_error("Invalid JSON, unterminated string.");
+        }
+        position++;
+    }
+};
+
+// Measures reading the top scoring intent and entities from a large service response,
+// with a full parse into a document model of maps, vectors and strings versus with a JsonView. Runs offline.
+void IntentJsonExtractionBenchmark()
+{
+    // Builds a response shaped like the Language Understanding service JSON, with many entities.
+    const int entityCount = 500;
+    string json = "{\"query\":\"book a table for two at eight\",\"topScoringIntent\":{\"intent\":\"BookTable\",\"score\":0.97},\"intents\":[";
+    for (int i = 0; i < 20; i++)
+    {
+        json += (i == 0 ? "" : ",") + string("{\"intent\":\"Intent") + to_string(i) + "\",\"score\":0.0" + to_string(i) + "}";
+    }
+    json += "],\"entities\":[";
+    for (int i = 0; i < entityCount; i++)
+    {
+        json += (i == 0 ? "" : ",") + string("{\"entity\":\"value ") + to_string(i) + "\",\"type\":\"builtin.number\",\"startIndex\":"
+            + to_string(i) + ",\"endIndex\":" + to_string(i + 5) + ",\"score\":0.9,\"resolution\":{\"values\":[\"" + to_string(i) + "\"]}}";
+    }
+    json += "]}";
+
+    const int iterations = 1000;
+    using Clock = chrono::steady_clock;
+
+    // Baseline: parses the whole document into a document model in one pass, then reads the values from it.
+    size_t checksum = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        auto document = JsonDomValue::Parse(json);
+        checksum += document["topScoringIntent"]["intent"].String.size();
+        for (const auto& entity : document["entities"].Elements)
+        {
+            checksum += (*entity)["entity"].String.size() + (*entity)["type"].String.size();
+        }
+    }
+    auto treeMs = chrono::duration<double, milli>(Clock::now() - start).count();
+
+    start = Clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        JsonView response(json);
+        checksum += response["topScoringIntent"]["intent"].AsString().Size;
+        response["entities"].ForEachElement([&checksum](const JsonView& entity)
+        {
+            checksum += entity["entity"].AsString().Size + entity["type"].AsString().Size;
+            return true;
+        });
+    }
+    auto viewMs = chrono::duration<double, milli>(Clock::now() - start).count();
+
+    cout << "Response of " << json.size() << " bytes with " << entityCount << " entities, " << iterations << " iterations:" << std::endl;
+    cout << "  DOM parse:  " << treeMs * 1000 / iterations << "us per response" << std::endl;
+    cout << "  JsonView:   " << viewMs * 1000 / iterations << "us per response" << std::endl;
+    cout << "  (checksum " << checksum << ")" << std::endl;
+}
@@ -0,0 +1,262 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Read-only view over a JSON value inside a buffer the caller keeps alive, e.g. the string returned for
+// PropertyId::LanguageUnderstandingServiceResponse_JsonResult. Nothing is parsed up front and nothing
+// is copied: looking up a member scans the object and skips over the values it does not need, and
+// strings are returned as slices of the buffer, with escape sequences left as they are.
+// Malformed JSON yields invalid views rather than exceptions.
+class JsonView final
+{
+public:
+    // A slice of the underlying buffer.
+    struct Slice
+    {
+        const char* Data = nullptr;
+        size_t Size = 0;
+
+        bool operator==(const char* text) const
+        {
+            return Data != nullptr && strlen(text) == Size && memcmp(Data, text, Size) == 0;
+        }
+
+        std::string ToString() const
+        {
+            return Data == nullptr ? std::string() : std::string(Data, Size);
+        }
+    };
+
+    JsonView() = default;
+
+    // Creates a view over the JSON document in the given string, which must outlive the view.
+    explicit JsonView(const std::string& json)
+        : JsonView(json.data(), json.data() + json.size())
+    {
+    }
+
+    JsonView(const char* begin, const char* end)
+        : m_begin(SkipWhitespace(begin, end)), m_end(end)
+    {
+    }
+
+    bool IsValid() const { return m_begin != nullptr && m_begin < m_end; }
+    bool IsObject() const { return IsValid() && *m_begin == '{'; }
+    bool IsArray() const { return IsValid() && *m_begin == '['; }
+    bool IsString() const { return IsValid() && *m_begin == '"'; }
+
+    // Gets the member with the given key, or an invalid view if this is not an object or has no such member.
+    JsonView operator[](const char* key) const
+    {
+        JsonView found;
+        ForEachMember([&](const Slice& name, const JsonView& value)
+        {
+            if (name == key)
+            {
+                found = value;
+                return false;
+            }
+            return true;
+        });
+        return found;
+    }
+
+    // Calls visit(key, value) for each member of an object until it returns false.
+    template<class Visit>
+    void ForEachMember(Visit visit) const
+    {
+        if (!IsObject())
+        {
+            return;
+        }
+
+        auto p = SkipWhitespace(m_begin + 1, m_end);
+        while (p < m_end && *p == '"')
+        {
+            auto keyEnd = SkipString(p, m_end);
+            auto colon = SkipWhitespace(keyEnd, m_end);
+            if (colon == nullptr || colon >= m_end || *colon != ':')
+            {
+                return;
+            }
+
+            JsonView value(colon + 1, m_end);
+            auto valueEnd = SkipValue(value.m_begin, m_end);
+            if (valueEnd == nullptr)
+            {
+                return;
+            }
+            value.m_end = valueEnd;
+
+            Slice key;
+            key.Data = p + 1;
+            key.Size = static_cast<size_t>(keyEnd - p - 2);
+            if (!visit(key, value))
+            {
+                return;
+            }
+
+            p = SkipWhitespace(valueEnd, m_end);
+            if (p >= m_end || *p != ',')
+            {
+                return;
+            }
+            p = SkipWhitespace(p + 1, m_end);
+        }
+    }
+
+    // Calls visit(element) for each element of an array until it returns false.
+    template<class Visit>
+    void ForEachElement(Visit visit) const
+    {
+        if (!IsArray())
+        {
+            return;
+        }
+
+        auto p = SkipWhitespace(m_begin + 1, m_end);
+        while (p < m_end && *p != ']')
+        {
+            JsonView element(p, m_end);
+            auto elementEnd = SkipValue(element.m_begin, m_end);
+            if (elementEnd == nullptr)
+            {
+                return;
+            }
+            element.m_end = elementEnd;
+
+            if (!visit(element))
+            {
+                return;
+            }
+
+            p = SkipWhitespace(elementEnd, m_end);
+            if (p >= m_end || *p != ',')
+            {
+                return;
+            }
+            p = SkipWhitespace(p + 1, m_end);
+        }
+    }
+
+    // Gets the contents of a string value without the quotes, or an empty slice if this is not a string.
+    Slice AsString() const
+    {
+        Slice slice;
+        if (IsString())
+        {
+            auto end = SkipString(m_begin, m_end);
+            if (end != nullptr)
+            {
+                slice.Data = m_begin + 1;
+                slice.Size = static_cast<size_t>(end - m_begin - 2);
+            }
+        }
+        return slice;
+    }
+
+    // Gets a number value, or the given default if this is not a number.
+    double AsNumber(double defaultValue = 0) const
+    {
+        if (!IsValid() || !(*m_begin == '-' || (*m_begin >= '0' && *m_begin <= '9')))
+        {
+            return defaultValue;
+        }
+
+        // Numbers are short; copying into a terminated buffer keeps strtod() within the view.
+        char buffer[64];
+        auto length = SkipValue(m_begin, m_end) - m_begin;
+        if (length <= 0 || length >= static_cast<std::ptrdiff_t>(sizeof(buffer)))
+        {
+            return defaultValue;
+        }
+        memcpy(buffer, m_begin, static_cast<size_t>(length));
+        buffer[length] = '\0';
+        return strtod(buffer, nullptr);
+    }
+
+private:
+    static const char* SkipWhitespace(const char* p, const char* end)
+    {
+        while (p != nullptr && p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+        {
+            p++;
+        }
+        return p;
+    }
+
+    // Returns the position after the closing quote of the string starting at p, or nullptr.
+    static const char* SkipString(const char* p, const char* end)
+    {
+        for (p++; p < end; p++)
+        {
+            if (*p == '\\')
+            {
+                p++;
+            }
+            else if (*p == '"')
+            {
+                return p + 1;
+            }
+        }
+        return nullptr;
+    }
+
+    // Returns the position after the value starting at p, or nullptr.
+    static const char* SkipValue(const char* p, const char* end)
+    {
+        if (p == nullptr || p >= end)
+        {
+            return nullptr;
+        }
+
+        if (*p == '"')
+        {
+            return SkipString(p, end);
+        }
+
+        if (*p == '{' || *p == '[')
+        {
+            // Only brackets outside of strings count towards the nesting depth.
+            int depth = 0;
+            for (; p < end; p++)
+            {
+                if (*p == '"')
+                {
+                    p = SkipString(p, end);
+                    if (p == nullptr)
+                    {
+                        return nullptr;
+                    }
+                    p--;
+                }
+                else if (*p == '{' || *p == '[')
+                {
+                    depth++;
+                }
+                else if ((*p == '}' || *p == ']') && --depth == 0)
+                {
+                    return p + 1;
+                }
+            }
+            return nullptr;
+        }
+
+        // Numbers, true, false and null end at the next delimiter.
+        while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+        {
+            p++;
+        }
+        return p;
+    }
+
+    const char* m_begin = nullptr;
+    const char* m_end = nullptr;
+};
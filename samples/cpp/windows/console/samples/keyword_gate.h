@@ -0,0 +1,349 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "worker_pool.h"
+
+// Fixed-size buffer keeping the most recent audio of a feed; older audio is overwritten.
+class AudioRingBuffer final
+{
+public:
+    explicit AudioRingBuffer(size_t capacity)
+        : m_buffer(capacity)
+    {
+    }
+
+    void Write(const uint8_t* data, size_t size)
+    {
+        if (m_buffer.empty())
+        {
+            return;
+        }
+
+        // Only the last 'capacity' bytes can be kept.
+        if (size > m_buffer.size())
+        {
+            data += size - m_buffer.size();
+            size = m_buffer.size();
+        }
+
+        while (size > 0)
+        {
+            auto tail = (m_head + m_size) % m_buffer.size();
+            auto count = std::min(size, m_buffer.size() - tail);
+            memcpy(m_buffer.data() + tail, data, count);
+            data += count;
+            size -= count;
+            m_size += count;
+            if (m_size > m_buffer.size())
+            {
+                m_head = (m_head + m_size - m_buffer.size()) % m_buffer.size();
+                m_size = m_buffer.size();
+            }
+        }
+    }
+
+    // Calls read(data, size) with the buffered audio, oldest first, in at most two pieces.
+    template<class Read>
+    void ReadAll(Read read) const
+    {
+        auto first = std::min(m_size, m_buffer.size() - m_head);
+        if (first > 0)
+        {
+            read(m_buffer.data() + m_head, first);
+        }
+        if (m_size > first)
+        {
+            read(m_buffer.data(), m_size - first);
+        }
+    }
+
+    void Clear()
+    {
+        m_head = 0;
+        m_size = 0;
+    }
+
+private:
+    std::vector<uint8_t> m_buffer;
+    size_t m_head = 0;
+    size_t m_size = 0;
+};
+
+// Gates many audio feeds behind on-device keyword spotting.
+// Every feed is spotted by a KeywordRecognizer sharing one loaded keyword model; no cloud connection
+// is open while a feed waits for its keyword. When the keyword fires, a speech recognizer session is
+// opened on a worker pool thread, fed first with the pre-roll audio kept in the ring buffer of the feed
+// (covering the keyword), then with the audio that arrived while the session waited for a free thread
+// and opened, then with live audio. That backlog is not bounded: it grows by the audio rate of the feed
+// for as long as all sessions are busy, so the pool should be sized to keep the queue short.
+// After the utterance following the keyword is recognized, the feed goes back to spotting; the audio
+// that arrives while its keyword recognizer is recreated is kept in the pre-roll and replayed to it.
+// The size of the pool bounds the number of cloud sessions open at the same time.
+// Audio must be 16 kHz, 16 bits per sample, mono PCM.
+class KeywordGate final
+{
+public:
+    using ResultHandler = std::function<void(size_t feed, std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechRecognitionResult> result)>;
+
+    KeywordGate(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config,
+                std::shared_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognitionModel> model,
+                size_t feedCount,
+                size_t maxSessions,
+                ResultHandler handler,
+                uint32_t preRollMs = 2000)
+        : m_config(config),
+          m_model(model),
+          m_handler(handler),
+          m_pool(maxSessions)
+    {
+        for (size_t i = 0; i < feedCount; i++)
+        {
+            m_feeds.emplace_back(new Feed(static_cast<size_t>(preRollMs) * bytesPerMillisecond));
+        }
+    }
+
+    ~KeywordGate()
+    {
+        Stop();
+    }
+
+    // Starts keyword spotting on all feeds.
+    void Start()
+    {
+        for (size_t i = 0; i < m_feeds.size(); i++)
+        {
+            StartSpotting(i);
+        }
+    }
+
+    // Writes audio of a feed, e.g. as it arrives from the network.
+    void Write(size_t feed, const uint8_t* data, uint32_t size)
+    {
+        auto& f = *m_feeds[feed];
+        std::lock_guard<std::mutex> lock(f.Mutex);
+        if (f.State == FeedState::Triggered)
+        {
+            // The pre-roll holds the keyword; nothing is overwritten until the session has read it.
+            f.Backlog.insert(f.Backlog.end(), data, data + size);
+            return;
+        }
+        f.PreRoll.Write(data, size);
+        if (f.State == FeedState::Spotting)
+        {
+            f.SpotterStream->Write(const_cast<uint8_t*>(data), size);
+        }
+        else if (f.State == FeedState::Listening)
+        {
+            f.SessionStream->Write(const_cast<uint8_t*>(data), size);
+        }
+    }
+
+    // Stops spotting and waits for the open sessions to complete.
+    void Stop()
+    {
+        if (m_stopping.exchange(true))
+        {
+            return;
+        }
+
+        for (auto& feed : m_feeds)
+        {
+            std::shared_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognizer> spotter;
+            {
+                std::lock_guard<std::mutex> lock(feed->Mutex);
+                if (feed->State == FeedState::Spotting)
+                {
+                    feed->State = FeedState::Stopped;
+                    spotter = feed->Spotter;
+                }
+                else if (feed->State == FeedState::Listening)
+                {
+                    // Ends the session; its task sees m_stopping and does not restart spotting.
+                    feed->State = FeedState::Stopped;
+                    feed->SessionStream->Close();
+                }
+            }
+            if (spotter)
+            {
+                spotter->StopRecognitionAsync().get();
+                ReleaseSpotter(*feed);
+            }
+        }
+
+        m_pool.WaitIdle();
+    }
+
+    // Gets the number of times a keyword fired.
+    uint64_t GetKeywordCount() const
+    {
+        return m_keywords;
+    }
+
+private:
+    static constexpr size_t bytesPerMillisecond = 16000 * 2 / 1000;
+
+    enum class FeedState
+    {
+        Spotting,
+        Triggered,
+        Listening,
+        Resuming,       // The session has ended; audio is kept in the pre-roll until spotting restarts.
+        Stopped
+    };
+
+    struct Feed
+    {
+        explicit Feed(size_t preRollBytes) : PreRoll(preRollBytes) {}
+
+        std::mutex Mutex;
+        FeedState State = FeedState::Stopped;
+        AudioRingBuffer PreRoll;
+        std::vector<uint8_t> Backlog;       // Audio written while the feed waits for its session.
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> SpotterStream;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognizer> Spotter;
+        std::future<std::shared_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognitionResult>> Spotting;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> SessionStream;
+    };
+
+    void StartSpotting(size_t feed)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        auto stream = AudioInputStream::CreatePushStream();
+        auto spotter = KeywordRecognizer::FromConfig(AudioConfig::FromStreamInput(stream));
+        spotter->Recognized.Connect([this, feed](const KeywordRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedKeyword)
+            {
+                OnKeyword(feed);
+            }
+        });
+
+        auto& f = *m_feeds[feed];
+        std::lock_guard<std::mutex> lock(f.Mutex);
+        if (m_stopping)
+        {
+            return;
+        }
+        // Replays the audio written since the feed last stopped spotting, so a keyword spoken meanwhile is not missed.
+        f.PreRoll.ReadAll([&stream](const uint8_t* data, size_t size)
+        {
+            stream->Write(const_cast<uint8_t*>(data), static_cast<uint32_t>(size));
+        });
+        f.SpotterStream = stream;
+        f.Spotter = spotter;
+        f.Spotting = spotter->RecognizeOnceAsync(m_model);
+        f.State = FeedState::Spotting;
+    }
+
+    // Called on the thread of the keyword recognizer; the session is opened on the pool.
+    void OnKeyword(size_t feed)
+    {
+        auto& f = *m_feeds[feed];
+        {
+            std::lock_guard<std::mutex> lock(f.Mutex);
+            if (f.State != FeedState::Spotting)
+            {
+                return;
+            }
+            // Audio is kept in the backlog until the session is open.
+            f.State = FeedState::Triggered;
+        }
+        m_keywords++;
+        m_pool.Post([this, feed]() { RunSession(feed); });
+    }
+
+    void RunSession(size_t feed)
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        auto& f = *m_feeds[feed];
+        ReleaseSpotter(f);
+
+        auto stream = AudioInputStream::CreatePushStream();
+        auto recognizer = SpeechRecognizer::FromConfig(m_config, AudioConfig::FromStreamInput(stream));
+        {
+            std::lock_guard<std::mutex> lock(f.Mutex);
+            if (m_stopping)
+            {
+                f.State = FeedState::Stopped;
+                return;
+            }
+            f.PreRoll.ReadAll([&stream](const uint8_t* data, size_t size)
+            {
+                stream->Write(const_cast<uint8_t*>(data), static_cast<uint32_t>(size));
+            });
+            if (!f.Backlog.empty())
+            {
+                stream->Write(f.Backlog.data(), static_cast<uint32_t>(f.Backlog.size()));
+            }
+            std::vector<uint8_t>().swap(f.Backlog);
+            f.SessionStream = stream;
+            f.State = FeedState::Listening;
+        }
+
+        auto result = recognizer->RecognizeOnceAsync().get();
+        {
+            std::lock_guard<std::mutex> lock(f.Mutex);
+            if (f.State == FeedState::Listening)
+            {
+                f.SessionStream->Close();
+            }
+            // Drops the audio already recognized; from now on the pre-roll collects the audio for the next spotter.
+            f.State = FeedState::Resuming;
+            f.SessionStream = nullptr;
+            f.PreRoll.Clear();
+        }
+        m_handler(feed, result);
+
+        if (!m_stopping)
+        {
+            StartSpotting(feed);
+        }
+    }
+
+    // Releases the keyword recognizer of a feed once its recognition has completed.
+    // Must not be called on the thread of the recognizer's own events.
+    void ReleaseSpotter(Feed& f)
+    {
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognizer> spotter;
+        std::shared_ptr<Microsoft::CognitiveServices::Speech::Audio::PushAudioInputStream> stream;
+        std::future<std::shared_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognitionResult>> spotting;
+        {
+            std::lock_guard<std::mutex> lock(f.Mutex);
+            spotter.swap(f.Spotter);
+            stream.swap(f.SpotterStream);
+            spotting = std::move(f.Spotting);
+        }
+        if (stream)
+        {
+            stream->Close();
+        }
+        if (spotting.valid())
+        {
+            spotting.get();
+        }
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognitionModel> m_model;
+    ResultHandler m_handler;
+    std::vector<std::unique_ptr<Feed>> m_feeds;
+    std::atomic<bool> m_stopping{ false };
+    std::atomic<uint64_t> m_keywords{ 0 };
+    WorkerPool m_pool;
+};
@@ -0,0 +1,70 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <map>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Process-wide registry of keyword recognition model handles, one per model file.
+// KeywordRecognitionModel::FromFile() only creates a handle wrapping the path of the file; the keyword engine of
+// each recognizer loads the table itself when recognition starts, whether or not the handle is shared. Sharing
+// therefore saves the creation of a handle per recognizer and lets every feed refer to the same model, but not
+// the load time or memory of the table.
+// A handle is released when the last recognizer using it is gone, and its entry is pruned on a later request.
+class KeywordModelRegistry final
+{
+public:
+    static KeywordModelRegistry& Instance()
+    {
+        static KeywordModelRegistry registry;
+        return registry;
+    }
+
+    // Gets the model handle of the given file, creating it if no recognizer holds it yet.
+    // Throws if the handle cannot be created, like KeywordRecognitionModel::FromFile().
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognitionModel> Get(const std::string& fileName)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_models.find(fileName);
+        if (it != m_models.end())
+        {
+            if (auto model = it->second.lock())
+            {
+                return model;
+            }
+        }
+
+        // Prunes the entries of handles no recognizer holds any more, so files used once do not stay in the map.
+        for (auto entry = m_models.begin(); entry != m_models.end();)
+        {
+            entry = entry->second.expired() ? m_models.erase(entry) : std::next(entry);
+        }
+
+        auto model = Microsoft::CognitiveServices::Speech::KeywordRecognitionModel::FromFile(fileName);
+        m_models[fileName] = model;
+        m_handleCount++;
+        return model;
+    }
+
+    // Gets the number of model handles created.
+    size_t GetHandleCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_handleCount;
+    }
+
+private:
+    KeywordModelRegistry() = default;
+    KeywordModelRegistry(const KeywordModelRegistry&) = delete;
+    KeywordModelRegistry& operator=(const KeywordModelRegistry&) = delete;
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, std::weak_ptr<Microsoft::CognitiveServices::Speech::KeywordRecognitionModel>> m_models;
+    size_t m_handleCount = 0;
+};
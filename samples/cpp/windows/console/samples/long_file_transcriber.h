@@ -0,0 +1,278 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "wav_file_reader.h"
+#include "worker_pool.h"
+
+// Transcribes a long wav file in chunks recognized in parallel sessions, instead of one session bound to the
+// real-time pace of the service. The file is scanned for pauses first and cut in the middle of pauses, so that
+// no phrase is split between chunks; the phrases of all chunks are then stitched into one transcript, with their
+// offsets moved from the start of their chunk to the start of the file.
+class LongFileTranscriber final
+{
+public:
+    struct Options
+    {
+        size_t MaxSessions = 8;             // Chunks recognized at the same time.
+        double TargetChunkSeconds = 60;     // Preferred chunk duration; cuts are made at the pause closest to it.
+        double MaxChunkSeconds = 90;        // Longest chunk, cut at the quietest point if it has no pause.
+        uint32_t MinPauseMs = 300;          // Shortest silence taken as a pause.
+    };
+
+    // Part of the audio data of the file, in bytes from the start of the data chunk.
+    struct Chunk
+    {
+        Chunk(uint64_t begin, uint64_t end, bool cutAtPause = true) : Begin(begin), End(end), CutAtPause(cutAtPause) {}
+
+        uint64_t Begin = 0;
+        uint64_t End = 0;
+        bool CutAtPause = true;     // False if the chunk had to be cut where there is no pause.
+        bool Failed = false;
+        std::string Error;
+    };
+
+    struct Phrase
+    {
+        uint64_t Offset = 0;        // In ticks of 100 ns, from the start of the file.
+        uint64_t Duration = 0;      // In ticks of 100 ns.
+        std::string Text;
+    };
+
+    struct Transcript
+    {
+        std::vector<Chunk> Chunks;
+        std::vector<Phrase> Phrases;    // In order of offset.
+        double AudioSeconds = 0;
+    };
+
+    LongFileTranscriber(std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> config, const Options& options)
+        : m_config(config),
+          m_options(options)
+    {
+    }
+
+    // Transcribes a 16-bit PCM wav file.
+    Transcript Transcribe(const std::string& fileName) const
+    {
+        Transcript transcript;
+        WavFileReader reader(fileName);
+        if (reader.GetFormatTag() != 1 || reader.GetBitsPerSample() != 16 || reader.GetChannels() == 0)
+        {
+            throw std::invalid_argument("Unsupported audio format, only 16-bit PCM wav files are split.");
+        }
+        auto blockAlign = 2u * reader.GetChannels();
+        auto bytesPerSecond = static_cast<uint64_t>(reader.GetSamplesPerSecond()) * blockAlign;
+        auto dataOffset = reader.GetDataOffset();
+        transcript.AudioSeconds = static_cast<double>(reader.GetDataSize()) / bytesPerSecond;
+        transcript.Chunks = FindChunks(reader);
+        reader.Close();
+
+        std::mutex mutex;
+        {
+            WorkerPool pool(m_options.MaxSessions);
+            for (auto& chunk : transcript.Chunks)
+            {
+                pool.Post([&, this]()
+                {
+                    std::vector<Phrase> phrases;
+                    RecognizeChunk(fileName, dataOffset, reader, chunk, phrases);
+
+                    // Offsets are moved from the start of the chunk to the start of the file.
+                    auto chunkOffset = chunk.Begin * 10000000 / bytesPerSecond;
+                    std::lock_guard<std::mutex> lock(mutex);
+                    for (auto& phrase : phrases)
+                    {
+                        phrase.Offset += chunkOffset;
+                        transcript.Phrases.push_back(std::move(phrase));
+                    }
+                });
+            }
+            pool.WaitIdle();
+        }
+
+        std::sort(transcript.Phrases.begin(), transcript.Phrases.end(),
+            [](const Phrase& a, const Phrase& b) { return a.Offset < b.Offset; });
+        return transcript;
+    }
+
+private:
+    // Pull audio input stream callback reading a range of the audio data of a file.
+    class RangeInputCallback final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+    {
+    public:
+        RangeInputCallback(const std::string& fileName, uint64_t begin, uint64_t end)
+            : m_fs(fileName, std::ios_base::binary | std::ios_base::in),
+              m_remaining(end - begin)
+        {
+            m_fs.seekg(static_cast<std::streamoff>(begin));
+        }
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            auto count = static_cast<uint32_t>(std::min<uint64_t>(size, m_remaining));
+            if (count == 0)
+            {
+                // Returns 0 to close the stream at the end of the range.
+                return 0;
+            }
+            m_fs.read(reinterpret_cast<char*>(dataBuffer), count);
+            count = static_cast<uint32_t>(m_fs.gcount());
+            m_remaining = count > 0 ? m_remaining - count : 0;
+            return static_cast<int>(count);
+        }
+
+        void Close() override
+        {
+            m_fs.close();
+        }
+
+    private:
+        std::ifstream m_fs;
+        uint64_t m_remaining;
+    };
+
+    // Splits the audio data into chunks, from the energy of 10 ms frames. Frames less than 10 dB above the 10th
+    // percentile of the frame levels, or below -60 dBFS, are silent; runs of them long enough are pauses.
+    std::vector<Chunk> FindChunks(WavFileReader& reader) const
+    {
+        auto samplesPerFrame = std::max<uint32_t>(reader.GetSamplesPerSecond() / 100, 1) * reader.GetChannels();
+        auto frameBytes = samplesPerFrame * 2;
+        std::vector<float> levels;
+        std::vector<int16_t> frame(samplesPerFrame);
+        for (uint64_t remaining = reader.GetDataSize(); remaining >= frameBytes; remaining -= frameBytes)
+        {
+            if (reader.Read(reinterpret_cast<uint8_t*>(frame.data()), frameBytes) != static_cast<int>(frameBytes))
+            {
+                break;
+            }
+            double energy = 0;
+            for (auto sample : frame)
+            {
+                energy += static_cast<double>(sample) * sample;
+            }
+            levels.push_back(static_cast<float>(10 * log10(energy / samplesPerFrame / (32768.0 * 32768.0) + 1e-10)));
+        }
+
+        std::vector<Chunk> chunks;
+        if (levels.empty())
+        {
+            chunks.emplace_back(0, reader.GetDataSize());
+            return chunks;
+        }
+
+        auto sorted = levels;
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 10, sorted.end());
+        auto threshold = std::max(sorted[sorted.size() / 10] + 10.0f, -60.0f);
+
+        // Pauses, as [begin, end) ranges of frames.
+        std::vector<std::pair<size_t, size_t>> pauses;
+        size_t minPauseFrames = std::max<size_t>(m_options.MinPauseMs / 10, 1);
+        for (size_t i = 0; i < levels.size();)
+        {
+            auto end = i;
+            while (end < levels.size() && levels[end] < threshold)
+            {
+                end++;
+            }
+            if (end - i >= minPauseFrames)
+            {
+                pauses.emplace_back(i, end);
+            }
+            i = std::max(end, i + 1);
+        }
+
+        auto targetFrames = std::max<size_t>(static_cast<size_t>(m_options.TargetChunkSeconds * 100), 1);
+        auto maxFrames = std::max(static_cast<size_t>(m_options.MaxChunkSeconds * 100), targetFrames);
+        size_t begin = 0;
+        size_t pause = 0;
+        while (levels.size() - begin > maxFrames)
+        {
+            // Cuts in the middle of the pause closest to the target, between half the target and the maximum.
+            auto target = begin + targetFrames;
+            auto low = begin + targetFrames / 2;
+            auto high = begin + maxFrames;
+            size_t cut = 0;
+            size_t bestDistance = SIZE_MAX;
+            while (pause < pauses.size() && pauses[pause].second <= low)
+            {
+                pause++;
+            }
+            for (auto p = pause; p < pauses.size() && pauses[p].first < high; p++)
+            {
+                auto middle = std::min(std::max((pauses[p].first + pauses[p].second) / 2, low), high);
+                auto distance = middle > target ? middle - target : target - middle;
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    cut = middle;
+                }
+            }
+
+            bool cutAtPause = bestDistance != SIZE_MAX;
+            if (!cutAtPause)
+            {
+                cut = static_cast<size_t>(std::min_element(levels.begin() + low, levels.begin() + high) - levels.begin());
+            }
+            chunks.emplace_back(begin * frameBytes, cut * frameBytes, cutAtPause);
+            begin = cut;
+        }
+        chunks.emplace_back(begin * frameBytes, reader.GetDataSize());
+        return chunks;
+    }
+
+    void RecognizeChunk(const std::string& fileName, uint64_t dataOffset, const WavFileReader& reader, Chunk& chunk, std::vector<Phrase>& phrases) const
+    {
+        using namespace Microsoft::CognitiveServices::Speech;
+        using namespace Microsoft::CognitiveServices::Speech::Audio;
+
+        auto callback = std::make_shared<RangeInputCallback>(fileName, dataOffset + chunk.Begin, dataOffset + chunk.End);
+        auto format = AudioStreamFormat::GetWaveFormatPCM(reader.GetSamplesPerSecond(), 16, static_cast<uint8_t>(reader.GetChannels()));
+        auto recognizer = SpeechRecognizer::FromConfig(m_config, AudioConfig::FromStreamInput(AudioInputStream::CreatePullStream(format, callback)));
+
+        std::promise<void> recognitionEnd;
+        recognizer->Recognized.Connect([&phrases](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedSpeech && !e.Result->Text.empty())
+            {
+                Phrase phrase;
+                phrase.Offset = e.Result->Offset();
+                phrase.Duration = e.Result->Duration();
+                phrase.Text = e.Result->Text;
+                phrases.push_back(phrase);
+            }
+        });
+        recognizer->Canceled.Connect([&chunk](const SpeechRecognitionCanceledEventArgs& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                chunk.Failed = true;
+                chunk.Error = e.ErrorDetails;
+            }
+        });
+        recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs&)
+        {
+            recognitionEnd.set_value();
+        });
+
+        recognizer->StartContinuousRecognitionAsync().get();
+        recognitionEnd.get_future().get();
+        recognizer->StopContinuousRecognitionAsync().get();
+    }
+
+    std::shared_ptr<Microsoft::CognitiveServices::Speech::SpeechConfig> m_config;
+    Options m_options;
+};
@@ -16,13 +16,28 @@ extern void SpeechContinuousRecognitionWithPullStream();
 extern void SpeechContinuousRecognitionWithPushStream();
 extern void KeywordTriggeredSpeechRecognitionWithMicrophone();
 extern void PronunciationAssessmentWithMicrophone();
+extern void KeywordGatedSpeechRecognitionWithPushStreams();
+extern void KeywordRecognitionModelLoadBenchmark();
+extern void PronunciationAssessmentBatchFromManifest();
+extern void SpeechRecognitionScoringAgainstReferenceTranscripts();
+extern void SpeechContinuousRecognitionWithCustomSpeechDataset();
+extern void SpeechRecognitionEvaluationWithCustomSpeechTestSet();
+extern void SpeechRecognitionWithCompiledPhraseList();
+extern void SpeechRecognitionWithFingerprintCache();
+extern void SpeechRecognitionOfLongFileSplitAtPauses();
+extern void SpeechRecognitionWithCoalescedPushStream();
+extern void SpeechRecognitionOfStereoCallByChannel();
 
 extern void IntentRecognitionWithMicrophone();
 extern void IntentRecognitionWithLanguage();
 extern void IntentContinuousRecognitionWithFile();
+extern void IntentContinuousRecognitionWithLocalPhraseMatcher();
+extern void IntentContinuousRecognitionWithJsonView();
+extern void IntentJsonExtractionBenchmark();
 
 extern void TranslationWithMicrophone();
 extern void TranslationContinuousRecognition();
+extern void TranslationContinuousRecognitionWithFanOut();
 
 extern void SpeechSynthesisToSpeaker();
 extern void SpeechSynthesisWithLanguage();
@@ -36,6 +51,10 @@ extern void SpeechSynthesisToAudioDataStream();
 extern void SpeechSynthesisEvents();
 extern void SpeechSynthesisWordBoundaryEvent();
 extern void SpeechSynthesisWithSourceLanguageAutoDetection();
+extern void SpeechSynthesisStreamingFirstChunk();
+extern void SpeechSynthesisBatchOfShortTexts();
+extern void SpeechSynthesisWordBoundaryIndex();
+extern void SpeechSynthesisToStreamingWaveFile();
 
 extern void ConversationWithPullAudioStream();
 extern void ConversationWithPushAudioStream();
@@ -59,6 +78,17 @@ void SpeechSamples()
         cout << "6.) Speech recognition using push stream input.\n";
         cout << "7.) Speech recognition using microphone with a keyword trigger.\n";
         cout << "8.) Pronunciation assessment using microphone input.\n";
+        cout << "9.) Keyword-gated speech recognition of many push stream feeds.\n";
+        cout << "A.) Benchmark of keyword model loading for many keyword recognizers.\n";
+        cout << "B.) Pronunciation assessment of a batch of recordings listed in a manifest.\n";
+        cout << "C.) Scoring of recognized text against reference transcripts (WER/CER).\n";
+        cout << "D.) Speech continuous recognition of a Custom Speech dataset read from its archive.\n";
+        cout << "E.) Evaluation of accuracy and latency on a Custom Speech testing set.\n";
+        cout << "F.) Speech recognition with a phrase list compiled from Custom Speech training text.\n";
+        cout << "G.) Speech continuous recognition of recordings, answering duplicates from a result cache.\n";
+        cout << "H.) Speech recognition of a long file split at pauses, in parallel sessions.\n";
+        cout << "I.) Speech recognition with small network frames coalesced into larger push stream writes.\n";
+        cout << "J.) Speech recognition of a stereo call, one recognizer per channel, merged by speaker.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -91,6 +121,49 @@ void SpeechSamples()
         case '8':
             PronunciationAssessmentWithMicrophone();
             break;
+        case '9':
+            KeywordGatedSpeechRecognitionWithPushStreams();
+            break;
+        case 'A':
+        case 'a':
+            KeywordRecognitionModelLoadBenchmark();
+            break;
+        case 'B':
+        case 'b':
+            PronunciationAssessmentBatchFromManifest();
+            break;
+        case 'C':
+        case 'c':
+            SpeechRecognitionScoringAgainstReferenceTranscripts();
+            break;
+        case 'D':
+        case 'd':
+            SpeechContinuousRecognitionWithCustomSpeechDataset();
+            break;
+        case 'E':
+        case 'e':
+            SpeechRecognitionEvaluationWithCustomSpeechTestSet();
+            break;
+        case 'F':
+        case 'f':
+            SpeechRecognitionWithCompiledPhraseList();
+            break;
+        case 'G':
+        case 'g':
+            SpeechRecognitionWithFingerprintCache();
+            break;
+        case 'H':
+        case 'h':
+            SpeechRecognitionOfLongFileSplitAtPauses();
+            break;
+        case 'I':
+        case 'i':
+            SpeechRecognitionWithCoalescedPushStream();
+            break;
+        case 'J':
+        case 'j':
+            SpeechRecognitionOfStereoCallByChannel();
+            break;
         case '0':
             break;
         }
@@ -106,6 +179,9 @@ void IntentSamples()
         cout << "1.) Intent recognition with microphone input.\n";
         cout << "2.) Intent recognition in the specified language.\n";
         cout << "3.) Intent continuous recognition with file input.\n";
+        cout << "4.) Intent continuous recognition with local matching of frequent phrasings.\n";
+        cout << "5.) Intent continuous recognition reading intent and entities from the service JSON.\n";
+        cout << "6.) Benchmark of reading intent and entities from a large service JSON.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -123,6 +199,15 @@ void IntentSamples()
         case '3':
             IntentContinuousRecognitionWithFile();
             break;
+        case '4':
+            IntentContinuousRecognitionWithLocalPhraseMatcher();
+            break;
+        case '5':
+            IntentContinuousRecognitionWithJsonView();
+            break;
+        case '6':
+            IntentJsonExtractionBenchmark();
+            break;
         case '0':
             break;
         }
@@ -137,6 +222,7 @@ void TranslationSamples()
         cout << "\nTRANSLATION SAMPLES:\n";
         cout << "1.) Translation with microphone input.\n";
         cout << "2.) Translation continuous recognition.\n";
+        cout << "3.) Translation continuous recognition with per-language caption channels.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -151,6 +237,9 @@ void TranslationSamples()
         case '2':
             TranslationContinuousRecognition();
             break;
+        case '3':
+            TranslationContinuousRecognitionWithFanOut();
+            break;
         case '0':
             break;
         }
@@ -175,6 +264,10 @@ void SpeechSynthesisSamples()
         cout << "A.) Speech synthesis events.\n";
         cout << "B.) Speech synthesis word boundary event.\n";
         cout << "C.) Speech synthesis with source language auto detection\n";
+        cout << "D.) Speech synthesis with low-latency streaming of the first audio chunks.\n";
+        cout << "E.) Speech synthesis of many short texts batched into few requests.\n";
+        cout << "F.) Speech synthesis to wave file with a word boundary index.\n";
+        cout << "G.) Speech synthesis of a long text to a wave file written during synthesis.\n";
         cout << "\nChoice (0 for MAIN MENU): ";
         cout.flush();
 
@@ -222,6 +315,22 @@ void SpeechSynthesisSamples()
         case 'c':
             SpeechSynthesisWithSourceLanguageAutoDetection();
             break;
+        case 'D':
+        case 'd':
+            SpeechSynthesisStreamingFirstChunk();
+            break;
+        case 'E':
+        case 'e':
+            SpeechSynthesisBatchOfShortTexts();
+            break;
+        case 'F':
+        case 'f':
+            SpeechSynthesisWordBoundaryIndex();
+            break;
+        case 'G':
+        case 'g':
+            SpeechSynthesisToStreamingWaveFile();
+            break;
         case '0':
             break;
         }
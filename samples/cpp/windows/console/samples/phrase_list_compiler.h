@@ -0,0 +1,254 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Phrase list compiled by PhraseListCompiler, loaded with two reads into one buffer of phrases and their offsets.
+// Nothing is parsed or normalized at load time, so a list compiled from a large corpus is ready in milliseconds.
+class CompiledPhraseList final
+{
+public:
+    // Loads a phrase list saved with PhraseListCompiler::Save().
+    static CompiledPhraseList Load(const std::string& fileName)
+    {
+        std::ifstream fs(fileName, std::ios_base::binary | std::ios_base::in);
+        if (!fs.good())
+        {
+            throw std::invalid_argument("Failed to open the specified phrase list file.");
+        }
+
+        uint32_t header[4] = {};
+        fs.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!fs.good() || header[0] != magic || header[1] != version)
+        {
+            throw std::runtime_error("Invalid phrase list file header.");
+        }
+
+        CompiledPhraseList list;
+        list.m_offsets.resize(header[2] + 1);
+        list.m_text.resize(header[3]);
+        fs.read(reinterpret_cast<char*>(list.m_offsets.data()), list.m_offsets.size() * sizeof(uint32_t));
+        fs.read(&list.m_text[0], list.m_text.size());
+        if (!fs.good() || list.m_offsets.back() != header[3])
+        {
+            throw std::runtime_error("Unexpected end of file or error when reading phrase list file.");
+        }
+        return list;
+    }
+
+    size_t Size() const
+    {
+        return m_offsets.empty() ? 0 : m_offsets.size() - 1;
+    }
+
+    std::string operator[](size_t index) const
+    {
+        return m_text.substr(m_offsets[index], m_offsets[index + 1] - m_offsets[index]);
+    }
+
+    // Adds all phrases to the phrase list grammar of a recognizer, before recognition starts.
+    void ApplyTo(std::shared_ptr<Microsoft::CognitiveServices::Speech::PhraseListGrammar> grammar) const
+    {
+        for (size_t i = 0; i < Size(); i++)
+        {
+            grammar->AddPhrase((*this)[i]);
+        }
+    }
+
+private:
+    friend class PhraseListCompiler;
+
+    // The file starts with the tag 'PLST', in the byte order of the machine that wrote it.
+    static constexpr uint32_t magic = 0x54534C50;
+    static constexpr uint32_t version = 1;
+
+    std::vector<uint32_t> m_offsets;
+    std::string m_text;
+};
+
+// Compiles the text files of a Custom Speech training set into a phrase list.
+// The written forms of pronunciation.txt and the sentences of related-text.txt are normalized (byte order mark
+// removed, white space collapsed, trailing punctuation dropped) and deduplicated ignoring ASCII case, then saved
+// in the binary format loaded by CompiledPhraseList.
+class PhraseListCompiler final
+{
+public:
+    // Adds the written form of each entry of a pronunciation file: the text before the tab on each line.
+    // The spoken forms cannot be applied through phrase lists and are only used by model training.
+    void AddPronunciationFile(const std::string& fileName)
+    {
+        ForEachLine(fileName, [this](const std::string& line)
+        {
+            AddPhrase(line.substr(0, line.find('\t')));
+        });
+    }
+
+    // Adds each sentence of a related text file, splitting lines after sentence-ending punctuation.
+    void AddRelatedTextFile(const std::string& fileName)
+    {
+        ForEachLine(fileName, [this](const std::string& line)
+        {
+            size_t begin = 0;
+            for (size_t i = 0; i < line.size(); i++)
+            {
+                auto end = SentenceEnd(line, i);
+                if (end != 0)
+                {
+                    AddPhrase(line.substr(begin, end - begin));
+                    begin = end;
+                    i = end - 1;
+                }
+            }
+            AddPhrase(line.substr(begin));
+        });
+    }
+
+    // Adds a phrase, unless it is empty after normalization or already added.
+    void AddPhrase(const std::string& phrase)
+    {
+        auto normalized = Normalize(phrase);
+        if (normalized.empty())
+        {
+            return;
+        }
+
+        auto key = normalized;
+        for (auto& c : key)
+        {
+            if (c >= 'A' && c <= 'Z')
+            {
+                c = static_cast<char>(c - 'A' + 'a');
+            }
+        }
+        if (m_keys.insert(key).second)
+        {
+            m_list.m_offsets.push_back(static_cast<uint32_t>(m_list.m_text.size()));
+            m_list.m_text += normalized;
+        }
+    }
+
+    size_t GetPhraseCount() const
+    {
+        return m_list.m_offsets.size();
+    }
+
+    // Gets the compiled list, as it would be loaded from a saved file.
+    CompiledPhraseList GetCompiledList() const
+    {
+        auto list = m_list;
+        list.m_offsets.push_back(static_cast<uint32_t>(list.m_text.size()));
+        return list;
+    }
+
+    void Save(const std::string& fileName) const
+    {
+        std::ofstream fs(fileName, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+        if (!fs.good())
+        {
+            throw std::invalid_argument("Failed to open the specified phrase list file.");
+        }
+
+        auto list = GetCompiledList();
+        uint32_t header[4] = { CompiledPhraseList::magic, CompiledPhraseList::version, static_cast<uint32_t>(list.Size()), static_cast<uint32_t>(list.m_text.size()) };
+        fs.write(reinterpret_cast<const char*>(header), sizeof(header));
+        fs.write(reinterpret_cast<const char*>(list.m_offsets.data()), list.m_offsets.size() * sizeof(uint32_t));
+        fs.write(list.m_text.data(), list.m_text.size());
+        fs.close();
+        if (!fs.good())
+        {
+            throw std::runtime_error("Error when writing phrase list file.");
+        }
+    }
+
+private:
+    template<class Visit>
+    static void ForEachLine(const std::string& fileName, Visit visit)
+    {
+        std::ifstream fs(fileName);
+        if (!fs.good())
+        {
+            throw std::invalid_argument("Failed to open the specified text file.");
+        }
+
+        std::string line;
+        bool first = true;
+        while (std::getline(fs, line))
+        {
+            if (first && line.compare(0, 3, "\xEF\xBB\xBF") == 0)
+            {
+                line.erase(0, 3);
+            }
+            first = false;
+            visit(line);
+        }
+    }
+
+    // Returns the position after the sentence ending at position i of the line, or 0 if no sentence ends there.
+    // ASCII terminators must be followed by white space, so "3.5" and "www.microsoft.com" are not split.
+    static size_t SentenceEnd(const std::string& line, size_t i)
+    {
+        auto c = line[i];
+        if (c == '.' || c == '?' || c == '!')
+        {
+            return i + 1 == line.size() || line[i + 1] == ' ' || line[i + 1] == '\t' ? i + 1 : 0;
+        }
+
+        // Ideographic full stop, full-width question and exclamation marks.
+        static const char* const terminators[] = { "\xE3\x80\x82", "\xEF\xBC\x9F", "\xEF\xBC\x81" };
+        for (auto terminator : terminators)
+        {
+            if (line.compare(i, 3, terminator) == 0)
+            {
+                return i + 3;
+            }
+        }
+        return 0;
+    }
+
+    static std::string Normalize(const std::string& phrase)
+    {
+        std::string normalized;
+        bool pendingSpace = false;
+        for (auto c : phrase)
+        {
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            {
+                pendingSpace = !normalized.empty();
+                continue;
+            }
+            if (pendingSpace)
+            {
+                normalized += ' ';
+                pendingSpace = false;
+            }
+            normalized += c;
+        }
+
+        while (!normalized.empty() && normalized.back() != '\0' && strchr(".,;:?!", normalized.back()) != nullptr)
+        {
+            normalized.pop_back();
+        }
+        for (auto terminator : { "\xE3\x80\x82", "\xEF\xBC\x9F", "\xEF\xBC\x81", "\xEF\xBC\x8C", "\xE3\x80\x81" })
+        {
+            if (normalized.size() >= 3 && normalized.compare(normalized.size() - 3, 3, terminator) == 0)
+            {
+                normalized.erase(normalized.size() - 3);
+                break;
+            }
+        }
+        return normalized;
+    }
+
+    CompiledPhraseList m_list;
+    std::unordered_set<std::string> m_keys;
+};
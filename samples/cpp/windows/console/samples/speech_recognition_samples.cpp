@@ -6,9 +6,28 @@
 #include "stdafx.h"
 
 // <toplevel>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
 #include <speechapi_cxx.h>
 #include <fstream>
 #include "wav_file_reader.h"
+#include "audio_fingerprint_cache.h"
+#include "channel_split_transcriber.h"
+#include "coalescing_push_stream.h"
+#include "evaluation_harness.h"
+#include "keyword_gate.h"
+#include "keyword_model_registry.h"
+#include "long_file_transcriber.h"
+#include "phrase_list_compiler.h"
+#include "json_view.h"
+#include "transcript_scorer.h"
+#include "worker_pool.h"
+#include "zip_dataset_reader.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -503,6 +522,136 @@ void KeywordTriggeredSpeechRecognitionWithMicrophone()
     recognizer->StopKeywordRecognitionAsync().get();
 }
 
+// Keyword-gated speech recognition of many push stream feeds sharing one keyword model.
+void KeywordGatedSpeechRecognitionWithPushStreams()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Gets the keyword recognition model handle from the process-wide registry, so all feeds refer to the same model.
+    // Update this to point to the location of your keyword recognition model.
+    auto model = KeywordModelRegistry::Instance().Get("YourKeywordRecognitionModelFile.table");
+
+    // Spots the keyword on 8 feeds, with at most 4 cloud sessions open at the same time.
+    const size_t feedCount = 8;
+    mutex outputMutex;
+    KeywordGate gate(config, model, feedCount, 4, [&outputMutex](size_t feed, shared_ptr<SpeechRecognitionResult> result)
+    {
+        lock_guard<mutex> lock(outputMutex);
+        if (result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "Feed " << feed << " RECOGNIZED: Text=" << result->Text << std::endl;
+        }
+        else if (result->Reason == ResultReason::NoMatch)
+        {
+            cout << "Feed " << feed << " NOMATCH: Speech could not be recognized." << std::endl;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = CancellationDetails::FromResult(result);
+            cout << "Feed " << feed << " CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+        }
+    });
+    gate.Start();
+
+    // Simulates the feeds with a wav file each, in real time (100ms per write).
+    // Replace with your own audio sources, e.g. network streams, and files that start with your keyword.
+    vector<thread> feeds;
+    for (size_t feed = 0; feed < feedCount; feed++)
+    {
+        feeds.emplace_back([&gate, feed]()
+        {
+            WavFileReader reader("whatstheweatherlike.wav");
+            vector<uint8_t> buffer(3200);
+            int readBytes = 0;
+            while ((readBytes = reader.Read(buffer.data(), (uint32_t)buffer.size())) != 0)
+            {
+                gate.Write(feed, buffer.data(), readBytes);
+                this_thread::sleep_for(chrono::milliseconds(100));
+            }
+        });
+    }
+
+    for (auto& feed : feeds)
+    {
+        feed.join();
+    }
+
+    gate.Stop();
+    cout << "Keyword fired " << gate.GetKeywordCount() << " times on " << feedCount << " feeds." << std::endl;
+}
+
+// Gets the resident memory of the process in bytes.
+static size_t GetResidentMemoryBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.WorkingSetSize : 0;
+#else
+    size_t totalPages = 0;
+    size_t residentPages = 0;
+    ifstream statm("/proc/self/statm");
+    statm >> totalPages >> residentPages;
+    return residentPages * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// Measures the cold start time and resident memory of 1, 10 and 100 keyword recognizers,
+// creating a keyword model handle per recognizer versus sharing one handle through the model registry.
+// Each recognizer loads the keyword table when its recognition starts in both cases, so the difference
+// measured is only the cost of creating the handles, which is small next to the cost of the table itself.
+// Memory freed by a pass is not always given back to the system before the next pass is measured, which
+// favors the pass that runs second; each comparison is therefore run in both orders, and both are reported.
+void KeywordRecognitionModelLoadBenchmark()
+{
+    // Update this to point to the location of your keyword recognition model.
+    auto modelFile = "YourKeywordRecognitionModelFile.table";
+
+    auto measure = [modelFile](size_t count, bool shared, const char* position)
+    {
+        vector<shared_ptr<PushAudioInputStream>> streams;
+        vector<shared_ptr<KeywordRecognizer>> recognizers;
+        vector<future<shared_ptr<KeywordRecognitionResult>>> recognitions;
+
+        auto memoryBefore = GetResidentMemoryBytes();
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i++)
+        {
+            auto model = shared ? KeywordModelRegistry::Instance().Get(modelFile) : KeywordRecognitionModel::FromFile(modelFile);
+            auto stream = AudioInputStream::CreatePushStream();
+            auto recognizer = KeywordRecognizer::FromConfig(AudioConfig::FromStreamInput(stream));
+            recognitions.push_back(recognizer->RecognizeOnceAsync(model));
+            streams.push_back(stream);
+            recognizers.push_back(recognizer);
+        }
+        auto elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        auto memoryAfter = GetResidentMemoryBytes();
+
+        cout << count << " keyword recognizers, " << (shared ? "shared model handle" : "model handle per recognizer") << " (" << position << "): "
+             << elapsedMs << "ms cold start, "
+             << (memoryAfter > memoryBefore ? (memoryAfter - memoryBefore) / count / 1024 : 0) << "KB resident memory per feed." << std::endl;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            recognizers[i]->StopRecognitionAsync().get();
+            streams[i]->Close();
+            recognitions[i].get();
+        }
+    };
+
+    for (size_t count : { 1, 10, 100 })
+    {
+        for (bool sharedFirst : { false, true })
+        {
+            measure(count, sharedFirst, "run first");
+            measure(count, !sharedFirst, "run second");
+        }
+    }
+
+    cout << "Model handle created " << KeywordModelRegistry::Instance().GetHandleCount() << " times through the registry." << std::endl;
+}
+
 // Speech recognition with auto detection for source language
 void SpeechRecognitionWithSourceLanguageAutoDetection()
 {
@@ -698,3 +847,741 @@ void PronunciationAssessmentWithMicrophone()
         }
     }
 }
+
+// Pronunciation assessment of many recorded attempts listed in a manifest.
+// Each line of the manifest is the path of a wav file, a tab, and the reference text.
+// Word and phoneme level scores are written as tab-separated columns, one row per phoneme.
+void PronunciationAssessmentBatchFromManifest()
+{
+    // Pull audio input stream callback reading audio data from a wav file.
+    class AudioInputFromFileCallback final : public PullAudioInputStreamCallback
+    {
+    public:
+        AudioInputFromFileCallback(const string& audioFileName)
+            : m_reader(audioFileName)
+        {
+        }
+
+        int Read(uint8_t* dataBuffer, uint32_t size) override
+        {
+            return m_reader.Read(dataBuffer, size);
+        }
+
+        void Close() override
+        {
+            m_reader.Close();
+        }
+
+    private:
+        WavFileReader m_reader;
+    };
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    // Note: The pronunciation assessment feature is currently only available on westus, eastasia and centralindia regions.
+    // And this feature is currently only available on en-US language.
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Replace with your own manifest and output file names, and the number of concurrent assessments.
+    auto manifestFileName = "pronunciation_manifest.tsv";
+    auto outputFileName = "pronunciation_scores.tsv";
+    const size_t concurrency = 8;
+
+    ifstream manifest(manifestFileName);
+    if (!manifest.good())
+    {
+        cout << "Failed to open the manifest file [" << manifestFileName << "]" << std::endl;
+        return;
+    }
+
+    vector<pair<string, string>> attempts;
+    string line;
+    while (getline(manifest, line))
+    {
+        auto tab = line.find('\t');
+        if (tab != string::npos)
+        {
+            attempts.emplace_back(line.substr(0, tab), line.substr(tab + 1));
+        }
+    }
+
+    ofstream output(outputFileName);
+    output << "item\tfile\tword_index\tword\tword_accuracy\terror_type\tphoneme\tphoneme_accuracy\n";
+
+    // One assessment config per distinct reference text, shared by all attempts of that text.
+    map<string, shared_ptr<PronunciationAssessmentConfig>> pronunciationConfigs;
+    mutex batchMutex;
+    size_t assessed = 0;
+    size_t failed = 0;
+
+    auto start = chrono::steady_clock::now();
+    {
+        WorkerPool pool(concurrency);
+        for (size_t item = 0; item < attempts.size(); item++)
+        {
+            pool.Post([&, item]()
+            {
+                const auto& fileName = attempts[item].first;
+                const auto& referenceText = attempts[item].second;
+
+                shared_ptr<PronunciationAssessmentConfig> pronunciationConfig;
+                {
+                    lock_guard<mutex> lock(batchMutex);
+                    auto& cached = pronunciationConfigs[referenceText];
+                    if (!cached)
+                    {
+                        cached = PronunciationAssessmentConfig::Create(referenceText,
+                            PronunciationAssessmentGradingSystem::HundredMark,
+                            PronunciationAssessmentGranularity::Phoneme, true);
+                    }
+                    pronunciationConfig = cached;
+                }
+
+                shared_ptr<SpeechRecognitionResult> result;
+                try
+                {
+                    auto callback = make_shared<AudioInputFromFileCallback>(fileName);
+                    auto audioInput = AudioConfig::FromStreamInput(AudioInputStream::CreatePullStream(callback));
+                    auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+                    pronunciationConfig->ApplyTo(recognizer);
+                    result = recognizer->RecognizeOnceAsync().get();
+                }
+                catch (const exception& e)
+                {
+                    lock_guard<mutex> lock(batchMutex);
+                    cout << "Item " << item << " [" << fileName << "]: " << e.what() << std::endl;
+                    failed++;
+                    return;
+                }
+
+                if (result->Reason != ResultReason::RecognizedSpeech)
+                {
+                    lock_guard<mutex> lock(batchMutex);
+                    cout << "Item " << item << " [" << fileName << "]: not recognized, reason=" << (int)result->Reason << std::endl;
+                    failed++;
+                    return;
+                }
+
+                // The word and phoneme scores are only available in the JSON result.
+                auto json = result->Properties.GetProperty(PropertyId::SpeechServiceResponse_JsonResult);
+                string rows;
+                size_t wordIndex = 0;
+                JsonView(json)["NBest"].ForEachElement([&](const JsonView& best)
+                {
+                    best["Words"].ForEachElement([&](const JsonView& word)
+                    {
+                        auto wordAssessment = word["PronunciationAssessment"];
+                        auto wordColumns = to_string(item) + "\t" + fileName + "\t" + to_string(wordIndex) + "\t"
+                            + word["Word"].AsString().ToString() + "\t"
+                            + to_string(wordAssessment["AccuracyScore"].AsNumber()) + "\t"
+                            + wordAssessment["ErrorType"].AsString().ToString() + "\t";
+
+                        bool hasPhonemes = false;
+                        word["Phonemes"].ForEachElement([&](const JsonView& phoneme)
+                        {
+                            rows += wordColumns + phoneme["Phoneme"].AsString().ToString() + "\t"
+                                + to_string(phoneme["PronunciationAssessment"]["AccuracyScore"].AsNumber()) + "\n";
+                            hasPhonemes = true;
+                            return true;
+                        });
+                        if (!hasPhonemes)
+                        {
+                            rows += wordColumns + "\t\n";
+                        }
+                        wordIndex++;
+                        return true;
+                    });
+                    // Only the best hypothesis is assessed.
+                    return false;
+                });
+
+                lock_guard<mutex> lock(batchMutex);
+                output << rows;
+                assessed++;
+            });
+        }
+        pool.WaitIdle();
+    }
+    auto elapsedSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << assessed << " attempts assessed, " << failed << " failed, " << pronunciationConfigs.size() << " distinct reference texts, "
+         << (elapsedSeconds > 0 ? assessed / elapsedSeconds : 0) << " assessments per second." << std::endl;
+    cout << "Scores written to [" << outputFileName << "]" << std::endl;
+}
+
+// Reads a transcript file in the Custom Speech format: one line per audio file, with the file name, a tab and the text.
+static map<string, string> ReadTranscriptFile(const string& fileName)
+{
+    map<string, string> transcripts;
+    ifstream file(fileName);
+    string line;
+    while (getline(file, line))
+    {
+        // Transcript files are usually saved with a byte order mark.
+        if (transcripts.empty() && line.compare(0, 3, "\xEF\xBB\xBF") == 0)
+        {
+            line.erase(0, 3);
+        }
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+
+        auto tab = line.find('\t');
+        if (tab != string::npos)
+        {
+            transcripts[line.substr(0, tab)] = line.substr(tab + 1);
+        }
+    }
+    return transcripts;
+}
+
+// Scoring of recognized text against the reference transcripts of a Custom Speech testing set,
+// as word error rate, or character error rate for Chinese and Japanese.
+void SpeechRecognitionScoringAgainstReferenceTranscripts()
+{
+    // Replace with the locale of the testing set, its reference transcript file (e.g. trans.txt extracted from
+    // sampledata/customspeech/en-US/testing/audio-and-trans.zip), and a file with the recognized text in the same format.
+    auto locale = "en-US";
+    auto referenceFileName = "trans.txt";
+    auto hypothesisFileName = "recognized.txt";
+
+    auto references = ReadTranscriptFile(referenceFileName);
+    auto hypotheses = ReadTranscriptFile(hypothesisFileName);
+    if (references.empty())
+    {
+        cout << "No reference transcripts found in [" << referenceFileName << "]" << std::endl;
+        return;
+    }
+
+    // Audio files without recognized text are scored as all deletions.
+    vector<string> names;
+    vector<pair<string, string>> pairs;
+    for (const auto& reference : references)
+    {
+        auto hypothesis = hypotheses.find(reference.first);
+        names.push_back(reference.first);
+        pairs.emplace_back(reference.second, hypothesis == hypotheses.end() ? string() : hypothesis->second);
+    }
+
+    TranscriptScorer scorer(TranscriptScorer::UnitForLocale(locale));
+    auto unitName = TranscriptScorer::UnitForLocale(locale) == TranscriptScorer::Unit::Character ? "CER" : "WER";
+
+    auto start = chrono::steady_clock::now();
+    auto scores = scorer.ScoreAll(pairs, thread::hardware_concurrency());
+    auto elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    for (size_t i = 0; i < scores.size(); i++)
+    {
+        const auto& score = scores[i];
+        cout << names[i] << ": " << score.Errors() << " errors in " << score.ReferenceTokens.size() << " tokens"
+             << " (S=" << score.Substitutions << ", D=" << score.Deletions << ", I=" << score.Insertions << ")" << std::endl;
+
+        for (const auto& step : score.Alignment)
+        {
+            switch (step.Operation)
+            {
+            case 'S':
+                cout << "  S: " << score.ReferenceTokens[step.Reference] << " -> " << score.HypothesisTokens[step.Hypothesis] << std::endl;
+                break;
+            case 'D':
+                cout << "  D: " << score.ReferenceTokens[step.Reference] << std::endl;
+                break;
+            case 'I':
+                cout << "  I: " << score.HypothesisTokens[step.Hypothesis] << std::endl;
+                break;
+            }
+        }
+    }
+
+    auto totals = TranscriptScorer::Sum(scores);
+    cout << unitName << ": " << totals.ErrorRate() * 100 << "% over " << scores.size() << " utterances, " << totals.ReferenceTokens << " tokens"
+         << " (S=" << totals.Substitutions << ", D=" << totals.Deletions << ", I=" << totals.Insertions << "), scored in " << elapsedMs << " ms." << std::endl;
+}
+
+// Speech continuous recognition of a Custom Speech dataset read straight from its archive, without extracting it.
+void SpeechContinuousRecognitionWithCustomSpeechDataset()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Replace with the archive of a dataset, e.g. sampledata/customspeech/en-US/testing/audio-and-trans.zip, and its language.
+    auto archiveFileName = "audio-and-trans.zip";
+    config->SetSpeechRecognitionLanguage("en-US");
+
+    CustomSpeechDataset dataset(archiveFileName);
+    cout << dataset.GetItems().size() << " audio files in [" << archiveFileName << "]" << std::endl;
+
+    for (const auto& item : dataset.GetItems())
+    {
+        // Each audio file is inflated from the archive as the recognizer pulls it.
+        auto callback = dataset.OpenAudio(item);
+        auto format = AudioStreamFormat::GetWaveFormatPCM(callback->GetSamplesPerSecond(), callback->GetBitsPerSample(), callback->GetChannels());
+        auto audioInput = AudioConfig::FromStreamInput(AudioInputStream::CreatePullStream(format, callback));
+        auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+
+        // Promise for synchronization of recognition end.
+        promise<void> recognitionEnd;
+        string recognizedText;
+
+        recognizer->Recognized.Connect([&recognizedText](const SpeechRecognitionEventArgs& e)
+        {
+            if (e.Result->Reason == ResultReason::RecognizedSpeech)
+            {
+                recognizedText += (recognizedText.empty() ? "" : " ") + e.Result->Text;
+            }
+        });
+
+        recognizer->Canceled.Connect([](const SpeechRecognitionCanceledEventArgs& e)
+        {
+            if (e.Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << "\n"
+                     << "CANCELED: ErrorDetails=" << e.ErrorDetails << "\n"
+                     << "CANCELED: Did you update the subscription info?" << std::endl;
+            }
+        });
+
+        recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
+        {
+            recognitionEnd.set_value(); // Notify to stop recognition.
+        });
+
+        recognizer->StartContinuousRecognitionAsync().get();
+        recognitionEnd.get_future().get();
+        recognizer->StopContinuousRecognitionAsync().get();
+
+        cout << item.Audio->Name << ":" << std::endl;
+        cout << "  REFERENCE:  " << item.Transcript << std::endl;
+        cout << "  RECOGNIZED: " << recognizedText << std::endl;
+        if (callback->HasFailed())
+        {
+            cout << "  The audio could not be read completely from the archive." << std::endl;
+        }
+    }
+}
+
+// Evaluation of recognition accuracy and speed on a Custom Speech testing set, replayed at a multiple of real time
+// through many concurrent sessions and scored against the reference transcripts.
+void SpeechRecognitionEvaluationWithCustomSpeechTestSet()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    // To evaluate another endpoint, e.g. a speech container running on this machine, create the config with
+    // SpeechConfig::FromEndpoint("ws://localhost:5000/speech/recognition/conversation/cognitiveservices/v1", "") instead.
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Replace with the locale and the testing archive to evaluate, e.g. sampledata/customspeech/en-US/testing/audio-and-trans.zip.
+    auto locale = "en-US";
+    auto archiveFileName = "audio-and-trans.zip";
+    config->SetSpeechRecognitionLanguage(locale);
+
+    EvaluationHarness::Options options;
+    options.MaxSessions = 8;
+    options.Speed = 4.0;
+    options.Repetitions = 8;
+
+    CustomSpeechDataset dataset(archiveFileName);
+    EvaluationHarness harness(config, options);
+
+    auto start = chrono::steady_clock::now();
+    auto results = harness.Run(dataset);
+    auto elapsedSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // Failed utterances are scored with the text recognized before the failure.
+    vector<pair<string, string>> pairs;
+    vector<double> phraseLatencies;
+    vector<double> finalLatencies;
+    double audioSeconds = 0;
+    double realTimeFactors = 0;
+    size_t failed = 0;
+    for (const auto& result : results)
+    {
+        pairs.emplace_back(result.Reference, result.Recognized);
+        phraseLatencies.insert(phraseLatencies.end(), result.PhraseLatenciesMs.begin(), result.PhraseLatenciesMs.end());
+        finalLatencies.push_back(result.FinalLatencyMs);
+        audioSeconds += result.AudioSeconds;
+        realTimeFactors += result.RealTimeFactor();
+        if (result.Failed)
+        {
+            cout << result.Name << ": FAILED: " << result.Error << std::endl;
+            failed++;
+        }
+    }
+
+    TranscriptScorer scorer(TranscriptScorer::UnitForLocale(locale));
+    auto totals = TranscriptScorer::Sum(scorer.ScoreAll(pairs, thread::hardware_concurrency()));
+    auto unitName = TranscriptScorer::UnitForLocale(locale) == TranscriptScorer::Unit::Character ? "CER" : "WER";
+
+    cout << results.size() << " utterances, " << failed << " failed, " << options.MaxSessions << " sessions at "
+         << options.Speed << "x real time." << std::endl;
+    cout << unitName << ": " << totals.ErrorRate() * 100 << "% (S=" << totals.Substitutions << ", D=" << totals.Deletions
+         << ", I=" << totals.Insertions << ", N=" << totals.ReferenceTokens << ")" << std::endl;
+    cout << "Phrase latency: p50=" << EvaluationHarness::Percentile(phraseLatencies, 0.5) << " ms, p90="
+         << EvaluationHarness::Percentile(phraseLatencies, 0.9) << " ms, p99=" << EvaluationHarness::Percentile(phraseLatencies, 0.99) << " ms" << std::endl;
+    cout << "Final latency: p50=" << EvaluationHarness::Percentile(finalLatencies, 0.5) << " ms, p90="
+         << EvaluationHarness::Percentile(finalLatencies, 0.9) << " ms" << std::endl;
+    cout << "Mean RTF: " << (results.empty() ? 0 : realTimeFactors / results.size()) << ", "
+         << (elapsedSeconds > 0 ? audioSeconds / elapsedSeconds : 0) << " seconds of audio per second." << std::endl;
+}
+
+// Speech recognition with a phrase list compiled from Custom Speech training text, and a benchmark of
+// loading the compiled list against compiling it from the text files at every start.
+void SpeechRecognitionWithCompiledPhraseList()
+{
+    // Replace with the text files of your training set, e.g. from sampledata/customspeech/en-US/training,
+    // and the file the compiled phrase list is saved to.
+    auto pronunciationFileName = "pronunciation.txt";
+    auto relatedTextFileName = "related-text.txt";
+    auto phraseListFileName = "phrases.bin";
+    const int iterations = 10;
+
+    // Compiles the text files, as an application would have to at every start without a compiled list.
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        PhraseListCompiler compiler;
+        compiler.AddPronunciationFile(pronunciationFileName);
+        compiler.AddRelatedTextFile(relatedTextFileName);
+        if (i == 0)
+        {
+            compiler.Save(phraseListFileName);
+        }
+    }
+    auto compileMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / iterations;
+
+    start = chrono::steady_clock::now();
+    CompiledPhraseList phrases;
+    for (int i = 0; i < iterations; i++)
+    {
+        phrases = CompiledPhraseList::Load(phraseListFileName);
+    }
+    auto loadMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / iterations;
+
+    cout << phrases.Size() << " phrases. Compiling from text: " << compileMs << " ms, loading compiled list: " << loadMs << " ms." << std::endl;
+
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a speech recognizer using file as audio input.
+    // Replace with your own audio file name.
+    auto audioInput = AudioConfig::FromWavFileInput("whatstheweatherlike.wav");
+    auto recognizer = SpeechRecognizer::FromConfig(config, audioInput);
+
+    // The phrases are added when the recognizer is created, before recognition starts.
+    start = chrono::steady_clock::now();
+    phrases.ApplyTo(PhraseListGrammar::FromRecognizer(recognizer));
+    auto applyMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "Phrase list applied in " << applyMs << " ms." << std::endl;
+
+    auto result = recognizer->RecognizeOnceAsync().get();
+
+    // Checks result.
+    if (result->Reason == ResultReason::RecognizedSpeech)
+    {
+        cout << "RECOGNIZED: Text=" << result->Text << std::endl;
+    }
+    else if (result->Reason == ResultReason::NoMatch)
+    {
+        cout << "NOMATCH: Speech could not be recognized." << std::endl;
+    }
+    else if (result->Reason == ResultReason::Canceled)
+    {
+        auto cancellation = CancellationDetails::FromResult(result);
+        cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+        if (cancellation->Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << cancellation->ErrorDetails << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    }
+}
+
+// Speech continuous recognition of recordings listed in a manifest, answering duplicates from a cache of results
+// keyed on a fingerprint of their audio content. The cache is saved, so duplicates of earlier runs are found too.
+void SpeechRecognitionWithFingerprintCache()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Replace with your own manifest, listing one wav file per line, and the file the cache is saved to.
+    auto manifestFileName = "recordings.txt";
+    auto cacheFileName = "recognition_cache.bin";
+
+    RecognitionResultCache cache;
+    if (cache.Load(cacheFileName))
+    {
+        cout << cache.Size() << " recordings in the cache." << std::endl;
+    }
+
+    ifstream manifest(manifestFileName);
+    if (!manifest.good())
+    {
+        cout << "Failed to open the manifest " << manifestFileName << std::endl;
+        return;
+    }
+
+    double fingerprintMs = 0;
+    double recognizedAudioSeconds = 0;
+    string fileName;
+    while (getline(manifest, fileName))
+    {
+        if (!fileName.empty() && fileName.back() == '\r')
+        {
+            fileName.pop_back();
+        }
+        if (fileName.empty())
+        {
+            continue;
+        }
+
+        AudioFingerprint fingerprint;
+        try
+        {
+            auto start = chrono::steady_clock::now();
+            fingerprint = AudioFingerprinter::FromWavFile(fileName);
+            fingerprintMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        }
+        catch (const exception& e)
+        {
+            cout << fileName << ": " << e.what() << std::endl;
+            continue;
+        }
+
+        vector<RecognitionResultCache::Phrase> phrases;
+        bool cached = cache.TryGet(fingerprint, phrases);
+        if (!cached)
+        {
+            auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromWavFileInput(fileName));
+
+            // Promise for synchronization of recognition end.
+            promise<void> recognitionEnd;
+            bool failed = false;
+
+            recognizer->Recognized.Connect([&phrases](const SpeechRecognitionEventArgs& e)
+            {
+                if (e.Result->Reason == ResultReason::RecognizedSpeech)
+                {
+                    RecognitionResultCache::Phrase phrase;
+                    phrase.Offset = e.Result->Offset();
+                    phrase.Duration = e.Result->Duration();
+                    phrase.Text = e.Result->Text;
+                    phrases.push_back(phrase);
+                }
+            });
+
+            recognizer->Canceled.Connect([&failed](const SpeechRecognitionCanceledEventArgs& e)
+            {
+                if (e.Reason == CancellationReason::Error)
+                {
+                    failed = true;
+                    cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << "\n"
+                         << "CANCELED: ErrorDetails=" << e.ErrorDetails << "\n"
+                         << "CANCELED: Did you update the subscription info?" << std::endl;
+                }
+            });
+
+            recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
+            {
+                recognitionEnd.set_value(); // Notify to stop recognition.
+            });
+
+            recognizer->StartContinuousRecognitionAsync().get();
+            recognitionEnd.get_future().get();
+            recognizer->StopContinuousRecognitionAsync().get();
+
+            // Results of failed sessions are incomplete, and not cached.
+            if (failed)
+            {
+                continue;
+            }
+            cache.Add(fingerprint, phrases);
+            recognizedAudioSeconds += static_cast<double>(fingerprint.LeadingSamples + fingerprint.SampleCount) / fingerprint.SamplesPerSecond;
+        }
+
+        cout << fileName << (cached ? " (cached):" : ":") << std::endl;
+        for (const auto& phrase : phrases)
+        {
+            // Offsets are in ticks of 100 ns.
+            cout << "  [" << phrase.Offset / 10000000.0 << " s] " << phrase.Text << std::endl;
+        }
+    }
+
+    cache.Save(cacheFileName);
+    cout << "Cache hits: " << cache.GetHitCount() << ", misses: " << cache.GetMissCount()
+         << ". Audio recognized: " << recognizedAudioSeconds << " s, saved: " << cache.GetSavedAudioSeconds()
+         << " s. Fingerprinting took " << fingerprintMs << " ms." << std::endl;
+}
+
+// Speech recognition of a long file split at pauses into chunks, recognized in parallel sessions and stitched into
+// one transcript on the timeline of the file. The turnaround time drops with the number of parallel sessions,
+// where continuous recognition of the whole file in one session takes about as long as the file plays.
+void SpeechRecognitionOfLongFileSplitAtPauses()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Replace with your own long 16-bit PCM wav file, and the number of sessions your subscription allows at once.
+    auto fileName = "long_recording.wav";
+    LongFileTranscriber::Options options;
+    options.MaxSessions = 8;
+
+    LongFileTranscriber transcriber(config, options);
+    auto start = chrono::steady_clock::now();
+    LongFileTranscriber::Transcript transcript;
+    try
+    {
+        transcript = transcriber.Transcribe(fileName);
+    }
+    catch (const exception& e)
+    {
+        // E.g. a missing file, or one that is not 16-bit PCM.
+        cout << fileName << ": " << e.what() << std::endl;
+        return;
+    }
+    auto wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    for (const auto& phrase : transcript.Phrases)
+    {
+        // Offsets are in ticks of 100 ns.
+        cout << "[" << phrase.Offset / 10000000.0 << " s] " << phrase.Text << std::endl;
+    }
+
+    size_t cutOutsidePauses = 0;
+    for (const auto& chunk : transcript.Chunks)
+    {
+        cutOutsidePauses += chunk.CutAtPause ? 0 : 1;
+        if (chunk.Failed)
+        {
+            cout << "CANCELED: chunk at byte " << chunk.Begin << ": ErrorDetails=" << chunk.Error << std::endl;
+        }
+    }
+
+    cout << transcript.AudioSeconds << " s of audio in " << transcript.Chunks.size() << " chunks ("
+         << cutOutsidePauses << " cut outside pauses), transcribed in " << wallSeconds << " s with "
+         << options.MaxSessions << " sessions, " << transcript.AudioSeconds / wallSeconds << "x real time." << std::endl;
+}
+
+// Speech recognition from a push stream fed the way a telephony gateway receives audio, one 20 ms frame of 640 bytes
+// at a time, through an adapter that coalesces the frames into fewer, larger writes to the stream.
+// The adapter reports how many stream writes were saved and how much latency the buffering added.
+void SpeechRecognitionWithCoalescedPushStream()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a push stream with the default format, 16 kHz 16-bit mono PCM.
+    auto pushStream = AudioInputStream::CreatePushStream();
+    auto recognizer = SpeechRecognizer::FromConfig(config, AudioConfig::FromStreamInput(pushStream));
+
+    // Promise for synchronization of recognition end.
+    promise<void> recognitionEnd;
+
+    recognizer->Recognized.Connect([](const SpeechRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::RecognizedSpeech)
+        {
+            cout << "RECOGNIZED: Text=" << e.Result->Text << std::endl;
+        }
+    });
+
+    recognizer->Canceled.Connect([](const SpeechRecognitionCanceledEventArgs& e)
+    {
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << "\n"
+                 << "CANCELED: ErrorDetails=" << e.ErrorDetails << "\n"
+                 << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    });
+
+    recognizer->SessionStopped.Connect([&recognitionEnd](const SessionEventArgs& e)
+    {
+        recognitionEnd.set_value(); // Notify to stop recognition.
+    });
+
+    // Writes of three frames (60 ms), holding audio no longer than 100 ms. A block is full at its third frame, 40 ms
+    // after its first, so at real time blocks are written full rather than at the timeout. Smaller values cut the lag,
+    // larger ones the writes; blocks longer than the latency bound are never filled when audio arrives at real time.
+    CoalescingPushStream::Options options;
+    options.BlockBytes = 1920;
+    options.MaxLatencyMs = 100;
+
+    recognizer->StartContinuousRecognitionAsync().get();
+    {
+        CoalescingPushStream stream(pushStream, options);
+        WavFileReader reader("whatstheweatherlike.wav");
+        // 20 ms of 16 kHz 16-bit mono audio.
+        vector<uint8_t> frame(640);
+        auto start = chrono::steady_clock::now();
+        int readBytes = 0;
+        for (int frames = 0; (readBytes = reader.Read(frame.data(), (uint32_t)frame.size())) != 0; frames++)
+        {
+            // Frames arrive every 20 ms.
+            this_thread::sleep_until(start + chrono::milliseconds(20 * frames));
+            stream.Write(frame.data(), readBytes);
+        }
+        stream.Close();
+
+        auto statistics = stream.GetStatistics();
+        cout << statistics.Writes << " frames written in " << statistics.StreamWrites << " stream writes ("
+             << statistics.FullBlockFlushes << " full, " << statistics.SilenceFlushes << " at silence, "
+             << statistics.TimeoutFlushes << " at timeout), " << statistics.StreamWriteMs << " ms in Write()." << std::endl;
+        cout << "Added latency: average " << statistics.AverageAddedLatencyMs << " ms, max "
+             << statistics.MaxAddedLatencyMs << " ms." << std::endl;
+    }
+
+    // Waits for recognition end.
+    recognitionEnd.get_future().get();
+    recognizer->StopContinuousRecognitionAsync().get();
+}
+
+// Speech recognition of a two-channel call recording, with the agent on the left channel and the customer on the
+// right. The file is read once and split into its channels, recognized at the same time by one recognizer each;
+// the phrases of both are merged into one transcript attributed to the speakers, in order of offset.
+void SpeechRecognitionOfStereoCallByChannel()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Replace with your own 16-bit PCM wav file, with one speaker per channel.
+    auto fileName = "call_recording_stereo.wav";
+    ChannelSplitTranscriber transcriber(config, { "Agent", "Customer" });
+
+    auto start = chrono::steady_clock::now();
+    ChannelSplitTranscriber::Transcript transcript;
+    try
+    {
+        transcript = transcriber.Transcribe(fileName);
+    }
+    catch (const exception& e)
+    {
+        // E.g. a missing file, or one with another channel count than speakers.
+        cout << fileName << ": " << e.what() << std::endl;
+        return;
+    }
+    auto wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    for (const auto& phrase : transcript.Phrases)
+    {
+        // Offsets are in ticks of 100 ns.
+        cout << "[" << phrase.Offset / 10000000.0 << " s] " << phrase.Speaker << ": " << phrase.Text << std::endl;
+    }
+    for (size_t channel = 0; channel < transcript.Errors.size(); channel++)
+    {
+        if (!transcript.Errors[channel].empty())
+        {
+            cout << "CANCELED: channel " << channel << ": ErrorDetails=" << transcript.Errors[channel] << std::endl;
+        }
+    }
+    cout << transcript.AudioSeconds << " s of audio, " << transcript.Errors.size() << " channels, transcribed in "
+         << wallSeconds << " s." << std::endl;
+}
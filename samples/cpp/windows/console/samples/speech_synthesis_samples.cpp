@@ -7,6 +7,10 @@
 
 #include <speechapi_cxx.h>
 #include <fstream>
+#include "streaming_audio_sink.h"
+#include "batch_synthesizer.h"
+#include "word_boundary_index.h"
+#include "streaming_file_sink.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -256,6 +260,84 @@ void SpeechSynthesisToMp3File()
     }
 }
 
+// Speech synthesis of a long text to a wave file which is written while the audio is synthesized.
+void SpeechSynthesisToStreamingWaveFile()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Requests raw PCM, the sink writes the wave header itself and patches its sizes when it is closed.
+    // To write an mp3 file instead, set an mp3 output format and use StreamingFileSink::Container::Raw.
+    config->SetSpeechSynthesisOutputFormat(SpeechSynthesisOutputFormat::Raw16Khz16BitMonoPcm);
+
+    // Creates a sink which writes the audio file in 1 MB blocks and flushes it to disk when it is closed.
+    // Replace with your own audio file name.
+    auto fileName = "outputaudio.wav";
+    auto sink = std::make_shared<StreamingFileSink>(fileName, StreamingFileSink::Container::Wave, StreamingFileSink::SyncPolicy::OnClose);
+    auto stream = AudioOutputStream::CreatePushStream(sink);
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, AudioConfig::FromStreamOutput(stream));
+
+    // StartSpeakingTextAsync() returns once synthesis has started and does not keep the whole audio in the result,
+    // so memory use stays constant however long the text is. Completion is signaled by events.
+    shared_ptr<promise<shared_ptr<SpeechSynthesisResult>>> synthesisEnd;
+    auto onSynthesisEnd = [&synthesisEnd](const SpeechSynthesisEventArgs& e)
+    {
+        synthesisEnd->set_value(e.Result);
+    };
+    synthesizer->SynthesisCompleted += onSynthesisEnd;
+    synthesizer->SynthesisCanceled += onSynthesisEnd;
+
+    // Synthesizes the text file paragraph by paragraph, appending to the same audio file.
+    // Replace with your own text file.
+    ifstream textFile("audiobook.txt");
+    if (!textFile.good())
+    {
+        cout << "Failed to open the text file." << endl;
+        return;
+    }
+
+    string paragraph;
+    while (getline(textFile, paragraph))
+    {
+        if (paragraph.empty())
+        {
+            continue;
+        }
+
+        synthesisEnd = make_shared<promise<shared_ptr<SpeechSynthesisResult>>>();
+        synthesizer->StartSpeakingTextAsync(paragraph).get();
+        auto result = synthesisEnd->get_future().get();
+
+        if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+            cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=[" << cancellation->ErrorDetails << "]" << std::endl;
+                cout << "CANCELED: Did you update the subscription info?" << std::endl;
+            }
+            break;
+        }
+
+        cout << sink->GetAudioBytes() << " bytes of audio data written to [" << fileName << "] so far." << endl;
+    }
+
+    // Closes the file, which patches the wave header.
+    sink->Close();
+    if (sink->HasFailed())
+    {
+        cout << "Error when writing audio file [" << fileName << "]" << endl;
+    }
+    else
+    {
+        cout << "Totally " << sink->GetAudioBytes() << " bytes of audio data saved to [" << fileName << "]" << endl;
+    }
+}
+
 // Speech synthesis to pull audio output stream.
 void SpeechSynthesisToPullAudioOutputStream()
 {
@@ -615,6 +697,111 @@ void SpeechSynthesisEvents()
     }
 }
 
+// Speech synthesis with low-latency streaming of the first audio chunks.
+void SpeechSynthesisStreamingFirstChunk()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Requests raw PCM so that every chunk can be played as soon as it arrives, without waiting for a file header.
+    config->SetSpeechSynthesisOutputFormat(SpeechSynthesisOutputFormat::Raw16Khz16BitMonoPcm);
+
+    // Creates a sink that forwards the audio chunks as they arrive.
+    // The sink is created with null output here, which is suitable for headless benchmarks.
+    // Replace nullptr with an opened output (e.g. a pipe to an audio player, or a socket opened with fdopen()) to forward the audio.
+    auto sink = std::make_shared<StreamingAudioSink>(nullptr);
+    auto stream = AudioOutputStream::CreatePushStream(sink);
+    auto streamConfig = AudioConfig::FromStreamOutput(stream);
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, streamConfig);
+
+    // Subscribes to the Synthesizing event only to trace chunk arrival.
+    // GetAudioLength() is used instead of GetAudioData(), which would copy the chunk into a new vector.
+    synthesizer->Synthesizing += [](const SpeechSynthesisEventArgs& e)
+    {
+        cout << "Synthesizing event received with audio chunk of " << e.Result->GetAudioLength() << " bytes" << endl;
+    };
+
+    while (true)
+    {
+        // Receives a text from console input and synthesize it to the streaming sink.
+        cout << "Enter some text that you want to synthesize, or enter empty text to exit." << std::endl;
+        cout << "> ";
+        std::string text;
+        getline(cin, text);
+        if (text.empty())
+        {
+            break;
+        }
+
+        sink->StartRequest();
+        auto result = synthesizer->SpeakTextAsync(text).get();
+        sink->CompleteRequest();
+
+        // Checks result.
+        if (result->Reason == ResultReason::SynthesizingAudioCompleted)
+        {
+            cout << "Speech synthesized for text [" << text << "], " << sink->GetRequestBytes() << " bytes streamed." << std::endl;
+            cout << "  Time to first audio: " << sink->GetTimeToFirstAudioMs() << "ms, "
+                 << "time to complete: " << sink->GetTimeToCompleteMs() << "ms." << std::endl;
+        }
+        else if (result->Reason == ResultReason::Canceled)
+        {
+            auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+            cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+            if (cancellation->Reason == CancellationReason::Error)
+            {
+                cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+                cout << "CANCELED: ErrorDetails=[" << cancellation->ErrorDetails << "]" << std::endl;
+                cout << "CANCELED: Did you update the subscription info?" << std::endl;
+            }
+        }
+    }
+
+    cout << "Totally " << sink->GetTotalBytes() << " bytes streamed." << endl;
+}
+
+// Speech synthesis of many short texts, batched into few SSML requests.
+void SpeechSynthesisBatchOfShortTexts()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a batch synthesizer which keeps each request below 2 seconds, packing up to 32 texts per request.
+    // The full list of supported voices can be found here:
+    // https://docs.microsoft.com/azure/cognitive-services/speech-service/language-support
+    BatchSynthesizer synthesizer(config, "en-US-AriaNeural", 2000, 32);
+
+    // Replace with your own short texts.
+    vector<string> texts;
+    for (int i = 1; i <= 50; i++)
+    {
+        texts.push_back("Notification number " + to_string(i) + ": your order has shipped.");
+    }
+
+    try
+    {
+        auto clips = synthesizer.Synthesize(texts);
+        for (size_t i = 0; i < clips.size(); i++)
+        {
+            cout << "Text [" << texts[i] << "]: " << clips[i].size() << " bytes of audio data." << endl;
+        }
+
+        auto& statistics = synthesizer.GetStatistics();
+        cout << "Synthesized " << statistics.Texts << " texts with " << statistics.Requests << " requests, "
+             << "average latency " << statistics.TotalLatencyMs / statistics.Requests << "ms, "
+             << "max latency " << statistics.MaxLatencyMs << "ms, "
+             << "next batch size " << synthesizer.GetBatchSize() << "." << endl;
+    }
+    catch (const exception& e)
+    {
+        cout << "CANCELED: " << e.what() << endl;
+        cout << "CANCELED: Did you update the subscription info?" << std::endl;
+    }
+}
+
 // Speech synthesis word boundary event.
 void SpeechSynthesisWordBoundaryEvent()
 {
@@ -674,6 +861,85 @@ void SpeechSynthesisWordBoundaryEvent()
     }
 }
 
+// Speech synthesis to wave file with a word boundary index for caption and lip-sync lookups.
+void SpeechSynthesisWordBoundaryIndex()
+{
+    // Creates an instance of a speech config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Creates a speech synthesizer using file as audio output.
+    // Replace with your own audio file name.
+    auto fileName = "outputaudio.wav";
+    auto indexFileName = "outputaudio.wordboundaries";
+    auto fileOutput = AudioConfig::FromWavFileOutput(fileName);
+    auto synthesizer = SpeechSynthesizer::FromConfig(config, fileOutput);
+
+    // Builds the index incrementally while the audio is synthesized.
+    WordBoundaryIndex index;
+    synthesizer->WordBoundary += [&index](const SpeechSynthesisWordBoundaryEventArgs& e)
+    {
+        index.Add(e.AudioOffset, e.TextOffset, e.WordLength);
+    };
+
+    cout << "Enter some text that you want to synthesize." << std::endl;
+    cout << "> ";
+    std::string text;
+    getline(cin, text);
+    if (text.empty())
+    {
+        return;
+    }
+
+    auto result = synthesizer->SpeakTextAsync(text).get();
+
+    // Checks result.
+    if (result->Reason == ResultReason::Canceled)
+    {
+        auto cancellation = SpeechSynthesisCancellationDetails::FromResult(result);
+        cout << "CANCELED: Reason=" << (int)cancellation->Reason << std::endl;
+
+        if (cancellation->Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)cancellation->ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=[" << cancellation->ErrorDetails << "]" << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+        return;
+    }
+
+    // Saves the index next to the audio file, so it never needs to be computed again.
+    index.Save(indexFileName);
+    cout << "Speech synthesized to [" << fileName << "], " << index.Size() << " word boundaries saved to [" << indexFileName << "]" << std::endl;
+
+    // Loads the index back and looks up the word spoken every 500ms, e.g. to show captions.
+    auto loaded = WordBoundaryIndex::Load(indexFileName);
+    if (loaded.Size() == 0)
+    {
+        return;
+    }
+
+    // The unit of the audio offsets is tick (1 tick = 100 nanoseconds), 5,000,000 ticks are 500 milliseconds.
+    for (uint64_t audioOffset = 0; audioOffset <= loaded.AudioOffset(loaded.Size() - 1); audioOffset += 5000000)
+    {
+        auto word = loaded.FindByAudioOffset(audioOffset);
+        if (word != WordBoundaryIndex::npos)
+        {
+            cout << "At " << audioOffset / 10000 << "ms: ["
+                 << WordBoundaryIndex::GetWordText(text, loaded.TextOffset(word), loaded.WordLength(word)) << "]" << endl;
+        }
+    }
+
+    // Looks up when the word at the middle of the text is spoken, e.g. to seek the audio.
+    // Text offsets are in characters, not in bytes of the UTF-8 text.
+    auto word = loaded.FindByTextOffset(WordBoundaryIndex::GetTextLength(text) / 2);
+    if (word != WordBoundaryIndex::npos)
+    {
+        cout << "Word [" << WordBoundaryIndex::GetWordText(text, loaded.TextOffset(word), loaded.WordLength(word)) << "] is spoken at "
+             << (loaded.AudioOffset(word) + 5000) / 10000 << "ms." << endl;
+    }
+}
+
 // Speech synthesis with auto detection for source language
 // Note: this is a preview feature, which might be updated in future versions.
 void SpeechSynthesisWithSourceLanguageAutoDetection()
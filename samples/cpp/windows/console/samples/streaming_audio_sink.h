@@ -0,0 +1,115 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+// Push audio output stream callback that forwards every synthesized chunk as soon as it arrives.
+// The synthesizer hands the chunk buffer directly to Write(), so unlike calling
+// SpeechSynthesisResult::GetAudioData() from the Synthesizing event, no intermediate vector is copied.
+// The sink records the time to the first audio chunk and the time to completion of a request.
+class StreamingAudioSink final : public Microsoft::CognitiveServices::Speech::Audio::PushAudioOutputStreamCallback
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Constructor that forwards audio to an already opened output, e.g. stdout piped into a player,
+    // a device node or a socket opened with fdopen().
+    // Passing nullptr creates a null sink which only counts bytes, for headless benchmarks.
+    explicit StreamingAudioSink(FILE* output = nullptr)
+        : m_output(output)
+    {
+    }
+
+    // Marks the start of a synthesis request. Call it right before SpeakTextAsync().
+    void StartRequest()
+    {
+        m_requestStart = Clock::now();
+        m_firstChunkReceived = false;
+        m_completed = false;
+        m_requestBytes = 0;
+    }
+
+    // Marks the end of a synthesis request. Call it once SpeakTextAsync() has returned.
+    void CompleteRequest()
+    {
+        m_requestEnd = Clock::now();
+        m_completed = true;
+        if (m_output != nullptr)
+        {
+            fflush(m_output);
+        }
+    }
+
+    // Implements PushAudioOutputStreamCallback::Write() which is called when the synthesizer has an audio chunk.
+    // The chunk is written through immediately, so playback can start with the first chunk.
+    int Write(uint8_t* dataBuffer, uint32_t size) override
+    {
+        if (!m_firstChunkReceived.exchange(true))
+        {
+            m_firstChunk = Clock::now();
+        }
+
+        if (m_output != nullptr)
+        {
+            size = (uint32_t)fwrite(dataBuffer, 1, size, m_output);
+        }
+
+        m_requestBytes += size;
+        m_totalBytes += size;
+        return (int)size;
+    }
+
+    // Implements PushAudioOutputStreamCallback::Close() which is called when the synthesizer closes the stream.
+    void Close() override
+    {
+        if (m_output != nullptr)
+        {
+            fflush(m_output);
+        }
+    }
+
+    // Gets the time from StartRequest() to the first audio chunk, in milliseconds, or -1 if no audio was received.
+    double GetTimeToFirstAudioMs() const
+    {
+        return m_firstChunkReceived ? ElapsedMs(m_requestStart, m_firstChunk) : -1;
+    }
+
+    // Gets the time from StartRequest() to CompleteRequest(), in milliseconds, or -1 if the request is not completed.
+    double GetTimeToCompleteMs() const
+    {
+        return m_completed ? ElapsedMs(m_requestStart, m_requestEnd) : -1;
+    }
+
+    // Gets the number of bytes written for the current request.
+    uint64_t GetRequestBytes() const
+    {
+        return m_requestBytes;
+    }
+
+    // Gets the number of bytes written since the sink was created.
+    uint64_t GetTotalBytes() const
+    {
+        return m_totalBytes;
+    }
+
+private:
+    static double ElapsedMs(Clock::time_point from, Clock::time_point to)
+    {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    FILE* m_output;
+    Clock::time_point m_requestStart;
+    Clock::time_point m_firstChunk;
+    Clock::time_point m_requestEnd;
+    std::atomic<bool> m_firstChunkReceived{ false };
+    std::atomic<bool> m_completed{ false };
+    std::atomic<uint64_t> m_requestBytes{ 0 };
+    std::atomic<uint64_t> m_totalBytes{ 0 };
+};
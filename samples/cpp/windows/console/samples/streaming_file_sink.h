@@ -0,0 +1,227 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Push audio output stream callback that writes synthesized audio to a file while it is synthesized.
+// Audio is gathered in one aligned block and written whenever the block is full, so the file is written
+// with few large writes at block-aligned file offsets and memory use does not grow with the audio length.
+// For wave files, a header with empty sizes is written first and the sizes are patched on close.
+class StreamingFileSink final : public Microsoft::CognitiveServices::Speech::Audio::PushAudioOutputStreamCallback
+{
+public:
+    // Container written to the file.
+    enum class Container
+    {
+        // RIFF wave header followed by the raw PCM audio, for raw PCM synthesis output formats.
+        Wave,
+        // Audio bytes as received, for formats that carry their own framing such as MP3.
+        Raw
+    };
+
+    // When the file is flushed to the storage device.
+    enum class SyncPolicy
+    {
+        // Leaves it to the operating system.
+        None,
+        // Once, when the file is closed.
+        OnClose,
+        // After every block write, and when the file is closed.
+        EveryBlock
+    };
+
+    // Constructor that creates (or truncates) the output file.
+    // The format parameters are only used for the wave header.
+    StreamingFileSink(const std::string& fileName,
+                      Container container,
+                      SyncPolicy syncPolicy = SyncPolicy::OnClose,
+                      uint32_t samplesPerSec = 16000,
+                      uint16_t bitsPerSample = 16,
+                      uint16_t channels = 1,
+                      size_t blockSize = 1 << 20)
+        : m_container(container),
+          m_syncPolicy(syncPolicy),
+          m_blockSize(blockSize < blockAlignment ? blockAlignment : blockSize & ~(blockAlignment - 1)),
+          m_storage(new uint8_t[m_blockSize + blockAlignment])
+    {
+        if (fileName.empty())
+        {
+            throw std::invalid_argument("Audio filename is empty");
+        }
+
+        m_file = fopen(fileName.c_str(), "wb");
+        if (m_file == nullptr)
+        {
+            throw std::invalid_argument("Failed to open the specified audio file.");
+        }
+
+        // Writes are already done in large blocks, the C runtime buffer would only add a copy.
+        setvbuf(m_file, nullptr, _IONBF, 0);
+
+        auto address = reinterpret_cast<uintptr_t>(m_storage.get());
+        m_block = m_storage.get() + (blockAlignment - address % blockAlignment) % blockAlignment;
+
+        if (m_container == Container::Wave)
+        {
+            // The header goes into the first block, so that all later writes stay block-aligned in the file.
+            m_header.Channels = channels;
+            m_header.SamplesPerSec = samplesPerSec;
+            m_header.BitsPerSample = bitsPerSample;
+            m_header.BlockAlign = static_cast<uint16_t>(channels * bitsPerSample / 8);
+            m_header.AvgBytesPerSec = samplesPerSec * m_header.BlockAlign;
+            memcpy(m_block, &m_header, sizeof(m_header));
+            m_filled = sizeof(m_header);
+        }
+    }
+
+    ~StreamingFileSink()
+    {
+        Close();
+    }
+
+    // Implements PushAudioOutputStreamCallback::Write() which is called when the synthesizer has an audio chunk.
+    int Write(uint8_t* dataBuffer, uint32_t size) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_file == nullptr)
+        {
+            return 0;
+        }
+
+        uint32_t remaining = size;
+        while (remaining > 0)
+        {
+            auto count = std::min<size_t>(remaining, m_blockSize - m_filled);
+            memcpy(m_block + m_filled, dataBuffer, count);
+            m_filled += count;
+            dataBuffer += count;
+            remaining -= static_cast<uint32_t>(count);
+
+            if (m_filled == m_blockSize && !WriteBlock())
+            {
+                // Returns 0 to tell the synthesizer that the audio could not be written.
+                return 0;
+            }
+        }
+
+        m_audioBytes += size;
+        return static_cast<int>(size);
+    }
+
+    // Implements PushAudioOutputStreamCallback::Close() which is called when the synthesizer closes the stream.
+    // Writes the remaining audio, patches the wave header and closes the file. Calling it again has no effect.
+    // Errors are reported by HasFailed() rather than thrown, since this is also called by the synthesizer.
+    void Close() override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_file == nullptr)
+        {
+            return;
+        }
+
+        if (m_filled > 0)
+        {
+            WriteBlock();
+        }
+
+        if (m_container == Container::Wave && !m_failed)
+        {
+            // Patches the RIFF chunk size and the data chunk size, both little endian.
+            m_header.RiffSize = static_cast<uint32_t>(m_audioBytes + sizeof(m_header) - 8);
+            m_header.DataSize = static_cast<uint32_t>(m_audioBytes);
+            m_failed = fseek(m_file, 0, SEEK_SET) != 0 || fwrite(&m_header, sizeof(m_header), 1, m_file) != 1;
+        }
+
+        if (m_syncPolicy != SyncPolicy::None)
+        {
+            Sync();
+        }
+
+        fclose(m_file);
+        m_file = nullptr;
+    }
+
+    // Gets the number of audio bytes received so far, not counting the wave header.
+    uint64_t GetAudioBytes() const
+    {
+        return m_audioBytes;
+    }
+
+    // Returns true if writing the file failed.
+    bool HasFailed() const
+    {
+        return m_failed;
+    }
+
+private:
+    static constexpr size_t blockAlignment = 4096;
+
+    bool WriteBlock()
+    {
+        m_failed = m_failed || fwrite(m_block, 1, m_filled, m_file) != m_filled;
+        m_filled = 0;
+
+        if (!m_failed && m_syncPolicy == SyncPolicy::EveryBlock)
+        {
+            Sync();
+        }
+        return !m_failed;
+    }
+
+    void Sync()
+    {
+#ifdef _WIN32
+        _commit(_fileno(m_file));
+#else
+        fsync(fileno(m_file));
+#endif
+    }
+
+    // The canonical 44 byte wave header for PCM audio.
+#pragma pack(push, 1)
+    struct WaveHeader
+    {
+        char Riff[4] = { 'R', 'I', 'F', 'F' };
+        uint32_t RiffSize = 0;
+        char Wave[4] = { 'W', 'A', 'V', 'E' };
+        char Fmt[4] = { 'f', 'm', 't', ' ' };
+        uint32_t FmtSize = 16;
+        uint16_t FormatTag = 1;     // PCM.
+        uint16_t Channels = 1;
+        uint32_t SamplesPerSec = 0;
+        uint32_t AvgBytesPerSec = 0;
+        uint16_t BlockAlign = 0;
+        uint16_t BitsPerSample = 0;
+        char Data[4] = { 'd', 'a', 't', 'a' };
+        uint32_t DataSize = 0;
+    } m_header;
+#pragma pack(pop)
+    static_assert(sizeof(WaveHeader) == 44, "unexpected size of WaveHeader");
+
+    Container m_container;
+    SyncPolicy m_syncPolicy;
+    size_t m_blockSize;
+    std::unique_ptr<uint8_t[]> m_storage;
+    uint8_t* m_block = nullptr;
+    size_t m_filled = 0;
+    std::atomic<uint64_t> m_audioBytes{ 0 };
+    std::atomic<bool> m_failed{ false };
+    FILE* m_file = nullptr;
+    std::mutex m_mutex;
+};
@@ -0,0 +1,407 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "worker_pool.h"
+
+// Scores recognized text against reference transcripts, as word error rate (WER) or, for languages written
+// without spaces between words such as zh-CN and ja-JP, as character error rate (CER).
+// Both texts are normalized (case, punctuation, full-width forms) and split into tokens. The edit distance is
+// computed with Myers' bit-parallel algorithm, 64 reference tokens per machine word, then the alignment is
+// traced back within a band around the diagonal as wide as that distance, so an utterance costs its length
+// times its number of errors rather than the product of both lengths.
+class TranscriptScorer final
+{
+public:
+    enum class Unit
+    {
+        Word,
+        Character
+    };
+
+    // One step of an alignment; tokens are indexes into the normalized tokens of the utterance.
+    struct AlignmentStep
+    {
+        char Operation;         // 'C'orrect, 'S'ubstitution, 'D'eletion or 'I'nsertion.
+        int32_t Reference;      // -1 for insertions.
+        int32_t Hypothesis;     // -1 for deletions.
+    };
+
+    struct UtteranceScore
+    {
+        std::vector<std::string> ReferenceTokens;
+        std::vector<std::string> HypothesisTokens;
+        std::vector<AlignmentStep> Alignment;
+        size_t Substitutions = 0;
+        size_t Deletions = 0;
+        size_t Insertions = 0;
+
+        size_t Errors() const { return Substitutions + Deletions + Insertions; }
+    };
+
+    struct Totals
+    {
+        size_t ReferenceTokens = 0;
+        size_t Substitutions = 0;
+        size_t Deletions = 0;
+        size_t Insertions = 0;
+
+        double ErrorRate() const
+        {
+            return ReferenceTokens == 0 ? 0 : static_cast<double>(Substitutions + Deletions + Insertions) / ReferenceTokens;
+        }
+    };
+
+    explicit TranscriptScorer(Unit unit)
+        : m_unit(unit)
+    {
+    }
+
+    // Gets the scoring unit for a locale such as "zh-CN": characters for Chinese and Japanese, words otherwise.
+    static Unit UnitForLocale(const std::string& locale)
+    {
+        auto language = locale.substr(0, 2);
+        return language == "zh" || language == "ja" ? Unit::Character : Unit::Word;
+    }
+
+    // Scores one utterance.
+    UtteranceScore Score(const std::string& reference, const std::string& hypothesis) const
+    {
+        UtteranceScore score;
+        score.ReferenceTokens = Tokenize(reference);
+        score.HypothesisTokens = Tokenize(hypothesis);
+
+        // The kernels compare token ids rather than strings.
+        std::unordered_map<std::string, uint32_t> ids;
+        auto toIds = [&ids](const std::vector<std::string>& tokens)
+        {
+            std::vector<uint32_t> result;
+            result.reserve(tokens.size());
+            for (const auto& token : tokens)
+            {
+                result.push_back(ids.emplace(token, static_cast<uint32_t>(ids.size())).first->second);
+            }
+            return result;
+        };
+        auto ref = toIds(score.ReferenceTokens);
+        auto hyp = toIds(score.HypothesisTokens);
+
+        auto distance = Distance(ref, hyp, ids.size());
+        Align(ref, hyp, distance, score);
+        return score;
+    }
+
+    // Scores (reference, hypothesis) pairs on the given number of threads; scores are in the order of the pairs.
+    std::vector<UtteranceScore> ScoreAll(const std::vector<std::pair<std::string, std::string>>& pairs, size_t threadCount) const
+    {
+        std::vector<UtteranceScore> scores(pairs.size());
+        {
+            // Several chunks per thread even out utterances of different lengths.
+            WorkerPool pool(threadCount);
+            auto chunkSize = pairs.size() / (pool.ThreadCount() * 8) + 1;
+            for (size_t first = 0; first < pairs.size(); first += chunkSize)
+            {
+                auto last = std::min(first + chunkSize, pairs.size());
+                pool.Post([this, &pairs, &scores, first, last]()
+                {
+                    for (auto i = first; i < last; i++)
+                    {
+                        scores[i] = Score(pairs[i].first, pairs[i].second);
+                    }
+                });
+            }
+            pool.WaitIdle();
+        }
+        return scores;
+    }
+
+    static Totals Sum(const std::vector<UtteranceScore>& scores)
+    {
+        Totals totals;
+        for (const auto& score : scores)
+        {
+            totals.ReferenceTokens += score.ReferenceTokens.size();
+            totals.Substitutions += score.Substitutions;
+            totals.Deletions += score.Deletions;
+            totals.Insertions += score.Insertions;
+        }
+        return totals;
+    }
+
+    // Splits normalized text into words, or into characters when scoring characters.
+    // Letters are lower-cased, full-width forms are folded to ASCII and punctuation separates tokens;
+    // apostrophes are kept inside words ("you'll") but dropped elsewhere.
+    std::vector<std::string> Tokenize(const std::string& text) const
+    {
+        std::vector<std::string> tokens;
+        std::string word;
+        auto flush = [&tokens, &word]()
+        {
+            auto first = word.find_first_not_of('\'');
+            if (first != std::string::npos)
+            {
+                tokens.push_back(word.substr(first, word.find_last_not_of('\'') - first + 1));
+            }
+            word.clear();
+        };
+
+        for (size_t i = 0; i < text.size();)
+        {
+            auto c = Fold(NextCodePoint(text, i));
+            if (IsSeparator(c) || (m_unit == Unit::Character && c == '\''))
+            {
+                flush();
+            }
+            else if (m_unit == Unit::Character)
+            {
+                tokens.emplace_back();
+                AppendUtf8(tokens.back(), c);
+            }
+            else
+            {
+                AppendUtf8(word, c);
+            }
+        }
+        flush();
+        return tokens;
+    }
+
+private:
+    static uint32_t NextCodePoint(const std::string& text, size_t& i)
+    {
+        auto lead = static_cast<unsigned char>(text[i++]);
+        size_t length = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+        if (lead < 0x80 || i + length > text.size())
+        {
+            return lead;
+        }
+
+        uint32_t c = lead & (0x3F >> length);
+        for (size_t k = 0; k < length; k++)
+        {
+            auto next = static_cast<unsigned char>(text[i + k]);
+            if ((next & 0xC0) != 0x80)
+            {
+                // Invalid sequences are passed through one byte at a time.
+                return lead;
+            }
+            c = (c << 6) | (next & 0x3F);
+        }
+        i += length;
+        return c;
+    }
+
+    static void AppendUtf8(std::string& text, uint32_t c)
+    {
+        if (c < 0x80)
+        {
+            text += static_cast<char>(c);
+        }
+        else if (c < 0x800)
+        {
+            text += static_cast<char>(0xC0 | (c >> 6));
+            text += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000)
+        {
+            text += static_cast<char>(0xE0 | (c >> 12));
+            text += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            text += static_cast<char>(0xF0 | (c >> 18));
+            text += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            text += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+
+    static uint32_t Fold(uint32_t c)
+    {
+        // Full-width ASCII forms, common in Chinese and Japanese text.
+        if (c >= 0xFF01 && c <= 0xFF5E)
+        {
+            c = c - 0xFF01 + 0x21;
+        }
+        // ASCII and Latin-1 upper case letters.
+        if ((c >= 'A' && c <= 'Z') || (c >= 0xC0 && c <= 0xDE && c != 0xD7))
+        {
+            return c + 0x20;
+        }
+        // Typographic apostrophes.
+        if (c == 0x2018 || c == 0x2019)
+        {
+            return '\'';
+        }
+        return c;
+    }
+
+    static bool IsSeparator(uint32_t c)
+    {
+        if (c < 0x80)
+        {
+            return !((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '\'');
+        }
+        return (c >= 0x80 && c <= 0xBF && c != 0xAA && c != 0xB5 && c != 0xBA)  // Latin-1 controls and punctuation.
+            || c == 0xD7 || c == 0xF7
+            || (c >= 0x2000 && c <= 0x206F)     // General punctuation and spaces.
+            || (c >= 0x3000 && c <= 0x303F)     // CJK symbols and punctuation.
+            || c == 0x30FB                      // Katakana middle dot.
+            || (c >= 0xFF61 && c <= 0xFF65)     // Half-width CJK punctuation.
+            || c == 0xFEFF;                     // Byte order mark.
+    }
+
+    static int PopCount(uint64_t bits)
+    {
+        return static_cast<int>(std::bitset<64>(bits).count());
+    }
+
+    // Advances one 64-row block of Myers' algorithm by one column. The vertical deltas of the block are kept
+    // as bit vectors of +1 (pv) and -1 (mv); hin and the result are the horizontal deltas entering the top
+    // and leaving the bottom of the block.
+    static int AdvanceBlock(uint64_t& pv, uint64_t& mv, uint64_t eq, int hin)
+    {
+        const uint64_t high = 1ULL << 63;
+        uint64_t hinIsNegative = hin < 0 ? 1 : 0;
+        uint64_t xv = eq | mv;
+        eq |= hinIsNegative;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+
+        int hout = (ph & high) ? 1 : (mh & high) ? -1 : 0;
+
+        ph <<= 1;
+        mh <<= 1;
+        mh |= hinIsNegative;
+        ph |= hin > 0 ? 1 : 0;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+        return hout;
+    }
+
+    // Levenshtein distance between two token id sequences, ids being below symbolCount.
+    static size_t Distance(const std::vector<uint32_t>& ref, const std::vector<uint32_t>& hyp, size_t symbolCount)
+    {
+        if (ref.empty() || hyp.empty())
+        {
+            return ref.size() + hyp.size();
+        }
+
+        // Match masks of each token over the reference, one 64-bit word per block.
+        const size_t blocks = (ref.size() + 63) / 64;
+        std::vector<uint64_t> peq(symbolCount * blocks, 0);
+        for (size_t i = 0; i < ref.size(); i++)
+        {
+            peq[ref[i] * blocks + i / 64] |= 1ULL << (i % 64);
+        }
+
+        // The first column is 0, 1, 2, ... so all vertical deltas start at +1.
+        std::vector<uint64_t> pv(blocks, ~0ULL);
+        std::vector<uint64_t> mv(blocks, 0);
+        for (auto token : hyp)
+        {
+            const uint64_t* eq = &peq[token * blocks];
+            // The first row is 0, 1, 2, ... so the delta entering the top block is always +1.
+            int carry = 1;
+            for (size_t b = 0; b < blocks; b++)
+            {
+                carry = AdvanceBlock(pv[b], mv[b], eq[b], carry);
+            }
+        }
+
+        // The distance is the top of the last column plus its vertical deltas down to the last reference row;
+        // the unused rows of the last block are below it and do not affect it.
+        auto distance = static_cast<std::ptrdiff_t>(hyp.size());
+        for (size_t b = 0; b < blocks; b++)
+        {
+            auto rows = std::min<size_t>(64, ref.size() - b * 64);
+            auto mask = rows == 64 ? ~0ULL : (1ULL << rows) - 1;
+            distance += PopCount(pv[b] & mask) - PopCount(mv[b] & mask);
+        }
+        return static_cast<size_t>(distance);
+    }
+
+    // Fills the alignment of an utterance whose distance is known. A path through cell (i, j) costs at least
+    // |i - j| + |(m - i) - (n - j)|, so only the diagonals within that budget are computed.
+    static void Align(const std::vector<uint32_t>& ref, const std::vector<uint32_t>& hyp, size_t distance, UtteranceScore& score)
+    {
+        const auto m = static_cast<std::ptrdiff_t>(ref.size());
+        const auto n = static_cast<std::ptrdiff_t>(hyp.size());
+        const auto k = static_cast<std::ptrdiff_t>(distance);
+        const auto lo = std::max(-k, n - m - k);
+        const auto hi = std::min(k, n - m + k);
+        const auto width = hi - lo + 1;
+        const int32_t unreachable = INT32_MAX / 2;
+
+        std::vector<int32_t> cost(static_cast<size_t>((m + 1) * width), unreachable);
+        auto at = [&](std::ptrdiff_t i, std::ptrdiff_t j) -> int32_t&
+        {
+            return cost[static_cast<size_t>(i * width + (j - i - lo))];
+        };
+        auto inBand = [&](std::ptrdiff_t i, std::ptrdiff_t j)
+        {
+            return i >= 0 && j >= 0 && j <= n && j - i >= lo && j - i <= hi;
+        };
+
+        for (std::ptrdiff_t i = 0; i <= m; i++)
+        {
+            for (auto j = std::max<std::ptrdiff_t>(0, i + lo); j <= std::min(n, i + hi); j++)
+            {
+                int32_t best = i == 0 && j == 0 ? 0 : unreachable;
+                if (i > 0 && j > 0 && inBand(i - 1, j - 1))
+                {
+                    best = std::min(best, at(i - 1, j - 1) + (ref[i - 1] == hyp[j - 1] ? 0 : 1));
+                }
+                if (inBand(i - 1, j))
+                {
+                    best = std::min(best, at(i - 1, j) + 1);
+                }
+                if (inBand(i, j - 1))
+                {
+                    best = std::min(best, at(i, j - 1) + 1);
+                }
+                at(i, j) = best;
+            }
+        }
+
+        auto i = m;
+        auto j = n;
+        while (i > 0 || j > 0)
+        {
+            if (i > 0 && j > 0 && inBand(i - 1, j - 1) && at(i, j) == at(i - 1, j - 1) + (ref[i - 1] == hyp[j - 1] ? 0 : 1))
+            {
+                auto correct = ref[i - 1] == hyp[j - 1];
+                score.Alignment.push_back(AlignmentStep{ correct ? 'C' : 'S', static_cast<int32_t>(i - 1), static_cast<int32_t>(j - 1) });
+                score.Substitutions += correct ? 0 : 1;
+                i--;
+                j--;
+            }
+            else if (inBand(i - 1, j) && at(i, j) == at(i - 1, j) + 1)
+            {
+                score.Alignment.push_back(AlignmentStep{ 'D', static_cast<int32_t>(i - 1), -1 });
+                score.Deletions++;
+                i--;
+            }
+            else
+            {
+                score.Alignment.push_back(AlignmentStep{ 'I', -1, static_cast<int32_t>(j - 1) });
+                score.Insertions++;
+                j--;
+            }
+        }
+        std::reverse(score.Alignment.begin(), score.Alignment.end());
+    }
+
+    Unit m_unit;
+};
@@ -0,0 +1,209 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Routes translation results to one channel per target language.
+// Every channel has its own bounded queue and delivery thread, so a slow subscriber of one language
+// never holds back the recognizer or the subscribers of other languages. When a queue is full, its
+// oldest partial caption is dropped, since a later partial or final caption supersedes it; a final
+// caption is only dropped when the queue holds nothing but finals. The time from routing to delivery
+// is measured per language.
+class TranslationFanOut final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // A translated caption delivered to the subscribers of a language.
+    struct Caption
+    {
+        std::string Text;
+        uint64_t Offset;
+        bool IsFinal;
+        Clock::time_point RoutedAt;
+    };
+
+    using Subscriber = std::function<void(const Caption&)>;
+
+    // Delivery statistics of one language.
+    struct Statistics
+    {
+        uint64_t Delivered = 0;
+        uint64_t Dropped = 0;           // Partial captions dropped from a full queue.
+        uint64_t DroppedFinals = 0;     // Final captions dropped from a queue full of finals.
+        double TotalLatencyMs = 0;
+        double MaxLatencyMs = 0;
+    };
+
+    // Constructor that creates one channel per target language, each with a queue of at most queueCapacity captions.
+    TranslationFanOut(const std::vector<std::string>& languages, size_t queueCapacity = 64)
+    {
+        for (const auto& language : languages)
+        {
+            m_channels.emplace(language, std::unique_ptr<Channel>(new Channel(queueCapacity)));
+        }
+    }
+
+    ~TranslationFanOut()
+    {
+        Stop();
+    }
+
+    // Adds a subscriber to a language. Subscribers must be added before Start().
+    void Subscribe(const std::string& language, Subscriber subscriber)
+    {
+        auto it = m_channels.find(language);
+        if (it == m_channels.end())
+        {
+            throw std::invalid_argument("No channel for language " + language);
+        }
+        it->second->Subscribers.push_back(std::move(subscriber));
+    }
+
+    // Starts the delivery threads.
+    void Start()
+    {
+        for (auto& channel : m_channels)
+        {
+            auto c = channel.second.get();
+            c->Worker = std::thread([c]() { c->Run(); });
+        }
+    }
+
+    // Delivers the captions still queued and stops the delivery threads.
+    void Stop()
+    {
+        for (auto& channel : m_channels)
+        {
+            channel.second->Stop();
+        }
+    }
+
+    // Splits the translations of a result into the language channels.
+    // Called from the Recognizing and Recognized event handlers; it only copies the texts into the queues.
+    void Route(const std::map<std::string, std::string>& translations, uint64_t offset, bool isFinal)
+    {
+        auto now = Clock::now();
+        for (const auto& translation : translations)
+        {
+            auto it = m_channels.find(translation.first);
+            if (it != m_channels.end())
+            {
+                it->second->Push(Caption{ translation.second, offset, isFinal, now });
+            }
+        }
+    }
+
+    // Gets the delivery statistics of each language.
+    std::map<std::string, Statistics> GetStatistics() const
+    {
+        std::map<std::string, Statistics> statistics;
+        for (const auto& channel : m_channels)
+        {
+            std::lock_guard<std::mutex> lock(channel.second->Mutex);
+            statistics[channel.first] = channel.second->Stats;
+        }
+        return statistics;
+    }
+
+private:
+    struct Channel
+    {
+        explicit Channel(size_t capacity) : Capacity(capacity < 1 ? 1 : capacity) {}
+
+        void Push(Caption&& caption)
+        {
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                if (Queue.size() == Capacity)
+                {
+                    auto partial = std::find_if(Queue.begin(), Queue.end(), [](const Caption& queued) { return !queued.IsFinal; });
+                    if (partial != Queue.end())
+                    {
+                        Queue.erase(partial);
+                        Stats.Dropped++;
+                    }
+                    else if (!caption.IsFinal)
+                    {
+                        // Every queued caption is final, so the new partial is dropped instead.
+                        Stats.Dropped++;
+                        return;
+                    }
+                    else
+                    {
+                        Queue.pop_front();
+                        Stats.DroppedFinals++;
+                    }
+                }
+                Queue.push_back(std::move(caption));
+            }
+            Available.notify_one();
+        }
+
+        void Run()
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            while (true)
+            {
+                Available.wait(lock, [this]() { return Stopping || !Queue.empty(); });
+                if (Queue.empty())
+                {
+                    return;
+                }
+
+                auto caption = std::move(Queue.front());
+                Queue.pop_front();
+
+                lock.unlock();
+                for (const auto& subscriber : Subscribers)
+                {
+                    subscriber(caption);
+                }
+                auto latencyMs = std::chrono::duration<double, std::milli>(Clock::now() - caption.RoutedAt).count();
+                lock.lock();
+
+                Stats.Delivered++;
+                Stats.TotalLatencyMs += latencyMs;
+                Stats.MaxLatencyMs = latencyMs > Stats.MaxLatencyMs ? latencyMs : Stats.MaxLatencyMs;
+            }
+        }
+
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                Stopping = true;
+            }
+            Available.notify_one();
+            if (Worker.joinable())
+            {
+                Worker.join();
+            }
+        }
+
+        size_t Capacity;
+        std::vector<Subscriber> Subscribers;
+        std::deque<Caption> Queue;
+        Statistics Stats;
+        bool Stopping = false;
+        mutable std::mutex Mutex;
+        std::condition_variable Available;
+        std::thread Worker;
+    };
+
+    std::map<std::string, std::unique_ptr<Channel>> m_channels;
+};
@@ -9,6 +9,7 @@
 #include <string>
 #include <vector>
 #include <speechapi_cxx.h>
+#include "translation_fan_out.h"
 
 using namespace std;
 using namespace Microsoft::CognitiveServices::Speech;
@@ -154,3 +155,98 @@ void TranslationContinuousRecognition()
     // Stops recognition.
     recognizer->StopContinuousRecognitionAsync().get();
 }
+
+// Continuous translation into several languages, with the captions of each language delivered on its own channel.
+void TranslationContinuousRecognitionWithFanOut()
+{
+    // Creates an instance of a speech translation config with specified subscription key and service region.
+    // Replace with your own subscription key and service region (e.g., "westus").
+    auto config = SpeechTranslationConfig::FromSubscription("YourSubscriptionKey", "YourServiceRegion");
+
+    // Sets source and target languages
+    // Replace with the languages of your choice.
+    auto fromLanguage = "en-US";
+    vector<string> toLanguages = { "de", "fr", "es", "it", "ja", "zh-Hans" };
+    config->SetSpeechRecognitionLanguage(fromLanguage);
+    for (const auto& language : toLanguages)
+    {
+        config->AddTargetLanguage(language);
+    }
+
+    // Creates a fan-out router with a queue of at most 32 captions per language.
+    TranslationFanOut fanOut(toLanguages, 32);
+
+    // Subscribes to each language. Replace with your own delivery, e.g. sending to the subscriber group of the language.
+    for (const auto& language : toLanguages)
+    {
+        fanOut.Subscribe(language, [language](const TranslationFanOut::Caption& caption)
+        {
+            if (caption.IsFinal)
+            {
+                cout << "[" << language << "] " << caption.Text << std::endl;
+            }
+        });
+    }
+
+    // Simulates a slow subscriber for one language; captions of the other languages are not delayed by it.
+    fanOut.Subscribe("ja", [](const TranslationFanOut::Caption&)
+    {
+        this_thread::sleep_for(chrono::milliseconds(500));
+    });
+
+    fanOut.Start();
+
+    // Creates a translation recognizer using microphone as audio input.
+    auto recognizer = TranslationRecognizer::FromConfig(config);
+
+    // Subscribes to events.
+    recognizer->Recognizing.Connect([&fanOut](const TranslationRecognitionEventArgs& e)
+    {
+        fanOut.Route(e.Result->Translations, e.Result->Offset(), false);
+    });
+
+    recognizer->Recognized.Connect([&fanOut](const TranslationRecognitionEventArgs& e)
+    {
+        if (e.Result->Reason == ResultReason::TranslatedSpeech)
+        {
+            fanOut.Route(e.Result->Translations, e.Result->Offset(), true);
+        }
+        else if (e.Result->Reason == ResultReason::NoMatch)
+        {
+            cout << "NOMATCH: Speech could not be recognized." << std::endl;
+        }
+    });
+
+    recognizer->Canceled.Connect([](const TranslationRecognitionCanceledEventArgs& e)
+    {
+        cout << "CANCELED: Reason=" << (int)e.Reason << std::endl;
+        if (e.Reason == CancellationReason::Error)
+        {
+            cout << "CANCELED: ErrorCode=" << (int)e.ErrorCode << std::endl;
+            cout << "CANCELED: ErrorDetails=" << e.ErrorDetails << std::endl;
+            cout << "CANCELED: Did you update the subscription info?" << std::endl;
+        }
+    });
+
+    cout << "Say something...\n";
+
+    // Starts continuos recognition. Uses StopContinuousRecognitionAsync() to stop recognition.
+    recognizer->StartContinuousRecognitionAsync().get();
+
+    cout << "Press any key to stop\n";
+    string s;
+    getline(cin, s);
+
+    // Stops recognition, then delivers the remaining captions.
+    recognizer->StopContinuousRecognitionAsync().get();
+    fanOut.Stop();
+
+    for (const auto& it : fanOut.GetStatistics())
+    {
+        const auto& statistics = it.second;
+        cout << "Language '" << it.first << "': " << statistics.Delivered << " captions delivered, "
+             << statistics.Dropped << " partials and " << statistics.DroppedFinals << " finals dropped, average latency "
+             << (statistics.Delivered == 0 ? 0 : statistics.TotalLatencyMs / statistics.Delivered) << "ms, "
+             << "max latency " << statistics.MaxLatencyMs << "ms." << std::endl;
+    }
+}
@@ -50,11 +50,47 @@ public:
         m_fs.close();
     }
 
+    // Gets the format of the audio data, as given in the file header, e.g. 1 for integer PCM and 3 for float PCM.
+    // For WAVE_FORMAT_EXTENSIBLE headers, the format of their subformat, or 0xFFFE if it is not a standard one.
+    uint16_t GetFormatTag() const
+    {
+        return m_formatTag;
+    }
+
+    uint16_t GetChannels() const
+    {
+        return m_formatHeader.Channels;
+    }
+
+    uint32_t GetSamplesPerSecond() const
+    {
+        return m_formatHeader.SamplesPerSec;
+    }
+
+    uint16_t GetBitsPerSample() const
+    {
+        return m_formatHeader.BitsPerSample;
+    }
+
+    // Gets the size of the data chunk, in bytes. Read() may return chunks that follow it in the file.
+    uint32_t GetDataSize() const
+    {
+        return m_dataSize;
+    }
+
+    // Gets the position of the audio data in the file, for readers seeking to parts of it.
+    uint64_t GetDataOffset() const
+    {
+        return m_dataOffset;
+    }
+
 private:
     // Defines common constants for WAV format.
     static constexpr uint16_t tagBufferSize = 4;
     static constexpr uint16_t chunkTypeBufferSize = 4;
     static constexpr uint16_t chunkSizeBufferSize = 4;
+    static constexpr uint16_t extensibleFormatTag = 0xFFFE;
+    static constexpr uint16_t extensionSize = 24;
 
     // Get format data from a wav file.
     void GetFormatFromWavFile()
@@ -94,16 +130,35 @@ private:
                 {
                     // Reads format data.
                     m_fs.read((char *)&m_formatHeader, sizeof(m_formatHeader));
+                    m_formatTag = m_formatHeader.FormatTag;
+                    uint32_t formatSize = sizeof(m_formatHeader);
+
+                    // A WAVE_FORMAT_EXTENSIBLE header is followed by the size of the extension, the valid bits per
+                    // sample, the channel mask and the SubFormat GUID, whose first two bytes are the format tag of
+                    // the data if the rest is that of the standard subformats.
+                    if (m_formatTag == extensibleFormatTag && chunkSize >= formatSize + extensionSize)
+                    {
+                        static const uint8_t subFormatSuffix[] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+                        uint8_t extension[extensionSize];
+                        m_fs.read((char*)extension, extensionSize);
+                        formatSize += extensionSize;
+                        if (memcmp(extension + 10, subFormatSuffix, sizeof(subFormatSuffix)) == 0)
+                        {
+                            m_formatTag = static_cast<uint16_t>(extension[8] | extension[9] << 8);
+                        }
+                    }
 
                     // Skips the rest of format data.
-                    if (chunkSize > sizeof(m_formatHeader))
+                    if (chunkSize > formatSize)
                     {
-                        m_fs.seekg(chunkSize - sizeof(m_formatHeader), std::ios_base::cur);
+                        m_fs.seekg(chunkSize - formatSize, std::ios_base::cur);
                     }
                 }
                 else if (memcmp(chunkType, "data", chunkTypeBufferSize) == 0)
                 {
                     foundDataChunk = true;
+                    m_dataSize = chunkSize;
+                    m_dataOffset = static_cast<uint64_t>(m_fs.tellg());
                     break;
                 }
                 else
@@ -159,4 +214,7 @@ private:
 
 private:
     std::fstream m_fs;
+    uint16_t m_formatTag = 0;
+    uint32_t m_dataSize = 0;
+    uint64_t m_dataOffset = 0;
 };
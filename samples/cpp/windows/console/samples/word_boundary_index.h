@@ -0,0 +1,192 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Sorted index of word boundaries of a synthesized audio, for caption and lip-sync lookups.
+// The boundaries are stored as a structure of arrays, so a lookup by audio offset or by text offset
+// is a binary search over one contiguous array. Offsets use the units of the WordBoundary event:
+// audio offsets in ticks (1 tick = 100 nanoseconds) and text offsets in characters (UTF-16 code units).
+// The index can be saved next to the audio file and loaded back without synthesizing again.
+class WordBoundaryIndex final
+{
+public:
+    // Value returned by the lookups when no word matches.
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    // Adds a word boundary. Boundaries are expected in audio order, as raised by the WordBoundary event;
+    // a boundary arriving out of order is inserted at its sorted position.
+    void Add(uint64_t audioOffset, uint32_t textOffset, uint32_t wordLength)
+    {
+        if (m_audioOffsets.empty() || audioOffset >= m_audioOffsets.back())
+        {
+            m_audioOffsets.push_back(audioOffset);
+            m_textOffsets.push_back(textOffset);
+            m_wordLengths.push_back(wordLength);
+            return;
+        }
+
+        auto position = std::upper_bound(m_audioOffsets.begin(), m_audioOffsets.end(), audioOffset) - m_audioOffsets.begin();
+        m_audioOffsets.insert(m_audioOffsets.begin() + position, audioOffset);
+        m_textOffsets.insert(m_textOffsets.begin() + position, textOffset);
+        m_wordLengths.insert(m_wordLengths.begin() + position, wordLength);
+    }
+
+    // Finds the word being spoken at the given audio offset, i.e. the last word starting at or before it.
+    // Returns npos if the offset is before the first word.
+    size_t FindByAudioOffset(uint64_t audioOffset) const
+    {
+        auto it = std::upper_bound(m_audioOffsets.begin(), m_audioOffsets.end(), audioOffset);
+        return it == m_audioOffsets.begin() ? npos : static_cast<size_t>(it - m_audioOffsets.begin()) - 1;
+    }
+
+    // Finds the word containing the given text offset.
+    // Returns npos if the offset is not within any word.
+    size_t FindByTextOffset(uint32_t textOffset) const
+    {
+        // Text offsets grow with audio offsets for a single synthesis request, so they are sorted as well.
+        auto it = std::upper_bound(m_textOffsets.begin(), m_textOffsets.end(), textOffset);
+        if (it == m_textOffsets.begin())
+        {
+            return npos;
+        }
+
+        auto index = static_cast<size_t>(it - m_textOffsets.begin()) - 1;
+        return textOffset < m_textOffsets[index] + m_wordLengths[index] ? index : npos;
+    }
+
+    size_t Size() const { return m_audioOffsets.size(); }
+    uint64_t AudioOffset(size_t index) const { return m_audioOffsets[index]; }
+    uint32_t TextOffset(size_t index) const { return m_textOffsets[index]; }
+    uint32_t WordLength(size_t index) const { return m_wordLengths[index]; }
+
+    // Gets the text of a word from the UTF-8 text that was synthesized. The text offsets of the WordBoundary event
+    // count characters as UTF-16 code units, not bytes, so they are converted to byte positions first.
+    // Returns an empty string if the word is not within the text.
+    static std::string GetWordText(const std::string& text, uint32_t textOffset, uint32_t wordLength)
+    {
+        size_t begin = npos;
+        size_t end = npos;
+        uint64_t units = 0;
+        for (size_t position = 0; position <= text.size(); units += Utf16Units(text, position), position += Utf8Bytes(text, position))
+        {
+            if (units == textOffset)
+            {
+                begin = position;
+            }
+            if (units == static_cast<uint64_t>(textOffset) + wordLength)
+            {
+                end = position;
+                break;
+            }
+            if (position == text.size())
+            {
+                break;
+            }
+        }
+        return begin != npos && end != npos ? text.substr(begin, end - begin) : std::string();
+    }
+
+    // Gets the length of a UTF-8 text in the units of the text offsets of the WordBoundary event.
+    static uint32_t GetTextLength(const std::string& text)
+    {
+        uint32_t units = 0;
+        for (size_t position = 0; position < text.size(); position += Utf8Bytes(text, position))
+        {
+            units += Utf16Units(text, position);
+        }
+        return units;
+    }
+
+    void Clear()
+    {
+        m_audioOffsets.clear();
+        m_textOffsets.clear();
+        m_wordLengths.clear();
+    }
+
+    // Saves the index to a file, e.g. next to the synthesized audio file.
+    void Save(const std::string& fileName) const
+    {
+        std::ofstream fs(fileName, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+        if (!fs.good())
+        {
+            throw std::invalid_argument("Failed to open the specified word boundary index file.");
+        }
+
+        uint32_t header[3] = { magic, version, static_cast<uint32_t>(Size()) };
+        fs.write(reinterpret_cast<const char*>(header), sizeof(header));
+        fs.write(reinterpret_cast<const char*>(m_audioOffsets.data()), Size() * sizeof(uint64_t));
+        fs.write(reinterpret_cast<const char*>(m_textOffsets.data()), Size() * sizeof(uint32_t));
+        fs.write(reinterpret_cast<const char*>(m_wordLengths.data()), Size() * sizeof(uint32_t));
+        if (!fs.good())
+        {
+            throw std::runtime_error("Error when writing word boundary index file.");
+        }
+    }
+
+    // Loads an index saved with Save().
+    static WordBoundaryIndex Load(const std::string& fileName)
+    {
+        std::ifstream fs(fileName, std::ios_base::binary | std::ios_base::in);
+        if (!fs.good())
+        {
+            throw std::invalid_argument("Failed to open the specified word boundary index file.");
+        }
+
+        uint32_t header[3] = {};
+        fs.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!fs.good() || header[0] != magic || header[1] != version)
+        {
+            throw std::runtime_error("Invalid word boundary index file header.");
+        }
+
+        WordBoundaryIndex index;
+        index.m_audioOffsets.resize(header[2]);
+        index.m_textOffsets.resize(header[2]);
+        index.m_wordLengths.resize(header[2]);
+        fs.read(reinterpret_cast<char*>(index.m_audioOffsets.data()), header[2] * sizeof(uint64_t));
+        fs.read(reinterpret_cast<char*>(index.m_textOffsets.data()), header[2] * sizeof(uint32_t));
+        fs.read(reinterpret_cast<char*>(index.m_wordLengths.data()), header[2] * sizeof(uint32_t));
+        if (!fs.good())
+        {
+            throw std::runtime_error("Unexpected end of file or error when reading word boundary index file.");
+        }
+        return index;
+    }
+
+private:
+    // Gets the size of the UTF-8 sequence starting at the given position, 1 for a stray continuation byte.
+    static size_t Utf8Bytes(const std::string& text, size_t position)
+    {
+        if (position >= text.size())
+        {
+            return 1;
+        }
+        auto lead = static_cast<uint8_t>(text[position]);
+        size_t size = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+        return std::min(size, text.size() - position);
+    }
+
+    // Gets the number of UTF-16 code units of the character starting at the given position: 2 beyond the BMP.
+    static uint32_t Utf16Units(const std::string& text, size_t position)
+    {
+        return position < text.size() && static_cast<uint8_t>(text[position]) >= 0xF0 ? 2 : 1;
+    }
+
+    // The file starts with the tag 'WBIX', in the byte order of the machine that wrote it.
+    static constexpr uint32_t magic = 0x58494257;
+    static constexpr uint32_t version = 1;
+
+    std::vector<uint64_t> m_audioOffsets;
+    std::vector<uint32_t> m_textOffsets;
+    std::vector<uint32_t> m_wordLengths;
+};
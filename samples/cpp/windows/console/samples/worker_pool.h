@@ -0,0 +1,106 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running posted tasks in order of posting.
+class WorkerPool final
+{
+public:
+    // Constructor that starts the given number of threads (at least one).
+    explicit WorkerPool(size_t threadCount)
+    {
+        if (threadCount == 0)
+        {
+            threadCount = 1;
+        }
+
+        for (size_t i = 0; i < threadCount; i++)
+        {
+            m_threads.emplace_back([this]() { Run(); });
+        }
+    }
+
+    // Runs the tasks still queued, then stops the threads.
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_taskAvailable.notify_all();
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Queues a task. Exceptions thrown by tasks are not caught, tasks must handle their own errors.
+    void Post(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push_back(std::move(task));
+        }
+        m_taskAvailable.notify_one();
+    }
+
+    // Waits until all posted tasks have completed.
+    void WaitIdle()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this]() { return m_tasks.empty() && m_running == 0; });
+    }
+
+    size_t ThreadCount() const
+    {
+        return m_threads.size();
+    }
+
+private:
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_taskAvailable.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+            if (m_tasks.empty())
+            {
+                return;
+            }
+
+            auto task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+            m_running++;
+
+            lock.unlock();
+            task();
+            lock.lock();
+
+            m_running--;
+            if (m_tasks.empty() && m_running == 0)
+            {
+                m_idle.notify_all();
+            }
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_taskAvailable;
+    std::condition_variable m_idle;
+    std::deque<std::function<void()>> m_tasks;
+    size_t m_running = 0;
+    bool m_stopping = false;
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,480 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <speechapi_cxx.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "inflate_stream.h"
+
+// Directory of a ZIP archive, read from its central directory. Members are read with ZipEntryReader.
+// ZIP64 archives and encrypted members are not supported.
+class ZipArchive final
+{
+public:
+    struct Entry
+    {
+        std::string Name;
+        uint16_t Method;            // 0 for stored, 8 for deflated.
+        uint32_t Crc32;
+        uint32_t CompressedSize;
+        uint32_t Size;
+        uint32_t LocalHeaderOffset;
+    };
+
+    explicit ZipArchive(const std::string& fileName)
+        : m_fileName(fileName)
+    {
+        std::ifstream file(fileName, std::ios_base::binary | std::ios_base::in);
+        if (!file.good())
+        {
+            throw std::invalid_argument("Failed to open the specified archive.");
+        }
+
+        // The end of central directory record is at the end of the file, followed by a comment of up to 64 KB.
+        file.seekg(0, std::ios_base::end);
+        auto fileSize = static_cast<uint64_t>(file.tellg());
+        auto tailSize = static_cast<size_t>(std::min<uint64_t>(fileSize, 22 + 65535));
+        std::vector<uint8_t> tail(tailSize);
+        file.seekg(static_cast<std::streamoff>(fileSize - tailSize));
+        file.read(reinterpret_cast<char*>(tail.data()), static_cast<std::streamsize>(tailSize));
+
+        const uint8_t* end = nullptr;
+        for (auto p = static_cast<std::ptrdiff_t>(tailSize) - 22; p >= 0 && end == nullptr; p--)
+        {
+            if (Read32(&tail[p]) == 0x06054b50)
+            {
+                end = &tail[p];
+            }
+        }
+        if (!file.good() || end == nullptr)
+        {
+            throw std::runtime_error("Invalid archive, end of central directory not found.");
+        }
+
+        auto entryCount = Read16(end + 10);
+        auto directorySize = Read32(end + 12);
+        auto directoryOffset = Read32(end + 16);
+        if (entryCount == 0xFFFF || directoryOffset == 0xFFFFFFFF)
+        {
+            throw std::runtime_error("ZIP64 archives are not supported.");
+        }
+
+        std::vector<uint8_t> directory(directorySize);
+        file.seekg(directoryOffset);
+        file.read(reinterpret_cast<char*>(directory.data()), directorySize);
+        if (!file.good())
+        {
+            throw std::runtime_error("Invalid archive, central directory cannot be read.");
+        }
+
+        size_t p = 0;
+        for (uint16_t i = 0; i < entryCount; i++)
+        {
+            if (p + 46 > directory.size() || Read32(&directory[p]) != 0x02014b50)
+            {
+                throw std::runtime_error("Invalid archive, corrupt central directory.");
+            }
+
+            const uint8_t* header = &directory[p];
+            auto nameLength = Read16(header + 28);
+            auto extraLength = Read16(header + 30);
+            auto commentLength = Read16(header + 32);
+            if (p + 46 + nameLength > directory.size())
+            {
+                throw std::runtime_error("Invalid archive, corrupt central directory.");
+            }
+
+            Entry entry;
+            entry.Name.assign(reinterpret_cast<const char*>(header + 46), nameLength);
+            entry.Method = Read16(header + 10);
+            entry.Crc32 = Read32(header + 16);
+            entry.CompressedSize = Read32(header + 20);
+            entry.Size = Read32(header + 24);
+            entry.LocalHeaderOffset = Read32(header + 42);
+            if ((Read16(header + 8) & 1) != 0)
+            {
+                throw std::runtime_error("Encrypted archive members are not supported.");
+            }
+            m_entries.push_back(entry);
+
+            p += 46 + nameLength + extraLength + commentLength;
+        }
+    }
+
+    const std::string& GetFileName() const
+    {
+        return m_fileName;
+    }
+
+    const std::vector<Entry>& GetEntries() const
+    {
+        return m_entries;
+    }
+
+    // Gets the member with the given name, or nullptr.
+    const Entry* Find(const std::string& name) const
+    {
+        for (const auto& entry : m_entries)
+        {
+            if (entry.Name == name)
+            {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    static uint16_t Read16(const uint8_t* p)
+    {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    static uint32_t Read32(const uint8_t* p)
+    {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+private:
+    std::string m_fileName;
+    std::vector<Entry> m_entries;
+};
+
+// Reads the contents of one archive member, decompressing it on the fly and checking its CRC at the end.
+// Every reader opens the archive file on its own, so readers of members of the same or of different archives
+// can be used from different threads without sharing a file position.
+class ZipEntryReader final
+{
+public:
+    ZipEntryReader(const std::string& archiveFileName, const ZipArchive::Entry& entry)
+        : m_entry(entry),
+          m_remainingInput(entry.CompressedSize)
+    {
+        if (entry.Method != 0 && entry.Method != 8)
+        {
+            throw std::runtime_error("Unsupported compression method of archive member " + entry.Name + ".");
+        }
+
+        m_fs.open(archiveFileName, std::ios_base::binary | std::ios_base::in);
+        if (!m_fs.good())
+        {
+            throw std::invalid_argument("Failed to open the specified archive.");
+        }
+
+        // The data follows the local header, whose name and extra field lengths may differ from the central directory.
+        uint8_t header[30];
+        m_fs.seekg(entry.LocalHeaderOffset);
+        m_fs.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!m_fs.good() || ZipArchive::Read32(header) != 0x04034b50)
+        {
+            throw std::runtime_error("Invalid archive, local header of " + entry.Name + " not found.");
+        }
+        m_fs.seekg(ZipArchive::Read16(header + 26) + ZipArchive::Read16(header + 28), std::ios_base::cur);
+
+        if (entry.Method == 8)
+        {
+            m_inflate.reset(new InflateStream([this](uint8_t* buffer, size_t size) { return ReadInput(buffer, size); }));
+        }
+    }
+
+    ZipEntryReader(const ZipEntryReader&) = delete;
+    ZipEntryReader& operator=(const ZipEntryReader&) = delete;
+
+    // Reads up to size bytes of the member. Returns the number of bytes read, 0 at the end of the member.
+    // Throws std::runtime_error if the member is corrupt.
+    size_t Read(uint8_t* buffer, size_t size)
+    {
+        size = std::min<size_t>(size, m_entry.Size - m_produced);
+        size_t count = 0;
+        while (count < size)
+        {
+            auto n = m_inflate ? m_inflate->Read(buffer + count, size - count) : ReadInput(buffer + count, size - count);
+            if (n == 0)
+            {
+                break;
+            }
+            count += n;
+        }
+
+        m_crc = UpdateCrc32(m_crc, buffer, count);
+        m_produced += static_cast<uint32_t>(count);
+        if (m_produced == m_entry.Size && !m_checked)
+        {
+            m_checked = true;
+            if (m_crc != m_entry.Crc32)
+            {
+                throw std::runtime_error("Archive member " + m_entry.Name + " is corrupt, CRC mismatch.");
+            }
+        }
+        else if (count < size)
+        {
+            throw std::runtime_error("Archive member " + m_entry.Name + " is truncated.");
+        }
+        return count;
+    }
+
+    // Reads the whole member into a string.
+    std::string ReadAll()
+    {
+        std::string contents(m_entry.Size, '\0');
+        size_t count = 0;
+        while (count < contents.size())
+        {
+            count += Read(reinterpret_cast<uint8_t*>(&contents[count]), contents.size() - count);
+        }
+        return contents;
+    }
+
+private:
+    size_t ReadInput(uint8_t* buffer, size_t size)
+    {
+        size = std::min<size_t>(size, m_remainingInput);
+        if (size == 0)
+        {
+            return 0;
+        }
+        m_fs.read(reinterpret_cast<char*>(buffer), static_cast<std::streamsize>(size));
+        auto count = static_cast<size_t>(m_fs.gcount());
+        m_remainingInput -= static_cast<uint32_t>(count);
+        return count;
+    }
+
+    static uint32_t UpdateCrc32(uint32_t crc, const uint8_t* data, size_t size)
+    {
+        static const std::array<uint32_t, 256> table = []()
+        {
+            std::array<uint32_t, 256> t;
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                {
+                    c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+                }
+                t[i] = c;
+            }
+            return t;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    ZipArchive::Entry m_entry;
+    std::ifstream m_fs;
+    uint32_t m_remainingInput;
+    std::unique_ptr<InflateStream> m_inflate;
+    uint32_t m_produced = 0;
+    uint32_t m_crc = 0;
+    bool m_checked = false;
+};
+
+// Pull audio input stream callback reading the audio of a WAV member of an archive, without extracting it.
+// Only the data chunk is returned; the format is available to create the stream with.
+class ZipWavInputCallback final : public Microsoft::CognitiveServices::Speech::Audio::PullAudioInputStreamCallback
+{
+public:
+    // Throws if the member cannot be read or is not a WAV file.
+    ZipWavInputCallback(const std::string& archiveFileName, const ZipArchive::Entry& entry)
+        : m_reader(archiveFileName, entry)
+    {
+        uint8_t header[12];
+        ReadExactly(header, sizeof(header));
+        if (memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0)
+        {
+            throw std::runtime_error("Invalid file header of " + entry.Name + ", 'RIFF' and 'WAVE' tags are expected.");
+        }
+
+        // Chunks are skipped by reading through them, since the member is a stream.
+        bool foundFormat = false;
+        while (true)
+        {
+            uint8_t chunk[8];
+            ReadExactly(chunk, sizeof(chunk));
+            auto chunkSize = ZipArchive::Read32(chunk + 4);
+            if (memcmp(chunk, "data", 4) == 0)
+            {
+                m_dataRemaining = chunkSize;
+                break;
+            }
+
+            std::vector<uint8_t> body(chunkSize + (chunkSize & 1));
+            ReadExactly(body.data(), body.size());
+            if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16)
+            {
+                m_channels = ZipArchive::Read16(&body[2]);
+                m_samplesPerSecond = ZipArchive::Read32(&body[4]);
+                m_bitsPerSample = ZipArchive::Read16(&body[14]);
+                foundFormat = true;
+            }
+        }
+
+        if (!foundFormat)
+        {
+            throw std::runtime_error("Invalid file header of " + entry.Name + ", no format chunk before the data chunk.");
+        }
+    }
+
+    int Read(uint8_t* dataBuffer, uint32_t size) override
+    {
+        if (m_failed || m_dataRemaining == 0)
+        {
+            return 0;
+        }
+
+        // Errors cannot be thrown back through the audio stream; the stream ends and the failure is recorded.
+        try
+        {
+            auto count = m_reader.Read(dataBuffer, std::min<uint32_t>(size, m_dataRemaining));
+            m_dataRemaining -= static_cast<uint32_t>(count);
+            return static_cast<int>(count);
+        }
+        catch (const std::exception&)
+        {
+            m_failed = true;
+            return 0;
+        }
+    }
+
+    void Close() override
+    {
+    }
+
+    uint32_t GetSamplesPerSecond() const { return m_samplesPerSecond; }
+    uint8_t GetBitsPerSample() const { return static_cast<uint8_t>(m_bitsPerSample); }
+    uint8_t GetChannels() const { return static_cast<uint8_t>(m_channels); }
+
+    // Gets whether the audio ended early because the member could not be read.
+    bool HasFailed() const
+    {
+        return m_failed;
+    }
+
+private:
+    void ReadExactly(uint8_t* buffer, size_t size)
+    {
+        size_t count = 0;
+        while (count < size)
+        {
+            auto n = m_reader.Read(buffer + count, size - count);
+            if (n == 0)
+            {
+                throw std::runtime_error("Unexpected end of file, before any audio data can be read.");
+            }
+            count += n;
+        }
+    }
+
+    ZipEntryReader m_reader;
+    uint32_t m_dataRemaining = 0;
+    uint32_t m_samplesPerSecond = 0;
+    uint16_t m_bitsPerSample = 0;
+    uint16_t m_channels = 0;
+    std::atomic<bool> m_failed{ false };
+};
+
+// Custom Speech dataset read straight from its archive, e.g. audio-and-trans.zip: the WAV members, each paired
+// with its line of the transcript member. Archives without a transcript, like audio.zip, give empty transcripts.
+class CustomSpeechDataset final
+{
+public:
+    struct Item
+    {
+        const ZipArchive::Entry* Audio;
+        std::string Transcript;
+    };
+
+    explicit CustomSpeechDataset(const std::string& archiveFileName)
+        : m_archive(archiveFileName)
+    {
+        // The transcript can be anywhere in the archive, so it is read first.
+        std::map<std::string, std::string> transcripts;
+        for (const auto& entry : m_archive.GetEntries())
+        {
+            if (HasExtension(entry.Name, ".txt"))
+            {
+                ParseTranscript(ZipEntryReader(archiveFileName, entry).ReadAll(), transcripts);
+            }
+        }
+
+        for (const auto& entry : m_archive.GetEntries())
+        {
+            if (HasExtension(entry.Name, ".wav"))
+            {
+                auto transcript = transcripts.find(entry.Name);
+                m_items.push_back(Item{ &entry, transcript == transcripts.end() ? std::string() : transcript->second });
+            }
+        }
+    }
+
+    CustomSpeechDataset(const CustomSpeechDataset&) = delete;
+    CustomSpeechDataset& operator=(const CustomSpeechDataset&) = delete;
+
+    const std::vector<Item>& GetItems() const
+    {
+        return m_items;
+    }
+
+    // Opens the audio of an item; each call reads through a file handle of its own.
+    std::shared_ptr<ZipWavInputCallback> OpenAudio(const Item& item) const
+    {
+        return std::make_shared<ZipWavInputCallback>(m_archive.GetFileName(), *item.Audio);
+    }
+
+private:
+    static bool HasExtension(const std::string& name, const char* extension)
+    {
+        auto length = strlen(extension);
+        if (name.size() < length)
+        {
+            return false;
+        }
+        auto suffix = name.substr(name.size() - length);
+        std::transform(suffix.begin(), suffix.end(), suffix.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+        return suffix == extension;
+    }
+
+    // Transcript lines are the audio file name, a tab and the text.
+    static void ParseTranscript(const std::string& contents, std::map<std::string, std::string>& transcripts)
+    {
+        size_t begin = contents.compare(0, 3, "\xEF\xBB\xBF") == 0 ? 3 : 0;
+        while (begin < contents.size())
+        {
+            auto end = contents.find('\n', begin);
+            if (end == std::string::npos)
+            {
+                end = contents.size();
+            }
+            auto line = contents.substr(begin, end - begin);
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+
+            auto tab = line.find('\t');
+            if (tab != std::string::npos)
+            {
+                transcripts[line.substr(0, tab)] = line.substr(tab + 1);
+            }
+            begin = end + 1;
+        }
+    }
+
+    ZipArchive m_archive;
+    std::vector<Item> m_items;
+};
@@ -6,27 +6,33 @@
 //
 
 #include "gstreamer_modules.h"
+#include <mutex>
 
 namespace Microsoft {
 namespace CognitiveServices {
 namespace Speech {
 namespace Impl {
 
+// Registers the statically linked plugins. The SDK may call this for every compressed stream; the plugins
+// are only registered on the first call.
 void spx_gst_init() {
 #if defined(TARGET_OS_IPHONE)
-    GST_PLUGIN_STATIC_REGISTER(coreelements);
-    GST_PLUGIN_STATIC_REGISTER(app);
-    GST_PLUGIN_STATIC_REGISTER(audioconvert);
-    GST_PLUGIN_STATIC_REGISTER(mpg123);
-    GST_PLUGIN_STATIC_REGISTER(audioresample);
-    GST_PLUGIN_STATIC_REGISTER(audioparsers);
-    GST_PLUGIN_STATIC_REGISTER(ogg);
-    GST_PLUGIN_STATIC_REGISTER(opusparse);
-    GST_PLUGIN_STATIC_REGISTER(opus);
-    GST_PLUGIN_STATIC_REGISTER(wavparse);
-    GST_PLUGIN_STATIC_REGISTER(alaw);
-    GST_PLUGIN_STATIC_REGISTER(mulaw);
-    GST_PLUGIN_STATIC_REGISTER(flac);
+    static std::once_flag registered;
+    std::call_once(registered, []() {
+        GST_PLUGIN_STATIC_REGISTER(coreelements);
+        GST_PLUGIN_STATIC_REGISTER(app);
+        GST_PLUGIN_STATIC_REGISTER(audioconvert);
+        GST_PLUGIN_STATIC_REGISTER(mpg123);
+        GST_PLUGIN_STATIC_REGISTER(audioresample);
+        GST_PLUGIN_STATIC_REGISTER(audioparsers);
+        GST_PLUGIN_STATIC_REGISTER(ogg);
+        GST_PLUGIN_STATIC_REGISTER(opusparse);
+        GST_PLUGIN_STATIC_REGISTER(opus);
+        GST_PLUGIN_STATIC_REGISTER(wavparse);
+        GST_PLUGIN_STATIC_REGISTER(alaw);
+        GST_PLUGIN_STATIC_REGISTER(mulaw);
+        GST_PLUGIN_STATIC_REGISTER(flac);
+    });
 #endif
 }
 